@@ -0,0 +1,216 @@
+/**
+ * @file aggregates.h
+ * @brief Per-artist and per-genre statistics: song count and duration, album count and
+ * rating, and album year range.
+ *
+ * `Aggregates` keeps one `GroupStats` per artist and per genre and is updated on every add
+ * and remove, so reading a group costs O(1) instead of a pass over the collections.
+ * `aggregateRows` computes the same statistics from scratch for a subset of the rows,
+ * which is what filtered group-by queries use.
+ */
+#ifndef AGGREGATES_H
+#define AGGREGATES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "song.h"
+#include "album.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    enum class GroupBy { Artist, Genre };
+
+    /**
+     * @brief Dictionary the group keys of `by` come from.
+     */
+    inline StringDictionary& groupDictionary(GroupBy by) {
+        return by == GroupBy::Artist ? artistDictionary() : genreDictionary();
+    }
+
+    /**
+     * @brief Running totals of one group. Every update is O(1) except for the year range,
+     * which keeps a small sorted histogram of the group's album years.
+     */
+    struct GroupStats {
+        std::size_t songs = 0;
+        double totalDuration = 0.0;
+        std::size_t albums = 0;
+        double totalRating = 0.0;
+        std::vector<std::pair<int, std::size_t>> years;   // album year -> album count
+
+        bool empty() const { return songs == 0 && albums == 0; }
+        double averageDuration() const { return songs == 0 ? 0.0 : totalDuration / static_cast<double>(songs); }
+        double averageRating() const { return albums == 0 ? 0.0 : totalRating / static_cast<double>(albums); }
+        int firstYear() const { return years.empty() ? 0 : years.front().first; }
+        int lastYear() const { return years.empty() ? 0 : years.back().first; }
+
+        void add(const Song& song) {
+            ++songs;
+            totalDuration += song.getDuration();
+        }
+
+        void remove(const Song& song) {
+            // Reset instead of subtracting the last value so rounding errors do not pile up
+            totalDuration = --songs == 0 ? 0.0 : totalDuration - song.getDuration();
+        }
+
+        void add(const Album& album) {
+            ++albums;
+            totalRating += album.getRating();
+            auto it = yearSlot(album.getYear());
+            if (it != years.end() && it->first == album.getYear()) {
+                ++it->second;
+            } else {
+                years.insert(it, {album.getYear(), 1});
+            }
+        }
+
+        void remove(const Album& album) {
+            totalRating = --albums == 0 ? 0.0 : totalRating - album.getRating();
+            auto it = yearSlot(album.getYear());
+            if (it != years.end() && it->first == album.getYear() && --it->second == 0) {
+                years.erase(it);
+            }
+        }
+
+    private:
+        std::vector<std::pair<int, std::size_t>>::iterator yearSlot(int year) {
+            return std::lower_bound(years.begin(), years.end(), year,
+                                    [](const std::pair<int, std::size_t>& entry, int value) { return entry.first < value; });
+        }
+    };
+
+    /**
+     * @brief Statistics of one group, `key` being an ID of `groupDictionary(by)`.
+     */
+    struct GroupSummary {
+        StringId key;
+        GroupStats stats;
+    };
+
+    /**
+     * @brief Statistics for every artist and every genre, addressed directly by dictionary ID.
+     */
+    class Aggregates {
+    public:
+        void add(const Song& song) {
+            slot(byArtist, song.getArtistId()).add(song);
+            slot(byGenre, song.getGenreId()).add(song);
+        }
+
+        void remove(const Song& song) {
+            slot(byArtist, song.getArtistId()).remove(song);
+            slot(byGenre, song.getGenreId()).remove(song);
+        }
+
+        void add(const Album& album) {
+            slot(byArtist, album.getArtistId()).add(album);
+            slot(byGenre, album.getGenreId()).add(album);
+        }
+
+        void remove(const Album& album) {
+            slot(byArtist, album.getArtistId()).remove(album);
+            slot(byGenre, album.getGenreId()).remove(album);
+        }
+
+        // The hooks that keep the totals in step with the songs or the albums, like the library's indexes
+        template <typename Record>
+        void insert(const std::vector<Record>& records, std::size_t row) {
+            add(records[row]);
+        }
+
+        template <typename Record>
+        void replace(const std::vector<Record>& records, std::size_t row, const Record& old) {
+            remove(old);
+            add(records[row]);
+        }
+
+        template <typename Record>
+        void remove(const std::vector<Record>& records, std::size_t row) {
+            remove(records[row]);
+        }
+
+        /**
+         * @brief Nothing to do: the totals do not refer to rows, and the removed records were
+         * taken out by `remove` already.
+         */
+        template <typename Record>
+        void eraseRows(const std::vector<Record>&, const std::vector<std::size_t>&) {}
+
+        /**
+         * @brief Statistics of one group; empty for a key without songs or albums
+         * (also for `StringDictionary::notFound`).
+         */
+        const GroupStats& find(GroupBy by, StringId key) const {
+            static const GroupStats none;
+            const std::vector<GroupStats>& groups = by == GroupBy::Artist ? byArtist : byGenre;
+            return key < groups.size() ? groups[key] : none;
+        }
+
+        /**
+         * @brief Every non-empty group, sorted by name.
+         */
+        std::vector<GroupSummary> groups(GroupBy by) const {
+            const std::vector<GroupStats>& groups = by == GroupBy::Artist ? byArtist : byGenre;
+            std::vector<GroupSummary> result;
+            for (StringId key = 0; key < groups.size(); ++key) {
+                if (!groups[key].empty()) {
+                    result.push_back({key, groups[key]});
+                }
+            }
+            sortByName(result, by);
+            return result;
+        }
+
+        void clear() {
+            byArtist.clear();
+            byGenre.clear();
+        }
+
+        static void sortByName(std::vector<GroupSummary>& groups, GroupBy by) {
+            const StringDictionary& names = groupDictionary(by);
+            std::sort(groups.begin(), groups.end(), [&names](const GroupSummary& a, const GroupSummary& b) {
+                return names.lookup(a.key) < names.lookup(b.key);
+            });
+        }
+
+    private:
+        static GroupStats& slot(std::vector<GroupStats>& groups, StringId key) {
+            if (key >= groups.size()) {
+                groups.resize(static_cast<std::size_t>(key) + 1);
+            }
+            return groups[key];
+        }
+
+        std::vector<GroupStats> byArtist;
+        std::vector<GroupStats> byGenre;
+    };
+
+    /**
+     * @brief Groups the given song and album rows by `by` with one pass over each list.
+     * Returns the non-empty groups sorted by name.
+     */
+    inline std::vector<GroupSummary> aggregateRows(const std::vector<Song>& songs, const std::vector<std::size_t>& songRows,
+                                                   const std::vector<Album>& albums, const std::vector<std::size_t>& albumRows, GroupBy by) {
+        auto keyOf = [by](const auto& record) { return by == GroupBy::Artist ? record.getArtistId() : record.getGenreId(); };
+        std::vector<GroupStats> groups(groupDictionary(by).size());
+        for (std::size_t row : songRows) {
+            groups[keyOf(songs[row])].add(songs[row]);
+        }
+        for (std::size_t row : albumRows) {
+            groups[keyOf(albums[row])].add(albums[row]);
+        }
+        std::vector<GroupSummary> result;
+        for (StringId key = 0; key < groups.size(); ++key) {
+            if (!groups[key].empty()) {
+                result.push_back({key, std::move(groups[key])});
+            }
+        }
+        Aggregates::sortByName(result, by);
+        return result;
+    }
+}
+
+#endif
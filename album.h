@@ -1,34 +1,48 @@
-/**
- * @file Album.h
- * @brief Class representing a music album with attributes like name, artist, year, rating, and genre.
- * Provides methods to retrieve these attributes.
- */
-#ifndef ALBUM_H
-#define ALBUM_H
-
-#include <string>
-
-namespace rc {
-    class Album {
-    public:
-        Album() : name(""), artist(""), year(0), rating(0.0), genre("") {}
-
-        Album(const std::string& name, const std::string& artist, int year, double rating, const std::string& genre)
-            : name(name), artist(artist), year(year), rating(rating), genre(genre) {}
-
-        std::string getName() const { return name; }
-        std::string getArtist() const { return artist; }
-        int getYear() const { return year; }
-        double getRating() const { return rating; }
-        std::string getGenre() const { return genre; }
-
-    private:
-        std::string name;   
-        std::string artist; 
-        int year;           
-        double rating;         
-        std::string genre;  
-    };
-}
-
-#endif
+/**
+ * @file Album.h
+ * @brief Class representing a music album with attributes like name, artist, year, rating, and genre.
+ * Provides methods to retrieve these attributes.
+ * Artist and genre are interned (see `string_dictionary.h`) and stored as integer IDs; the name
+ * is kept in a text arena (see `text_arena.h`), so an album owns no heap memory.
+ */
+#ifndef ALBUM_H
+#define ALBUM_H
+
+#include <string>
+#include <string_view>
+#include "string_dictionary.h"
+#include "text_arena.h"
+
+namespace rc {
+    class Album {
+    public:
+        Album() : name(), artist(StringDictionary::empty), year(0), rating(0.0), genre(StringDictionary::empty) {}
+
+        Album(std::string_view name, std::string_view artist, int year, double rating, std::string_view genre)
+            : name(TextArena::current().store(name)), artist(artistDictionary().intern(artist)), year(year), rating(rating), genre(genreDictionary().intern(genre)) {}
+
+        // For callers that already hold the dictionary IDs
+        Album(std::string_view name, StringId artist, int year, double rating, StringId genre)
+            : name(TextArena::current().store(name)), artist(artist), year(year), rating(rating), genre(genre) {}
+
+        std::string_view getName() const { return name; }
+        const std::string& getArtist() const { return artistDictionary().lookup(artist); }
+        int getYear() const { return year; }
+        double getRating() const { return rating; }
+        const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+        StringId getArtistId() const { return artist; }
+        StringId getGenreId() const { return genre; }
+
+        // Copies the name to `arena`, e.g. the arena of the library the album is added to
+        void storeTextIn(TextArena& arena) { name = arena.store(name); }
+
+    private:
+        std::string_view name;   
+        StringId artist; 
+        int year;           
+        double rating;         
+        StringId genre;  
+    };
+}
+
+#endif
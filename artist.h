@@ -1,30 +1,38 @@
-/**
- * @file Artist.h
- * @brief Class representing a music artist with attributes like name, country, and genre.
- * Provides methods to retrieve these attributes.
- */
-#ifndef ARTIST_H
-#define ARTIST_H
-
-#include <string>
-
-namespace rc {
-    class Artist {
-    public:
-        Artist() : name(""), country(""), genre("") {}
-        Artist(const std::string& name, const std::string& country, const std::string& genre)
-            : name(name), country(country), genre(genre) {}
-
-        std::string getName() const { return name; }
-        std::string getCountry() const { return country; }
-        std::string getGenre() const { return genre; }
-
-    private:
-        std::string name;    
-        std::string country; 
-        std::string genre;   
-    };
-}
-
-#endif
-
+/**
+ * @file Artist.h
+ * @brief Class representing a music artist with attributes like name, country, and genre.
+ * Provides methods to retrieve these attributes.
+ * All three attributes are interned (see `string_dictionary.h`) and stored as integer IDs.
+ */
+#ifndef ARTIST_H
+#define ARTIST_H
+
+#include <string>
+#include <string_view>
+#include "string_dictionary.h"
+
+namespace rc {
+    class Artist {
+    public:
+        Artist() : name(StringDictionary::empty), country(StringDictionary::empty), genre(StringDictionary::empty) {}
+        Artist(std::string_view name, std::string_view country, std::string_view genre)
+            : name(artistDictionary().intern(name)), country(countryDictionary().intern(country)), genre(genreDictionary().intern(genre)) {}
+        // For callers that already hold the dictionary IDs
+        Artist(StringId name, StringId country, StringId genre) : name(name), country(country), genre(genre) {}
+
+        const std::string& getName() const { return artistDictionary().lookup(name); }
+        const std::string& getCountry() const { return countryDictionary().lookup(country); }
+        const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+        StringId getNameId() const { return name; }
+        StringId getCountryId() const { return country; }
+        StringId getGenreId() const { return genre; }
+
+    private:
+        StringId name;    
+        StringId country; 
+        StringId genre;   
+    };
+}
+
+#endif
+
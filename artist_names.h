@@ -0,0 +1,160 @@
+/**
+ * @file artist_names.h
+ * @brief Search index over the artist names in use: every name a song, album or artist record
+ * of the library refers to, whether or not the artist has a record of its own.
+ *
+ * Many songs and albums name artists that have no artist record, so searching the artist
+ * records alone misses them. `ArtistNameIndex` keeps each name in use once, together with the
+ * number of records using it, and searches the names with a `TextIndex`. A name loses its
+ * place in the search once its last record is removed; the entries of such names are erased
+ * when the library is compacted.
+ */
+#ifndef ARTIST_NAMES_H
+#define ARTIST_NAMES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "album.h"
+#include "artist.h"
+#include "row_remap.h"
+#include "song.h"
+#include "string_dictionary.h"
+#include "text_index.h"
+
+namespace rc {
+    /**
+     * @brief The artist names used by songs, albums and artist records. Kept up to date through
+     * the same hooks as the indexes of each collection, for all three of them.
+     */
+    class ArtistNameIndex {
+    public:
+        /**
+         * @brief Counts the names used by the collections, which must not hold removed records.
+         */
+        void build(const std::vector<Song>& songs, const std::vector<Artist>& artists, const std::vector<Album>& albums) {
+            clear();
+            for (const Song& song : songs) {
+                use(song.getArtistId());
+            }
+            for (const Artist& artist : artists) {
+                use(artist.getNameId());
+            }
+            for (const Album& album : albums) {
+                use(album.getArtistId());
+            }
+        }
+
+        /**
+         * @brief Builds the prefix, trigram and fuzzy search indexes over the names; until then
+         * searches scan them.
+         */
+        void buildSearch() {
+            eraseUnused();
+            names.build(ids);
+        }
+
+        template <typename Record>
+        void insert(const std::vector<Record>& records, std::size_t row) {
+            use(artistOf(records[row]));
+        }
+
+        /**
+         * @brief Nothing to do: a record is only replaced in place by one with the same primary
+         * key, which includes its artist.
+         */
+        template <typename Record>
+        void replace(const std::vector<Record>&, std::size_t, const Record&) {}
+
+        template <typename Record>
+        void remove(const std::vector<Record>& records, std::size_t row) {
+            release(artistOf(records[row]));
+        }
+
+        /**
+         * @brief The names do not refer to rows; a compaction only erases the names no record
+         * uses any more.
+         */
+        template <typename Record>
+        void eraseRows(const std::vector<Record>&, const std::vector<std::size_t>&) {
+            eraseUnused();
+        }
+
+        /**
+         * @brief Up to `limit` names in use matching `query` the way `match` says (see
+         * `TextIndex::search`), best first.
+         */
+        std::vector<StringId> search(std::string_view query, TextMatch match, std::size_t limit) const {
+            std::vector<StringId> found;
+            for (std::size_t entry : names.search(ids, query, match, limit)) {
+                found.push_back(ids[entry]);
+            }
+            return found;
+        }
+
+        void clear() {
+            ids.clear();
+            uses.clear();
+            entryOf.clear();
+            unused.clear();
+            names.clear();
+        }
+
+    private:
+        static constexpr std::uint32_t noEntry = static_cast<std::uint32_t>(-1);
+
+        static StringId artistOf(const Song& song) { return song.getArtistId(); }
+        static StringId artistOf(const Album& album) { return album.getArtistId(); }
+        static StringId artistOf(const Artist& artist) { return artist.getNameId(); }
+
+        void use(StringId id) {
+            if (id >= entryOf.size()) {
+                entryOf.resize(static_cast<std::size_t>(id) + 1, noEntry);
+            }
+            if (entryOf[id] == noEntry) {
+                entryOf[id] = static_cast<std::uint32_t>(ids.size());
+                ids.push_back(id);
+                uses.push_back(0);
+                names.insert(ids, ids.size() - 1);
+            }
+            ++uses[entryOf[id]];
+        }
+
+        /**
+         * @brief Drops a use of `id`; the last one takes the name out of the search. A later use
+         * gives the name a new entry.
+         */
+        void release(StringId id) {
+            const std::uint32_t entry = entryOf[id];
+            if (--uses[entry] != 0) {
+                return;
+            }
+            names.remove(ids, entry);
+            unused.add(entry);
+            entryOf[id] = noEntry;
+        }
+
+        void eraseUnused() {
+            if (unused.empty()) {
+                return;
+            }
+            const std::vector<std::size_t> rows = unused.rows();
+            names.eraseRows(ids, rows);
+            detail::eraseColumnRows(ids, rows);
+            detail::eraseColumnRows(uses, rows);
+            unused.clear();
+            for (std::size_t entry = 0; entry < ids.size(); ++entry) {
+                entryOf[ids[entry]] = static_cast<std::uint32_t>(entry);
+            }
+        }
+
+        std::vector<StringId> ids;             // one entry per name, in order of first use
+        std::vector<std::size_t> uses;         // records using the name of each entry
+        std::vector<std::uint32_t> entryOf;    // entry of each artist dictionary ID, or `noEntry`
+        RemovedRows unused;                    // entries whose name no record uses any more
+        TextIndex<StringId> names{[](const StringId& id) -> std::string_view { return artistDictionary().lookup(id); }};
+    };
+}
+
+#endif
@@ -0,0 +1,606 @@
+/**
+ * @file batch.h
+ * @brief Non-interactive command mode: reads one command per line and writes the results
+ * through a large output buffer, as plain text or as JSON Lines.
+ *
+ * Commands (arguments with several fields use `;` like the database files):
+ * - `add-song title;duration;genre;artist`, `add-artist name;country;genre`,
+ *   `add-album name;artist;year;rating;genre`: fail if a record with the same key (see
+ *   `upsert-*`) exists already
+ * - `upsert-song`, `upsert-artist`, `upsert-album` with the fields of the `add-*` commands:
+ *   replace the record with the same key (song: title and artist, album: name and artist,
+ *   artist: name) or add it if there is none
+ * - `remove-song title;artist`, `remove-album name;artist`: remove by key; `remove-artist name`
+ * - `remove-song title`, `remove-album name`: remove every song or album with that title or
+ *   name, whatever its artist; consecutive removals of the same kind are made together
+ * - `songs`, `artists`, `albums`
+ * - `by-artist name`, `by-genre genre`
+ * - `rank [k]`
+ * - `filter-songs expression`, `filter-albums expression` (see `filter.h`)
+ * - `songs-by-artists expression`, `albums-by-artists expression`: records whose artist
+ *   record matches an artist filter such as `country = Canada` (see `join.h`)
+ * - `rating-by-country`: average album rating per artist country
+ * - `search text`, `complete text`: up to 10 songs, albums and artists each whose title or
+ *   name contains (or starts with) `text`, ignoring case, best match first
+ * - `fuzzy text`: up to 10 songs, albums and artists each whose title or name is within a
+ *   few typos of `text`, ignoring case, spacing and punctuation, closest first; the artists
+ *   include those that only songs or albums name, which are listed by name alone
+ * - `stats artist|genre [name]`: song and album statistics of one artist or genre, or of all
+ *   of them (see `aggregates.h`)
+ * - `metrics [reset]`: call counts, latencies and row, byte and allocation counts of the
+ *   library operations so far (see `metrics.h`); `reset` starts them over
+ *
+ * Blank lines and lines starting with `#` are ignored. Problems are reported on `std::cerr`
+ * with the line number and do not stop the run.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "aggregates.h"
+#include "filter.h"
+#include "join.h"
+#include "journal.h"
+#include "library.h"
+#include "loader.h"
+#include "metrics.h"
+#include "record_schema.h"
+
+namespace rc {
+    /**
+     * @brief Append-only output buffer over a `FILE*` (or any other sink); it is written out
+     * only when full or on `flush`, instead of once per line.
+     */
+    class OutputBuffer {
+    public:
+        // Writes all `size` bytes or returns false
+        using Sink = std::function<bool(const char* data, std::size_t size)>;
+
+        explicit OutputBuffer(std::FILE* file, std::size_t capacity = 1 << 20)
+            : sink([file](const char* data, std::size_t size) { return std::fwrite(data, 1, size, file) == size; }), file(file) {
+            buffer.reserve(capacity);
+        }
+
+        OutputBuffer(Sink sink, std::size_t capacity) : sink(std::move(sink)) {
+            buffer.reserve(capacity);
+        }
+
+        ~OutputBuffer() { flush(); }
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        OutputBuffer& operator<<(std::string_view text) {
+            if (buffer.size() + text.size() > buffer.capacity()) {
+                flush();
+            }
+            if (text.size() > buffer.capacity()) {
+                write(text.data(), text.size());
+            } else {
+                buffer.append(text.data(), text.size());
+            }
+            return *this;
+        }
+
+        OutputBuffer& operator<<(char c) { return *this << std::string_view(&c, 1); }
+
+        /**
+         * @brief Same digits as `std::ostream` with its default precision (`%g`, 6 digits).
+         */
+        OutputBuffer& operator<<(double value) {
+            char text[32];
+            auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+            return *this << std::string_view(text, static_cast<std::size_t>(result.ptr - text));
+        }
+
+        OutputBuffer& operator<<(long long value) {
+            char text[24];
+            auto result = std::to_chars(text, text + sizeof(text), value);
+            return *this << std::string_view(text, static_cast<std::size_t>(result.ptr - text));
+        }
+
+        OutputBuffer& operator<<(int value) { return *this << static_cast<long long>(value); }
+        OutputBuffer& operator<<(std::size_t value) { return *this << static_cast<long long>(value); }
+
+        /**
+         * @brief Writes `text` as a quoted JSON string.
+         */
+        OutputBuffer& quoted(std::string_view text) {
+            *this << '"';
+            std::size_t start = 0;
+            for (std::size_t i = 0; i < text.size(); ++i) {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                if (c != '"' && c != '\\' && c >= 0x20) {
+                    continue;
+                }
+                *this << text.substr(start, i - start);
+                switch (c) {
+                    case '"': *this << "\\\""; break;
+                    case '\\': *this << "\\\\"; break;
+                    case '\n': *this << "\\n"; break;
+                    case '\r': *this << "\\r"; break;
+                    case '\t': *this << "\\t"; break;
+                    default: {
+                        char escape[8];
+                        std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                        *this << std::string_view(escape);
+                    }
+                }
+                start = i + 1;
+            }
+            return *this << text.substr(start) << '"';
+        }
+
+        bool flush() {
+            if (!buffer.empty()) {
+                write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+            if (file != nullptr) {
+                ok = std::fflush(file) == 0 && ok;
+            }
+            return ok;
+        }
+
+        bool good() const { return ok; }
+
+    private:
+        void write(const char* data, std::size_t size) {
+            ok = sink(data, size) && ok;
+        }
+
+        Sink sink;
+        std::FILE* file = nullptr;
+        std::string buffer;
+        bool ok = true;
+    };
+
+    enum class BatchFormat { Text, Json };
+
+    namespace detail {
+        /**
+         * @brief Formats records for batch output. Text lines match the interactive listings.
+         * Records are templates so the views of `paged_store.h` print the same way.
+         */
+        class RecordPrinter {
+        public:
+            RecordPrinter(OutputBuffer& out, BatchFormat format) : out(out), format(format) {}
+
+            template <typename SongRecord>
+            void song(const SongRecord& song) {
+                if (format == BatchFormat::Text) {
+                    out << song.getTitle() << " (" << song.getArtist() << "): " << song.getDuration()
+                        << " minutes, Genre: " << song.getGenre() << '\n';
+                    return;
+                }
+                json<Song>(song);
+            }
+
+            template <typename ArtistRecord>
+            void artist(const ArtistRecord& artist) {
+                if (format == BatchFormat::Text) {
+                    out << artist.getName() << " (" << artist.getCountry() << ") Genre: " << artist.getGenre() << '\n';
+                    return;
+                }
+                json<Artist>(artist);
+            }
+
+            /**
+             * @brief An artist that songs or albums name but that has no artist record.
+             */
+            void artistName(const std::string& name) {
+                if (format == BatchFormat::Text) {
+                    out << name << " (no artist record)\n";
+                    return;
+                }
+                out << "{\"type\":\"artist_name\",\"name\":";
+                out.quoted(name) << "}\n";
+            }
+
+            template <typename AlbumRecord>
+            void album(const AlbumRecord& album) {
+                if (format == BatchFormat::Text) {
+                    out << album.getName() << " (" << album.getArtist() << ") Year: " << album.getYear()
+                        << ", Rating: " << album.getRating() << "/5, Genre: " << album.getGenre() << '\n';
+                    return;
+                }
+                json<Album>(album);
+            }
+
+            void countryRating(const CountryRating& rating) {
+                const std::string& country = countryDictionary().lookup(rating.country);
+                if (format == BatchFormat::Text) {
+                    out << country << ": " << rating.averageRating << "/5 over " << rating.albums << " album(s)\n";
+                    return;
+                }
+                out << "{\"type\":\"country_rating\",\"country\":";
+                out.quoted(country) << ",\"albums\":" << rating.albums << ",\"average_rating\":" << rating.averageRating << "}\n";
+            }
+
+            void groupStats(GroupBy by, const GroupSummary& summary) {
+                const std::string& name = groupDictionary(by).lookup(summary.key);
+                const GroupStats& stats = summary.stats;
+                if (format == BatchFormat::Text) {
+                    out << name << ": " << stats.songs << " song(s), " << stats.totalDuration << " minutes (average "
+                        << stats.averageDuration() << "), " << stats.albums << " album(s), average rating "
+                        << stats.averageRating() << "/5";
+                    if (stats.albums != 0) {
+                        out << ", years " << stats.firstYear() << '-' << stats.lastYear();
+                    }
+                    out << '\n';
+                    return;
+                }
+                out << "{\"type\":\"group_stats\",\"" << (by == GroupBy::Artist ? "artist" : "genre") << "\":";
+                out.quoted(name) << ",\"songs\":" << stats.songs << ",\"total_duration\":" << stats.totalDuration
+                                 << ",\"average_duration\":" << stats.averageDuration() << ",\"albums\":" << stats.albums
+                                 << ",\"average_rating\":" << stats.averageRating();
+                if (stats.albums != 0) {
+                    out << ",\"first_year\":" << stats.firstYear() << ",\"last_year\":" << stats.lastYear();
+                }
+                out << "}\n";
+            }
+
+            void operation(const OperationStats& op) {
+                if (format == BatchFormat::Text) {
+                    writeOperationLine(out, op);
+                    return;
+                }
+                out << "{\"type\":\"metrics\",\"name\":";
+                out.quoted(op.name()) << ",\"calls\":" << op.calls << ",\"total_ms\":" << op.totalMillis()
+                                      << ",\"mean_us\":" << op.meanMicros() << ",\"p50_us\":" << op.percentileMicros(0.50)
+                                      << ",\"p99_us\":" << op.percentileMicros(0.99) << ",\"max_us\":" << op.maxMicros()
+                                      << ",\"rows_scanned\":" << op.rowsScanned << ",\"rows_matched\":" << op.rowsMatched
+                                      << ",\"bytes_read\":" << op.bytesRead << ",\"bytes_written\":" << op.bytesWritten
+                                      << ",\"allocations\":" << op.allocations << "}\n";
+            }
+
+        private:
+            /**
+             * @brief One JSON object with the fields of a `T` (or of a view of one), keyed by their schema names.
+             */
+            template <typename T, typename Record>
+            void json(const Record& record) {
+                out << "{\"type\":\"" << RecordSchema<T>::name << '"';
+                forEachValue<T>(record, [&](const auto& field, const auto& value) {
+                    out << ",\"" << field.name << "\":";
+                    if constexpr (kindOf<decltype(field)> == FieldKind::Name) {
+                        out.quoted(field.dictionary().lookup(value));
+                    } else if constexpr (kindOf<decltype(field)> == FieldKind::Text) {
+                        out.quoted(value);
+                    } else {
+                        out << value;
+                    }
+                });
+                out << "}\n";
+            }
+
+            OutputBuffer& out;
+            BatchFormat format;
+        };
+
+        /**
+         * @brief Parses the `;`-separated arguments of an `add-*` command with the file parser,
+         * so a command line is read exactly like a line of the corresponding database file.
+         */
+        template <typename T, typename Parse>
+        bool parseRecord(std::string_view args, T& record, std::string& error, Parse parse) {
+            std::vector<T> parsed;
+            LoadReport report = parse(args, parsed);
+            if (parsed.size() != 1) {
+                error = report.errors.empty() ? "missing record" : report.errors.front().message;
+                return false;
+            }
+            record = std::move(parsed.front());
+            return true;
+        }
+
+        /**
+         * @brief Splits a command line into the command and its arguments.
+         * Returns false for blank lines and `#` comments.
+         */
+        inline bool splitCommand(std::string_view line, std::string_view& command, std::string_view& args) {
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            line = trimSpaces(line);
+            if (line.empty() || line.front() == '#') {
+                return false;
+            }
+            std::size_t space = line.find(' ');
+            command = line.substr(0, space);
+            args = space == std::string_view::npos ? std::string_view() : trimSpaces(line.substr(space + 1));
+            return true;
+        }
+
+        inline bool isChangeCommand(std::string_view command) {
+            return command == "add-song" || command == "add-artist" || command == "add-album" ||
+                   command == "upsert-song" || command == "upsert-artist" || command == "upsert-album" ||
+                   command == "remove-song" || command == "remove-artist" || command == "remove-album";
+        }
+
+        /**
+         * @brief Turns an `add-*`, `upsert-*` or `remove-*` command into the journal entry describing it,
+         * so every writer (the batch loop, the server) applies changes the same way.
+         */
+        inline bool parseChange(std::string_view command, std::string_view args, JournalEntry& entry, std::string& error) {
+            if (command == "add-song" || command == "upsert-song") {
+                entry.op = command == "add-song" ? JournalOp::AddSong : JournalOp::UpsertSong;
+                return parseRecord(args, entry.song, error, [](std::string_view a, std::vector<Song>& v) { return parseSongs(a, v); });
+            }
+            if (command == "add-artist" || command == "upsert-artist") {
+                entry.op = command == "add-artist" ? JournalOp::AddArtist : JournalOp::UpsertArtist;
+                return parseRecord(args, entry.artist, error, [](std::string_view a, std::vector<Artist>& v) { return parseArtists(a, v); });
+            }
+            if (command == "add-album" || command == "upsert-album") {
+                entry.op = command == "add-album" ? JournalOp::AddAlbum : JournalOp::UpsertAlbum;
+                return parseRecord(args, entry.album, error, [](std::string_view a, std::vector<Album>& v) { return parseAlbums(a, v); });
+            }
+            const std::size_t separator = command == "remove-artist" ? std::string_view::npos : args.find(';');
+            if (separator == std::string_view::npos) {
+                entry.op = command == "remove-song" ? JournalOp::RemoveSong : command == "remove-artist" ? JournalOp::RemoveArtist : JournalOp::RemoveAlbum;
+                entry.key = std::string(args);
+                return true;
+            }
+            entry.op = command == "remove-song" ? JournalOp::RemoveSongByKey : JournalOp::RemoveAlbumByKey;
+            entry.key = std::string(trimSpaces(args.substr(0, separator)));
+            entry.keyArtist = std::string(trimSpaces(args.substr(separator + 1)));
+            return true;
+        }
+
+        /**
+         * @brief Warning for a removal that matched nothing.
+         */
+        inline std::string missedRemoval(const JournalEntry& entry) {
+            switch (entry.op) {
+                case JournalOp::RemoveSong: return "no song titled '" + entry.key + "'";
+                case JournalOp::RemoveSongByKey: return "no song titled '" + entry.key + "' by '" + entry.keyArtist + "'";
+                case JournalOp::RemoveArtist: return "no artist named '" + entry.key + "'";
+                case JournalOp::RemoveAlbumByKey: return "no album named '" + entry.key + "' by '" + entry.keyArtist + "'";
+                default: return "no album named '" + entry.key + "'";
+            }
+        }
+
+        /**
+         * @brief Error for an add whose primary key is held by a record already.
+         */
+        inline std::string existingKey(const JournalEntry& entry) {
+            switch (entry.op) {
+                case JournalOp::AddSong:
+                    return "a song titled '" + std::string(entry.song.getTitle()) + "' by '" + entry.song.getArtist() +
+                           "' exists already";
+                case JournalOp::AddArtist: return "an artist named '" + entry.artist.getName() + "' exists already";
+                default:
+                    return "an album named '" + std::string(entry.album.getName()) + "' by '" + entry.album.getArtist() +
+                           "' exists already";
+            }
+        }
+    }
+
+    /**
+     * @brief Runs one read-only command against `library`, which is never modified, so
+     * queries can run on a shared snapshot. Returns false with `error` set for an unknown
+     * or malformed command; `warn` receives notes about lookups that found nothing.
+     */
+    template <typename Warn>
+    bool runQuery(const Library& library, std::string_view command, std::string_view args, detail::RecordPrinter& print,
+                  std::string& error, Warn warn) {
+        auto fail = [&error](const std::string& message) {
+            error = message;
+            return false;
+        };
+        if (command == "songs") {
+            for (std::size_t row = 0; row < library.getSongs().size(); ++row) {
+                if (!library.isSongRemoved(row)) {
+                    print.song(library.getSongs()[row]);
+                }
+            }
+        } else if (command == "artists") {
+            for (std::size_t row = 0; row < library.getArtists().size(); ++row) {
+                if (!library.isArtistRemoved(row)) {
+                    print.artist(library.getArtists()[row]);
+                }
+            }
+        } else if (command == "albums") {
+            for (std::size_t row = 0; row < library.getAlbums().size(); ++row) {
+                if (!library.isAlbumRemoved(row)) {
+                    print.album(library.getAlbums()[row]);
+                }
+            }
+        } else if (command == "by-artist" || command == "by-genre") {
+            const std::string key(args);
+            bool byArtist = command == "by-artist";
+            for (std::size_t row : byArtist ? library.findSongsByArtist(key) : library.findSongsByGenre(key)) {
+                print.song(library.getSongs()[row]);
+            }
+            for (std::size_t row : byArtist ? library.findAlbumsByArtist(key) : library.findAlbumsByGenre(key)) {
+                print.album(library.getAlbums()[row]);
+            }
+        } else if (command == "rank") {
+            std::size_t count = 0;
+            if (!args.empty() && !detail::parseNumber(args, count)) {
+                return fail("'" + std::string(args) + "' is not a count");
+            }
+            for (std::size_t row : library.rankAlbums(count)) {
+                print.album(library.getAlbums()[row]);
+            }
+        } else if (command == "filter-songs") {
+            SongFilter filter;
+            if (!parseSongFilter(args, filter, error)) {
+                return fail("invalid filter: " + error);
+            }
+            for (std::size_t row : library.filterSongs(filter)) {
+                print.song(library.getSongs()[row]);
+            }
+        } else if (command == "filter-albums") {
+            AlbumFilter filter;
+            if (!parseAlbumFilter(args, filter, error)) {
+                return fail("invalid filter: " + error);
+            }
+            for (std::size_t row : library.filterAlbums(filter)) {
+                print.album(library.getAlbums()[row]);
+            }
+        } else if (command == "songs-by-artists" || command == "albums-by-artists") {
+            ArtistFilter filter;
+            if (!parseArtistFilter(args, filter, error)) {
+                return fail("invalid filter: " + error);
+            }
+            if (command == "songs-by-artists") {
+                for (const JoinedRows& joined : joinSongsWithArtists(library, {}, filter)) {
+                    print.song(library.getSongs()[joined.left]);
+                }
+            } else {
+                for (const JoinedRows& joined : joinAlbumsWithArtists(library, {}, filter)) {
+                    print.album(library.getAlbums()[joined.left]);
+                }
+            }
+        } else if (command == "search" || command == "complete" || command == "fuzzy") {
+            const TextMatch match = command == "search" ? TextMatch::Substring : command == "complete" ? TextMatch::Prefix : TextMatch::Fuzzy;
+            const std::size_t limit = 10;
+            for (std::size_t row : library.searchSongs(args, match, limit)) {
+                print.song(library.getSongs()[row]);
+            }
+            for (std::size_t row : library.searchAlbums(args, match, limit)) {
+                print.album(library.getAlbums()[row]);
+            }
+            if (match == TextMatch::Fuzzy) {
+                // Also the artists that only songs or albums name
+                for (StringId id : library.searchArtistNames(args, match, limit)) {
+                    const std::string& name = artistDictionary().lookup(id);
+                    const std::size_t row = library.findArtist(name);
+                    if (row == noRow) {
+                        print.artistName(name);
+                    } else {
+                        print.artist(library.getArtists()[row]);
+                    }
+                }
+            } else {
+                for (std::size_t row : library.searchArtists(args, match, limit)) {
+                    print.artist(library.getArtists()[row]);
+                }
+            }
+        } else if (command == "stats") {
+            // stats artist|genre [name]
+            std::size_t split = args.find(' ');
+            std::string_view group = args.substr(0, split);
+            if (group != "artist" && group != "genre") {
+                return fail("stats needs 'artist' or 'genre'");
+            }
+            const GroupBy by = group == "artist" ? GroupBy::Artist : GroupBy::Genre;
+            if (split == std::string_view::npos) {
+                for (const GroupSummary& summary : library.groupStats(by)) {
+                    print.groupStats(by, summary);
+                }
+                return true;
+            }
+            const std::string name(detail::trimSpaces(args.substr(split + 1)));
+            GroupStats stats = library.groupStats(by, name);
+            if (stats.empty()) {
+                warn("no songs or albums for " + std::string(group) + " '" + name + "'");
+            } else {
+                print.groupStats(by, {groupDictionary(by).find(name), std::move(stats)});
+            }
+        } else if (command == "metrics") {
+            if (args == "reset") {
+                metrics().reset();
+            } else if (!args.empty()) {
+                return fail("metrics takes no argument but 'reset'");
+            } else {
+                for (const OperationStats& op : metrics().snapshot()) {
+                    print.operation(op);
+                }
+            }
+        } else if (command == "rating-by-country") {
+            for (const CountryRating& rating : averageAlbumRatingByCountry(library)) {
+                print.countryRating(rating);
+            }
+        } else {
+            return fail("unknown command '" + std::string(command) + "'");
+        }
+        return true;
+    }
+
+    /**
+     * @brief Runs every command read from `in` against `library`.
+     * Returns the number of lines that could not be executed.
+     */
+    inline std::size_t runBatch(std::istream& in, Library& library, OutputBuffer& out, BatchFormat format) {
+        detail::RecordPrinter print(out, format);
+        std::size_t failures = 0;
+        std::size_t lineNumber = 0;
+        std::string line;
+        auto fail = [&](const std::string& message) {
+            out.flush();
+            std::cerr << "Error - line " << lineNumber << ": " << message << std::endl;
+            ++failures;
+        };
+        auto warnAt = [&](std::size_t at, const std::string& message) {
+            out.flush();
+            std::cerr << "Warning - line " << at << ": " << message << std::endl;
+        };
+        auto warn = [&](const std::string& message) { warnAt(lineNumber, message); };
+
+        // The records of changes are parsed here and copied by the library
+        TextArena scratch;
+        TextArena::Scope parsing(scratch);
+        // Consecutive removals of one kind wait here and are made together
+        std::vector<JournalEntry> removals;
+        std::vector<std::size_t> removalLines;
+        auto flushRemovals = [&] {
+            std::vector<bool> changed = library.changeAll(removals);
+            for (std::size_t i = 0; i < removals.size(); ++i) {
+                if (!changed[i]) {
+                    warnAt(removalLines[i], detail::missedRemoval(removals[i]));
+                }
+            }
+            removals.clear();
+            removalLines.clear();
+        };
+
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            std::string_view command, args;
+            if (!detail::splitCommand(line, command, args)) {
+                continue;
+            }
+            std::string error;
+            JournalEntry entry;
+            const bool isChange = detail::isChangeCommand(command);
+            if (isChange && !detail::parseChange(command, args, entry, error)) {
+                flushRemovals();
+                fail(error);
+                continue;
+            }
+            const bool removal = isChange && isRemoval(entry.op);
+            if (!removals.empty() && (!removal || entry.op != removals.front().op)) {
+                flushRemovals();
+            }
+            if (removal) {
+                removals.push_back(std::move(entry));
+                removalLines.push_back(lineNumber);
+            } else if (isChange) {
+                if (!library.change(entry)) {
+                    fail(detail::existingKey(entry));
+                }
+                scratch.clear();
+            } else if (!runQuery(library, command, args, print, error, warn)) {
+                fail(error);
+            }
+        }
+        flushRemovals();
+        if (!out.flush()) {
+            std::cerr << "Error - cannot write the output!" << std::endl;
+            ++failures;
+        }
+        return failures;
+    }
+}
+
+#endif
@@ -0,0 +1,605 @@
+/**
+ * @file benchmark.cpp
+ * @brief Reproducible timings of the library's main operations on a set of database files.
+ *
+ * Covers loading and saving the text files, building the library and freeing the collections,
+ * searching by artist and genre (also with the operation metrics on), searching titles by
+ * prefix and substring and misspelled titles and artist names, removing songs, albums and
+ * artists (also followed by a compaction), primary key lookups and upserts, range filters
+ * with and without the range indexes and the query cache, ranking albums, per-genre and
+ * per-artist statistics, writing and scanning a page file through a small buffer pool, and a
+ * filtered scan straight over the songs file. Every case runs `--repeat` times; queries and
+ * removal keys are drawn from the data with a fixed seed, so two runs on the same files do
+ * the same work. Results go to stdout (or `--output`) as JSON or CSV, one entry per case
+ * with the minimum, median and maximum time and the time per operation.
+ *
+ * Usage: `benchmark [--data DIR] [--repeat N] [--queries N] [--removals N] [--format json|csv] [--output FILE]`
+ * The files are expected under the names the program uses; see `generate_library.cpp`.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "database_io.h"
+#include "library.h"
+#include "paged_store.h"
+#include "ranking.h"
+#include "stream_scan.h"
+#include "thread_pool.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Result {
+        std::string name;
+        std::size_t operations = 0;     // operations timed in one repetition
+        std::vector<double> seconds;    // one entry per repetition
+    };
+
+    struct Options {
+        std::filesystem::path dataDir = ".";
+        std::size_t repeat = 5;
+        std::size_t queries = 1000;
+        std::size_t removals = 20;
+        std::string format = "json";
+        std::string output;
+    };
+
+    struct Data {
+        std::vector<rc::Song> songs;
+        std::vector<rc::Artist> artists;
+        std::vector<rc::Album> albums;
+        std::shared_ptr<rc::TextArena> text = std::make_shared<rc::TextArena>();   // titles and names, shared by copies
+    };
+
+    /**
+     * @brief Runs `body` once per repetition; `body` returns the seconds it wants counted,
+     * so setup work such as copying the library can stay outside the measurement.
+     */
+    template <typename Body>
+    Result measure(const std::string& name, std::size_t operations, std::size_t repeat, Body body) {
+        Result result{name, operations, {}};
+        for (std::size_t i = 0; i < repeat; ++i) {
+            result.seconds.push_back(body());
+        }
+        std::cerr << "  " << name << " done" << std::endl;
+        return result;
+    }
+
+    template <typename Work>
+    double timed(Work work) {
+        auto start = Clock::now();
+        work();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    bool loadData(const Options& options, rc::ThreadPool& pool, Data& data) {
+        const std::string songsFile = (options.dataDir / "music_database.txt").string();
+        const std::string artistsFile = (options.dataDir / "artist_database.txt").string();
+        const std::string albumsFile = (options.dataDir / "album_database.txt").string();
+        auto songs = std::async(std::launch::async, [&] {
+            rc::TextArena::Scope scope(*data.text);
+            return rc::loadSongsFromFile(data.songs, songsFile, pool);
+        });
+        auto artists = std::async(std::launch::async, [&] { return rc::loadArtistsFromFile(data.artists, artistsFile, pool); });
+        auto albums = std::async(std::launch::async, [&] {
+            rc::TextArena::Scope scope(*data.text);
+            return rc::loadAlbumsFromFile(data.albums, albumsFile, pool);
+        });
+        bool opened = songs.get().opened;
+        opened = artists.get().opened && opened;
+        opened = albums.get().opened && opened;
+        return opened;
+    }
+
+    /**
+     * @brief Picks `count` keys with a fixed seed, following the data's own distribution.
+     */
+    template <typename T, typename Key>
+    std::vector<std::string> sampleKeys(const std::vector<T>& items, std::size_t count, std::uint64_t seed, Key key) {
+        std::vector<std::string> keys;
+        if (items.empty()) {
+            return keys;
+        }
+        std::mt19937_64 random(seed);
+        std::uniform_int_distribution<std::size_t> pick(0, items.size() - 1);
+        keys.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.emplace_back(key(items[pick(random)]));
+        }
+        return keys;
+    }
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        std::size_t middle = values.size() / 2;
+        return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    void writeResults(std::ostream& out, const Options& options, const Data& data, std::size_t threads, const std::vector<Result>& results) {
+        out.precision(9);
+        if (options.format == "csv") {
+            out << "name,operations,min_seconds,median_seconds,max_seconds,median_ns_per_op\n";
+            for (const auto& result : results) {
+                double mid = median(result.seconds);
+                out << result.name << ',' << result.operations << ','
+                    << *std::min_element(result.seconds.begin(), result.seconds.end()) << ',' << mid << ','
+                    << *std::max_element(result.seconds.begin(), result.seconds.end()) << ','
+                    << mid * 1e9 / static_cast<double>(std::max<std::size_t>(result.operations, 1)) << '\n';
+            }
+            return;
+        }
+        out << "{\n  \"threads\": " << threads
+            << ",\n  \"repeat\": " << options.repeat
+            << ",\n  \"rows\": {\"songs\": " << data.songs.size() << ", \"artists\": " << data.artists.size()
+            << ", \"albums\": " << data.albums.size() << "},\n  \"results\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            double mid = median(result.seconds);
+            out << "    {\"name\": \"" << result.name << "\", \"operations\": " << result.operations
+                << ", \"min_seconds\": " << *std::min_element(result.seconds.begin(), result.seconds.end())
+                << ", \"median_seconds\": " << mid
+                << ", \"max_seconds\": " << *std::max_element(result.seconds.begin(), result.seconds.end())
+                << ", \"median_ns_per_op\": " << mid * 1e9 / static_cast<double>(std::max<std::size_t>(result.operations, 1))
+                << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+    bool parseSize(const char* text, std::size_t& value) {
+        char* end = nullptr;
+        unsigned long long parsed = std::strtoull(text, &end, 10);
+        value = static_cast<std::size_t>(parsed);
+        return end != text && *end == '\0' && parsed > 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error - missing value for " << option << std::endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (option == "--data") {
+            options.dataDir = value;
+        } else if (option == "--repeat") {
+            ok = parseSize(value, options.repeat);
+        } else if (option == "--queries") {
+            ok = parseSize(value, options.queries);
+        } else if (option == "--removals") {
+            ok = parseSize(value, options.removals);
+        } else if (option == "--format") {
+            options.format = value;
+            ok = options.format == "json" || options.format == "csv";
+        } else if (option == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--data DIR] [--repeat N] [--queries N] [--removals N]"
+                      << " [--format json|csv] [--output FILE]" << std::endl;
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Error - invalid value for " << option << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    // The cases measure the operations themselves; `search_songs_by_artist_timed` shows what
+    // the instrumentation of `metrics.h` adds to them
+    rc::metrics().setEnabled(false);
+    rc::ThreadPool pool;
+    Data data;
+    std::cerr << "Loading " << options.dataDir.string() << std::endl;
+    if (!loadData(options, pool, data)) {
+        std::cerr << "Error - cannot open the database files in " << options.dataDir.string() << "!" << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    const std::size_t repeat = options.repeat;
+
+    results.push_back(measure("load", 3, repeat, [&] {
+        Data fresh;
+        return timed([&] { loadData(options, pool, fresh); });
+    }));
+
+    const std::filesystem::path saveDir = std::filesystem::temp_directory_path();
+    results.push_back(measure("save", 3, repeat, [&] {
+        double seconds = timed([&] {
+            rc::saveSongsToFile(data.songs, (saveDir / "rc_benchmark_songs.txt").string());
+            rc::saveArtistsToFile(data.artists, (saveDir / "rc_benchmark_artists.txt").string());
+            rc::saveAlbumsToFile(data.albums, (saveDir / "rc_benchmark_albums.txt").string());
+        });
+        std::error_code ec;
+        for (const char* name : {"rc_benchmark_songs.txt", "rc_benchmark_artists.txt", "rc_benchmark_albums.txt"}) {
+            std::filesystem::remove(saveDir / name, ec);
+        }
+        return seconds;
+    }));
+
+    // The same files in the compressed form: kept until the load case below has read them
+    const std::string packedNames[3] = {(saveDir / "rc_benchmark_songs.pack").string(),
+                                        (saveDir / "rc_benchmark_artists.pack").string(),
+                                        (saveDir / "rc_benchmark_albums.pack").string()};
+    results.push_back(measure("save_compressed", 3, repeat, [&] {
+        return timed([&] {
+            rc::saveSongsToFile(data.songs, packedNames[0], rc::StorageFormat::Compressed);
+            rc::saveArtistsToFile(data.artists, packedNames[1], rc::StorageFormat::Compressed);
+            rc::saveAlbumsToFile(data.albums, packedNames[2], rc::StorageFormat::Compressed);
+        });
+    }));
+
+    results.push_back(measure("load_compressed", 3, repeat, [&] {
+        Data fresh;
+        double seconds = timed([&] {
+            auto songs = std::async(std::launch::async, [&] {
+                rc::TextArena::Scope scope(*fresh.text);
+                return rc::loadSongsFromFile(fresh.songs, packedNames[0], pool);
+            });
+            auto artists = std::async(std::launch::async, [&] { return rc::loadArtistsFromFile(fresh.artists, packedNames[1], pool); });
+            auto albums = std::async(std::launch::async, [&] {
+                rc::TextArena::Scope scope(*fresh.text);
+                return rc::loadAlbumsFromFile(fresh.albums, packedNames[2], pool);
+            });
+            songs.get();
+            artists.get();
+            albums.get();
+        });
+        if (fresh.songs.size() != data.songs.size() || fresh.albums.size() != data.albums.size()) {
+            std::cerr << "Warning - the compressed files did not load completely" << std::endl;
+        }
+        return seconds;
+    }));
+    for (const std::string& name : packedNames) {
+        std::error_code ec;
+        std::filesystem::remove(name, ec);
+    }
+
+    results.push_back(measure("build_library", 1, repeat, [&] {
+        Data copy = data;
+        return timed([&] { rc::Library library(std::move(copy.songs), std::move(copy.artists), std::move(copy.albums), copy.text); });
+    }));
+
+    results.push_back(measure("free_collections", 1, repeat, [&] {
+        auto copy = std::make_unique<Data>(data);
+        return timed([&] { copy.reset(); });
+    }));
+
+    rc::Library library(data.songs, data.artists, data.albums, data.text);
+    library.enableRankingIndex();
+
+    // Searches: keys follow the data, so popular artists and genres are queried more often
+    std::size_t found = 0;
+    auto songArtists = sampleKeys(data.songs, options.queries, 1, [](const rc::Song& s) { return s.getArtist(); });
+    results.push_back(measure("search_songs_by_artist", songArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : songArtists) {
+                found += library.findSongsByArtist(key).size();
+            }
+        });
+    }));
+    rc::metrics().setEnabled(true);
+    results.push_back(measure("search_songs_by_artist_timed", songArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : songArtists) {
+                found += library.findSongsByArtist(key).size();
+            }
+        });
+    }));
+    rc::metrics().setEnabled(false);
+    auto songGenres = sampleKeys(data.songs, options.queries, 2, [](const rc::Song& s) { return s.getGenre(); });
+    results.push_back(measure("search_songs_by_genre", songGenres.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : songGenres) {
+                found += library.findSongsByGenre(key).size();
+            }
+        });
+    }));
+    auto albumArtists = sampleKeys(data.albums, options.queries, 3, [](const rc::Album& a) { return a.getArtist(); });
+    results.push_back(measure("search_albums_by_artist", albumArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : albumArtists) {
+                found += library.findAlbumsByArtist(key).size();
+            }
+        });
+    }));
+    auto albumGenres = sampleKeys(data.albums, options.queries, 4, [](const rc::Album& a) { return a.getGenre(); });
+    results.push_back(measure("search_albums_by_genre", albumGenres.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : albumGenres) {
+                found += library.findAlbumsByGenre(key).size();
+            }
+        });
+    }));
+
+    results.push_back(measure("build_text_search", 1, repeat, [&] {
+        rc::Library copy(data.songs, data.artists, data.albums, data.text);
+        return timed([&] { copy.enableTextSearch(); });
+    }));
+    library.enableTextSearch();
+    // Title fragments: the first word (prefix) and a few inner characters (substring) of sampled titles
+    auto titles = sampleKeys(data.songs, options.queries, 8, [](const rc::Song& s) { return s.getTitle(); });
+    results.push_back(measure("search_title_prefix", titles.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& title : titles) {
+                found += library.searchSongs(std::string_view(title).substr(0, title.find(' ')), rc::TextMatch::Prefix, 10).size();
+            }
+        });
+    }));
+    results.push_back(measure("search_title_substring", titles.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& title : titles) {
+                found += library.searchSongs(std::string_view(title).substr(title.size() / 3, 4), rc::TextMatch::Substring, 10).size();
+            }
+        });
+    }));
+    // Misspelled names: sampled titles and artist names with one character replaced, in lower case
+    auto misspell = [](std::string text) {
+        for (auto& c : text) {
+            c = rc::detail::foldCase(c);
+        }
+        if (!text.empty()) {
+            text[text.size() / 2] = text[text.size() / 2] == 'x' ? 'y' : 'x';
+        }
+        return text;
+    };
+    std::vector<std::string> misspelledTitles, misspelledArtists;
+    for (const auto& title : titles) {
+        misspelledTitles.push_back(misspell(title));
+    }
+    for (const auto& name : sampleKeys(data.artists, options.queries, 9, [](const rc::Artist& a) { return a.getName(); })) {
+        misspelledArtists.push_back(misspell(name));
+    }
+    results.push_back(measure("search_title_fuzzy", misspelledTitles.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& title : misspelledTitles) {
+                found += library.searchSongs(title, rc::TextMatch::Fuzzy, 10).size();
+            }
+        });
+    }));
+    results.push_back(measure("search_artist_fuzzy", misspelledArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& name : misspelledArtists) {
+                found += library.searchArtists(name, rc::TextMatch::Fuzzy, 10).size();
+            }
+        });
+    }));
+    // The same names among every artist the songs and albums name, not only the artist records
+    results.push_back(measure("search_artist_name_fuzzy", misspelledArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& name : misspelledArtists) {
+                found += library.searchArtistNames(name, rc::TextMatch::Fuzzy, 10).size();
+            }
+        });
+    }));
+
+    // Removals mutate the library, so each repetition works on a fresh copy built outside the timer
+    auto removeCase = [&](const std::string& name, std::vector<std::string> keys, bool keyed, auto remove) {
+        results.push_back(measure(name, keys.size(), repeat, [&] {
+            rc::Library copy(data.songs, data.artists, data.albums, data.text);
+            copy.enableRankingIndex();
+            if (keyed) {
+                copy.enablePrimaryKeys();
+            }
+            return timed([&] { remove(copy, keys); });
+        }));
+    };
+    auto oneByOne = [](auto remove) {
+        return [remove](rc::Library& l, const std::vector<std::string>& keys) {
+            for (const auto& key : keys) {
+                remove(l, key);
+            }
+        };
+    };
+    auto songTitles = sampleKeys(data.songs, options.removals, 5, [](const rc::Song& s) { return s.getTitle(); });
+    removeCase("remove_song", songTitles, false, oneByOne([](rc::Library& l, const std::string& key) { l.removeSong(key); }));
+    removeCase("remove_song_keyed", songTitles, true, oneByOne([](rc::Library& l, const std::string& key) { l.removeSong(key); }));
+    removeCase("remove_songs_batch", songTitles, true, [](rc::Library& l, const std::vector<std::string>& keys) { l.removeSongs(keys); });
+    // The same sampled songs, by title and artist (the same seed picks the same songs)
+    auto songTitleArtists = sampleKeys(data.songs, options.removals, 5, [](const rc::Song& s) { return s.getArtist(); });
+    removeCase("remove_song_by_key", songTitles, true, [&songTitleArtists](rc::Library& l, const std::vector<std::string>& keys) {
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            l.removeSong(keys[i], songTitleArtists[i]);
+        }
+    });
+    // Removals only mark the rows; this one also pays for erasing them afterwards
+    removeCase("remove_song_by_key_compact", songTitles, true, [&songTitleArtists](rc::Library& l, const std::vector<std::string>& keys) {
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            l.removeSong(keys[i], songTitleArtists[i]);
+        }
+        l.compact();
+    });
+    removeCase("remove_album", sampleKeys(data.albums, options.removals, 6, [](const rc::Album& a) { return a.getName(); }), false,
+               oneByOne([](rc::Library& l, const std::string& key) { l.removeAlbum(key); }));
+    removeCase("remove_artist", sampleKeys(data.artists, options.removals, 7, [](const rc::Artist& a) { return a.getName(); }), false,
+               oneByOne([](rc::Library& l, const std::string& key) { l.removeArtist(key); }));
+
+    // Primary key lookups and in-place replacements of existing songs
+    std::vector<rc::Song> changedSongs;
+    {
+        std::mt19937_64 random(8);
+        std::uniform_int_distribution<std::size_t> pick(0, data.songs.empty() ? 0 : data.songs.size() - 1);
+        for (std::size_t i = 0; i < options.queries && !data.songs.empty(); ++i) {
+            const rc::Song& song = data.songs[pick(random)];
+            changedSongs.emplace_back(song.getTitle(), song.getDuration() + 1.0, song.getGenreId(), song.getArtistId());
+        }
+    }
+    library.enablePrimaryKeys();
+    results.push_back(measure("find_song_by_key", changedSongs.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& song : changedSongs) {
+                found += library.findSong(song.getTitle(), song.getArtist()) != rc::noRow;
+            }
+        });
+    }));
+    results.push_back(measure("upsert_song", changedSongs.size(), repeat, [&] {
+        rc::Library copy(data.songs, data.artists, data.albums, data.text);
+        copy.enableColumnStore();
+        copy.enablePrimaryKeys();
+        return timed([&] {
+            for (const auto& song : changedSongs) {
+                copy.upsertSong(song);
+            }
+        });
+    }));
+
+    // Range filters: the column store scan, then the same filters through the sorted range indexes
+    struct RangeCase {
+        const char* name;
+        const char* text;
+        bool albums;
+    };
+    const RangeCase rangeCases[] = {
+        {"filter_albums_decade_rated", "year >= 1995 and year <= 2005 and rating >= 4.0", true},
+        {"filter_albums_year_top", "year = 1980 and rating >= 4.5", true},
+        {"filter_songs_short", "duration < 3", false},
+        {"filter_songs_long", "duration >= 7.5", false},
+    };
+    auto rangeFilters = [&](const char* suffix) {
+        for (const RangeCase& range : rangeCases) {
+            rc::SongFilter songFilter;
+            rc::AlbumFilter albumFilter;
+            std::string error;
+            if (range.albums ? !rc::parseAlbumFilter(range.text, albumFilter, error) : !rc::parseSongFilter(range.text, songFilter, error)) {
+                continue;
+            }
+            results.push_back(measure(std::string(range.name) + suffix, 1, repeat, [&] {
+                return timed([&] {
+                    found += range.albums ? library.filterAlbums(albumFilter).size() : library.filterSongs(songFilter).size();
+                });
+            }));
+        }
+    };
+    library.enableColumnStore();
+    rangeFilters("_scan");
+    results.push_back(measure("build_range_indexes", 1, repeat, [&] {
+        rc::Library copy(data.songs, data.artists, data.albums, data.text);
+        return timed([&] { copy.enableRangeIndexes(); });
+    }));
+    library.enableRangeIndexes();
+    rangeFilters("_index");
+    // Changes with the range indexes kept up to date: each upsert moves a song to its new
+    // duration, each add places a new album by year and by rating
+    results.push_back(measure("upsert_song_ranged", changedSongs.size(), repeat, [&] {
+        rc::Library copy(data.songs, data.artists, data.albums, data.text);
+        copy.enablePrimaryKeys();
+        copy.enableRangeIndexes();
+        return timed([&] {
+            for (const auto& song : changedSongs) {
+                copy.upsertSong(song);
+            }
+        });
+    }));
+    std::vector<rc::Album> addedAlbums;
+    for (std::size_t i = 0; i < options.queries && i < data.albums.size(); ++i) {
+        const rc::Album& album = data.albums[i];
+        // A new name, since an add of a key that exists already is rejected
+        addedAlbums.emplace_back(std::string(album.getName()) + " (Reissue)", album.getArtistId(), album.getYear() + 1,
+                                 album.getRating(), album.getGenreId());
+    }
+    results.push_back(measure("add_album_ranged", addedAlbums.size(), repeat, [&] {
+        rc::Library copy(data.songs, data.artists, data.albums, data.text);
+        copy.enablePrimaryKeys();
+        copy.enableRangeIndexes();
+        return timed([&] {
+            for (const auto& album : addedAlbums) {
+                copy.addAlbum(album);
+            }
+        });
+    }));
+    // The same filters repeated with the query cache on: only the first repetition computes them
+    library.enableQueryCache(std::size_t(64) << 20);
+    rangeFilters("_cached");
+    library.enableQueryCache(0);
+
+    results.push_back(measure("rank_top10_select", 1, repeat, [&] {
+        return timed([&] { found += rc::topAlbums(data.albums, 10).size(); });
+    }));
+    results.push_back(measure("rank_top10_index", 1, repeat, [&] {
+        return timed([&] { found += library.rankAlbums(10).size(); });
+    }));
+    results.push_back(measure("rank_all", 1, repeat, [&] {
+        return timed([&] { found += rc::topAlbums(data.albums, 0).size(); });
+    }));
+
+    // Group-by statistics: one pass over the collections versus the aggregates kept up to date
+    results.push_back(measure("group_by_genre_scan", 1, repeat, [&] {
+        return timed([&] { found += library.groupStats(rc::GroupBy::Genre).size(); });
+    }));
+    library.enableAggregates();
+    results.push_back(measure("group_by_genre_maintained", 1, repeat, [&] {
+        return timed([&] { found += library.groupStats(rc::GroupBy::Genre).size(); });
+    }));
+    results.push_back(measure("group_stats_by_artist", songArtists.size(), repeat, [&] {
+        return timed([&] {
+            for (const auto& key : songArtists) {
+                found += library.groupStats(rc::GroupBy::Artist, key).songs;
+            }
+        });
+    }));
+
+    // Out-of-core storage: the pool holds a small fraction of the page file, so the scans
+    // read from the file rather than from the pool
+    const std::string pagesFile = (saveDir / "rc_benchmark.pages").string();
+    results.push_back(measure("export_pages", 3, repeat, [&] {
+        rc::FileLoad loads[3];
+        std::string error;
+        return timed([&] {
+            rc::convertToPageFile((options.dataDir / "music_database.txt").string(), (options.dataDir / "artist_database.txt").string(),
+                                  (options.dataDir / "album_database.txt").string(), pagesFile, loads, error);
+        });
+    }));
+    results.push_back(measure("paged_scan_songs", 1, repeat, [&] {
+        rc::PagedLibrary paged;
+        std::string error;
+        if (!paged.open(pagesFile, 4 << 20, error)) {
+            return 0.0;
+        }
+        return timed([&] {
+            paged.scanSongs([&](const rc::SongView& song) {
+                found += song.getDuration() > 5.0;
+                return true;
+            });
+        });
+    }));
+    std::error_code removeError;
+    std::filesystem::remove(pagesFile, removeError);
+
+    // One query without loading anything: the songs of one genre straight from the file
+    rc::SongFilter genreFilter;
+    std::string filterError;
+    if (!songGenres.empty() && rc::parseSongFilter("genre = \"" + songGenres.front() + "\"", genreFilter, filterError)) {
+        results.push_back(measure("stream_scan_songs_by_genre", 1, repeat, [&] {
+            return timed([&] {
+                rc::scanSongsFile((options.dataDir / "music_database.txt").string(), genreFilter, pool,
+                                  [&found](const rc::Song&) { ++found; });
+            });
+        }));
+    }
+
+    std::cerr << "Matched " << found << " rows in total" << std::endl;
+    if (options.output.empty()) {
+        writeResults(std::cout, options, data, pool.size(), results);
+    } else {
+        std::ofstream out(options.output);
+        if (!out.is_open()) {
+            std::cerr << "Error - cannot open the file!" << std::endl;
+            return 1;
+        }
+        writeResults(out, options, data, pool.size(), results);
+    }
+    return 0;
+}
@@ -0,0 +1,352 @@
+/**
+ * @file column_store.h
+ * @brief Optional struct-of-arrays copy of the numeric and interned fields of songs and albums.
+ *
+ * Filters on duration, year, rating, genre or artist run over these contiguous columns with
+ * SIMD compare kernels that produce a selection bitmap, one bit per row. Only the rows whose
+ * bit survives every condition are looked up in the record vectors afterwards.
+ */
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "song.h"
+#include "album.h"
+#include "filter.h"
+#include "row_remap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RC_COLUMNS_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rc {
+    /**
+     * @brief One bit per row; bits past `size()` in the last word are always zero.
+     */
+    class SelectionBitmap {
+    public:
+        SelectionBitmap() = default;
+        explicit SelectionBitmap(std::size_t rows) : bits(rows), words((rows + 63) / 64, 0) {}
+
+        std::size_t size() const { return bits; }
+        std::uint64_t* data() { return words.data(); }
+        const std::uint64_t* data() const { return words.data(); }
+        std::size_t wordCount() const { return words.size(); }
+
+        bool test(std::size_t row) const { return (words[row / 64] >> (row % 64)) & 1u; }
+
+        SelectionBitmap& operator&=(const SelectionBitmap& other) {
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                words[i] &= other.words[i];
+            }
+            return *this;
+        }
+
+        void setAll() {
+            std::fill(words.begin(), words.end(), ~std::uint64_t(0));
+            if (bits % 64 != 0) {
+                words.back() &= (std::uint64_t(1) << (bits % 64)) - 1;
+            }
+        }
+
+        std::size_t count() const {
+            std::size_t total = 0;
+            for (std::uint64_t word : words) {
+                total += popcount(word);
+            }
+            return total;
+        }
+
+        /**
+         * @brief Returns the selected rows in ascending order.
+         */
+        std::vector<std::size_t> rows() const {
+            std::vector<std::size_t> result;
+            result.reserve(count());
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                std::uint64_t word = words[i];
+                while (word != 0) {
+                    result.push_back(i * 64 + lowestBit(word));
+                    word &= word - 1;
+                }
+            }
+            return result;
+        }
+
+    private:
+        static std::size_t popcount(std::uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            return static_cast<std::size_t>(__popcnt64(word));
+#elif defined(_MSC_VER)
+            std::size_t total = 0;
+            for (; word != 0; word &= word - 1) {
+                ++total;
+            }
+            return total;
+#else
+            return static_cast<std::size_t>(__builtin_popcountll(word));
+#endif
+        }
+
+        static std::size_t lowestBit(std::uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, word);
+            return index;
+#elif defined(_MSC_VER)
+            std::size_t index = 0;
+            while ((word & 1u) == 0) {
+                word >>= 1;
+                ++index;
+            }
+            return index;
+#else
+            return static_cast<std::size_t>(__builtin_ctzll(word));
+#endif
+        }
+
+        std::size_t bits = 0;
+        std::vector<std::uint64_t> words;
+    };
+
+    namespace kernels {
+        /**
+         * @brief Scalar tail shared by every kernel: fills bits [from, n) of `out`.
+         */
+        template <typename T, typename Pred>
+        void compareScalar(const T* values, std::size_t from, std::size_t n, Pred pred, std::uint64_t* out) {
+            for (std::size_t i = from; i < n; ++i) {
+                if (pred(values[i])) {
+                    out[i / 64] |= std::uint64_t(1) << (i % 64);
+                }
+            }
+        }
+
+        /**
+         * @brief Writes `values[i] op bound` for every row into `out` (which must be zeroed).
+         */
+        inline void compareDoubles(const double* values, std::size_t n, Compare op, double bound, std::uint64_t* out) {
+            std::size_t i = 0;
+#ifdef RC_COLUMNS_SSE2
+            const __m128d b = _mm_set1_pd(bound);
+            for (; i + 64 <= n; i += 64) {
+                std::uint64_t word = 0;
+                for (std::size_t j = 0; j < 64; j += 2) {
+                    __m128d v = _mm_loadu_pd(values + i + j);
+                    __m128d hit;
+                    switch (op) {
+                        case Compare::Less: hit = _mm_cmplt_pd(v, b); break;
+                        case Compare::LessEqual: hit = _mm_cmple_pd(v, b); break;
+                        case Compare::Greater: hit = _mm_cmpgt_pd(v, b); break;
+                        case Compare::GreaterEqual: hit = _mm_cmpge_pd(v, b); break;
+                        default: hit = _mm_cmpeq_pd(v, b); break;
+                    }
+                    word |= static_cast<std::uint64_t>(_mm_movemask_pd(hit)) << j;
+                }
+                out[i / 64] = word;
+            }
+#endif
+            compareScalar(values, i, n, [op, bound](double v) { return compareValues(v, op, bound); }, out);
+        }
+
+        inline void compareInts(const std::int32_t* values, std::size_t n, Compare op, std::int32_t bound, std::uint64_t* out) {
+            std::size_t i = 0;
+#ifdef RC_COLUMNS_SSE2
+            const __m128i b = _mm_set1_epi32(bound);
+            const __m128i ones = _mm_set1_epi32(-1);
+            for (; i + 64 <= n; i += 64) {
+                std::uint64_t word = 0;
+                for (std::size_t j = 0; j < 64; j += 4) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + j));
+                    __m128i hit;
+                    switch (op) {
+                        case Compare::Less: hit = _mm_cmplt_epi32(v, b); break;
+                        case Compare::LessEqual: hit = _mm_xor_si128(_mm_cmpgt_epi32(v, b), ones); break;
+                        case Compare::Greater: hit = _mm_cmpgt_epi32(v, b); break;
+                        case Compare::GreaterEqual: hit = _mm_xor_si128(_mm_cmplt_epi32(v, b), ones); break;
+                        default: hit = _mm_cmpeq_epi32(v, b); break;
+                    }
+                    word |= static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(hit))) << j;
+                }
+                out[i / 64] = word;
+            }
+#endif
+            compareScalar(values, i, n, [op, bound](std::int32_t v) { return compareValues(v, op, bound); }, out);
+        }
+
+        inline void equalIds(const StringId* values, std::size_t n, StringId id, std::uint64_t* out) {
+            std::size_t i = 0;
+#ifdef RC_COLUMNS_SSE2
+            const __m128i b = _mm_set1_epi32(static_cast<int>(id));
+            for (; i + 64 <= n; i += 64) {
+                std::uint64_t word = 0;
+                for (std::size_t j = 0; j < 64; j += 4) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + j));
+                    word |= static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, b)))) << j;
+                }
+                out[i / 64] = word;
+            }
+#endif
+            compareScalar(values, i, n, [id](StringId v) { return v == id; }, out);
+        }
+
+        /**
+         * @brief Converts an integer-field condition to an `int32` bound, keeping fractional bounds exact
+         * (e.g. `year > 2014.5` becomes `year >= 2015`).
+         */
+        inline bool intBound(Compare& op, double value, std::int32_t& bound) {
+            value = std::max(-2147483648.0, std::min(2147483647.0, value));
+            double floorValue = static_cast<double>(static_cast<long long>(value));
+            if (floorValue > value) {
+                floorValue -= 1.0;
+            }
+            if (floorValue == value) {
+                bound = static_cast<std::int32_t>(value);
+                return true;
+            }
+            switch (op) {
+                case Compare::Less:
+                case Compare::LessEqual: op = Compare::LessEqual; bound = static_cast<std::int32_t>(floorValue); return true;
+                case Compare::Greater:
+                case Compare::GreaterEqual: op = Compare::GreaterEqual; bound = static_cast<std::int32_t>(floorValue) + 1; return true;
+                default: return false;
+            }
+        }
+    }
+
+    /**
+     * @brief Column copy of the filterable song fields, kept row-aligned with the song vector.
+     */
+    class SongColumns {
+    public:
+        void append(const Song& song) {
+            duration.push_back(song.getDuration());
+            genre.push_back(song.getGenreId());
+            artist.push_back(song.getArtistId());
+        }
+
+        void set(std::size_t row, const Song& song) {
+            duration[row] = song.getDuration();
+            genre[row] = song.getGenreId();
+            artist[row] = song.getArtistId();
+        }
+
+        // The hooks that keep the columns in step with the songs, like the library's indexes
+        void insert(const std::vector<Song>& songs, std::size_t row) { append(songs[row]); }
+        void replace(const std::vector<Song>& songs, std::size_t row, const Song&) { set(row, songs[row]); }
+        // A removed song keeps its row until the rows are erased; the library drops it from the selections
+        void remove(const std::vector<Song>&, std::size_t) {}
+
+        void eraseRows(const std::vector<Song>&, const std::vector<std::size_t>& removedRows) {
+            detail::eraseColumnRows(duration, removedRows);
+            detail::eraseColumnRows(genre, removedRows);
+            detail::eraseColumnRows(artist, removedRows);
+        }
+
+        void clear() {
+            duration.clear();
+            genre.clear();
+            artist.clear();
+        }
+
+        std::size_t size() const { return duration.size(); }
+
+        SelectionBitmap select(const SongFilter& filter) const {
+            SelectionBitmap result(size());
+            result.setAll();
+            for (const auto& condition : filter) {
+                SelectionBitmap hits(size());
+                switch (condition.field) {
+                    case SongField::Duration: kernels::compareDoubles(duration.data(), size(), condition.op, condition.number, hits.data()); break;
+                    case SongField::Genre: kernels::equalIds(genre.data(), size(), condition.id, hits.data()); break;
+                    case SongField::Artist: kernels::equalIds(artist.data(), size(), condition.id, hits.data()); break;
+                }
+                result &= hits;
+            }
+            return result;
+        }
+
+    private:
+        std::vector<double> duration;
+        std::vector<StringId> genre;
+        std::vector<StringId> artist;
+    };
+
+    /**
+     * @brief Column copy of the filterable album fields, kept row-aligned with the album vector.
+     */
+    class AlbumColumns {
+    public:
+        void append(const Album& album) {
+            year.push_back(album.getYear());
+            rating.push_back(album.getRating());
+            genre.push_back(album.getGenreId());
+            artist.push_back(album.getArtistId());
+        }
+
+        void set(std::size_t row, const Album& album) {
+            year[row] = album.getYear();
+            rating[row] = album.getRating();
+            genre[row] = album.getGenreId();
+            artist[row] = album.getArtistId();
+        }
+
+        void insert(const std::vector<Album>& albums, std::size_t row) { append(albums[row]); }
+        void replace(const std::vector<Album>& albums, std::size_t row, const Album&) { set(row, albums[row]); }
+        void remove(const std::vector<Album>&, std::size_t) {}
+
+        void eraseRows(const std::vector<Album>&, const std::vector<std::size_t>& removedRows) {
+            detail::eraseColumnRows(year, removedRows);
+            detail::eraseColumnRows(rating, removedRows);
+            detail::eraseColumnRows(genre, removedRows);
+            detail::eraseColumnRows(artist, removedRows);
+        }
+
+        void clear() {
+            year.clear();
+            rating.clear();
+            genre.clear();
+            artist.clear();
+        }
+
+        std::size_t size() const { return year.size(); }
+
+        SelectionBitmap select(const AlbumFilter& filter) const {
+            SelectionBitmap result(size());
+            result.setAll();
+            for (const auto& condition : filter) {
+                SelectionBitmap hits(size());
+                switch (condition.field) {
+                    case AlbumField::Year: {
+                        Compare op = condition.op;
+                        std::int32_t bound;
+                        if (kernels::intBound(op, condition.number, bound)) {
+                            kernels::compareInts(year.data(), size(), op, bound, hits.data());
+                        }
+                        break;
+                    }
+                    case AlbumField::Rating: kernels::compareDoubles(rating.data(), size(), condition.op, condition.number, hits.data()); break;
+                    case AlbumField::Genre: kernels::equalIds(genre.data(), size(), condition.id, hits.data()); break;
+                    case AlbumField::Artist: kernels::equalIds(artist.data(), size(), condition.id, hits.data()); break;
+                }
+                result &= hits;
+            }
+            return result;
+        }
+
+    private:
+        std::vector<std::int32_t> year;
+        std::vector<double> rating;
+        std::vector<StringId> genre;
+        std::vector<StringId> artist;
+    };
+}
+
+#endif
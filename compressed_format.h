@@ -0,0 +1,804 @@
+/**
+ * @file compressed_format.h
+ * @brief Compressed columnar form of the three database files.
+ *
+ * A compressed file holds the same records as the text file it stands in for, cut into
+ * blocks of up to 16384 rows. Inside a block every field is stored as its own column:
+ * - titles and names: varint lengths, then the bytes;
+ * - genres, artists and countries: varint indexes into string tables stored once per file;
+ * - durations and ratings: fixed-point hundredths as zigzag varints, with an escape to the
+ *   raw double for the values hundredths cannot represent exactly, so nothing is rounded;
+ * - years: zigzag varint deltas from the previous row.
+ * The block is then compressed with a small LZ77 coder (matches found through a hash of
+ * 4-byte sequences within a 64 KiB window) and checksummed. Blocks depend only on the
+ * string tables, so they are decoded in parallel.
+ *
+ * File layout: header (magic `RCPACKDB`, version, byte order, kind, block count, rows),
+ * the blocks, the genre, artist and country tables, then the block directory. The loaders
+ * in `database_io.h` recognize the magic, so either form can be used for any of the files.
+ */
+#ifndef COMPRESSED_FORMAT_H
+#define COMPRESSED_FORMAT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "journal.h"
+#include "loader.h"
+#include "string_dictionary.h"
+#include "thread_pool.h"
+
+namespace rc {
+    inline constexpr char compressedMagic[8] = {'R', 'C', 'P', 'A', 'C', 'K', 'D', 'B'};
+    inline constexpr std::uint32_t compressedVersion = 1;
+    inline constexpr std::uint32_t compressedByteOrder = 0x01020304;
+
+    enum class CompressedKind : std::uint32_t {
+        Songs = 1,
+        Artists = 2,
+        Albums = 3
+    };
+
+    /**
+     * @brief True if `data` starts like a compressed database file.
+     */
+    inline bool isCompressedData(std::string_view data) {
+        return data.size() >= sizeof(compressedMagic) &&
+               std::memcmp(data.data(), compressedMagic, sizeof(compressedMagic)) == 0;
+    }
+
+    namespace detail {
+        constexpr std::size_t compressedBlockRows = 16384;
+        constexpr std::size_t maxBlockBytes = std::size_t(1) << 28;
+
+        struct CompressedHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint32_t kind;
+            std::uint32_t blockCount;
+            std::uint64_t rows;
+            std::uint64_t tablesOffset;      // the string tables follow the blocks
+            std::uint64_t directoryOffset;   // the block directory ends the file
+        };
+
+        struct CompressedBlockEntry {
+            std::uint64_t offset;
+            std::uint32_t packedSize;   // equal to rawSize when the block is stored as is
+            std::uint32_t rawSize;
+            std::uint32_t rows;
+            std::uint32_t checksum;     // over the stored bytes
+        };
+
+        // String tables, in file order
+        enum CompressedTable : std::size_t { GenreTable = 0, ArtistTable = 1, CountryTable = 2, tableCount = 3 };
+
+        inline StringDictionary& tableDictionary(std::size_t table) {
+            return table == GenreTable ? genreDictionary() : table == ArtistTable ? artistDictionary() : countryDictionary();
+        }
+
+        inline void putVarint(std::string& out, std::uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        inline std::uint64_t zigzag(std::int64_t value) {
+            return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+        }
+
+        inline std::int64_t unzigzag(std::uint64_t value) {
+            return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+        }
+
+        /**
+         * @brief Hundredths as `zigzag << 1` when they give back exactly `value`, otherwise
+         * the marker 1 followed by the 8 bytes of the double.
+         */
+        inline void putFixed(std::string& out, double value) {
+            if (std::abs(value) < 1e12 && !(value == 0.0 && std::signbit(value))) {
+                std::int64_t hundredths = std::llround(value * 100.0);
+                if (static_cast<double>(hundredths) / 100.0 == value) {
+                    putVarint(out, zigzag(hundredths) << 1);
+                    return;
+                }
+            }
+            out.push_back(1);
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        /**
+         * @brief Bounds-checked reader of one column of a decoded block.
+         */
+        class ColumnReader {
+        public:
+            ColumnReader() = default;
+            ColumnReader(const char* p, const char* end) : p(p), end(end) {}
+
+            bool varint(std::uint64_t& value) {
+                value = 0;
+                for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+                    unsigned char byte = static_cast<unsigned char>(*p++);
+                    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool fixed(double& value) {
+                std::uint64_t code;
+                if (!varint(code)) {
+                    return false;
+                }
+                if ((code & 1) == 0) {
+                    value = static_cast<double>(unzigzag(code >> 1)) / 100.0;
+                    return true;
+                }
+                if (code != 1 || static_cast<std::size_t>(end - p) < sizeof(value)) {
+                    return false;
+                }
+                std::memcpy(&value, p, sizeof(value));
+                p += sizeof(value);
+                return true;
+            }
+
+            bool bytes(std::size_t size, std::string_view& text) {
+                if (static_cast<std::size_t>(end - p) < size) {
+                    return false;
+                }
+                text = std::string_view(p, size);
+                p += size;
+                return true;
+            }
+
+            /**
+             * @brief Reads a table index and maps it to the ID interned for it.
+             */
+            bool id(const std::vector<StringId>& table, StringId& value) {
+                std::uint64_t index;
+                if (!varint(index) || index >= table.size()) {
+                    return false;
+                }
+                value = table[static_cast<std::size_t>(index)];
+                return true;
+            }
+
+        private:
+            const char* p = nullptr;
+            const char* end = nullptr;
+        };
+
+        inline std::uint32_t load32(const char* p) {
+            std::uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        inline void putLzLength(std::string& out, std::size_t length) {
+            while (length >= 255) {
+                out.push_back(static_cast<char>(255));
+                length -= 255;
+            }
+            out.push_back(static_cast<char>(length));
+        }
+
+        /**
+         * @brief Appends `input` compressed to `out`.
+         *
+         * Each sequence is a token (literal count in the high nibble, match length - 4 in the
+         * low one; 15 means more length bytes follow), the literals, a 2-byte offset back into
+         * the output and the extra match length. The last sequence has literals only.
+         */
+        inline void lzCompress(std::string_view input, std::string& out) {
+            constexpr unsigned hashBits = 14;
+            std::vector<std::uint32_t> table(std::size_t(1) << hashBits, 0);   // position + 1, 0 for none
+            const char* base = input.data();
+            const std::size_t size = input.size();
+            std::size_t anchor = 0;
+            std::size_t i = 0;
+            // The last bytes are always literals, so the 4-byte loads below stay in the input
+            const std::size_t limit = size > 12 ? size - 12 : 0;
+            while (i < limit) {
+                std::uint32_t sequence = load32(base + i);
+                std::uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+                std::size_t candidate = table[hash];
+                table[hash] = static_cast<std::uint32_t>(i + 1);
+                if (candidate == 0 || i - (candidate - 1) > 0xFFFF || load32(base + candidate - 1) != sequence) {
+                    // Step faster through data that does not compress
+                    i += 1 + ((i - anchor) >> 6);
+                    continue;
+                }
+                const std::size_t match = candidate - 1;
+                std::size_t length = 4;
+                while (i + length < size && base[match + length] == base[i + length]) {
+                    ++length;
+                }
+                const std::size_t literals = i - anchor;
+                const std::size_t extra = length - 4;
+                out.push_back(static_cast<char>((std::min<std::size_t>(literals, 15) << 4) | std::min<std::size_t>(extra, 15)));
+                if (literals >= 15) {
+                    putLzLength(out, literals - 15);
+                }
+                out.append(base + anchor, literals);
+                const std::size_t offset = i - match;
+                out.push_back(static_cast<char>(offset & 0xFF));
+                out.push_back(static_cast<char>(offset >> 8));
+                if (extra >= 15) {
+                    putLzLength(out, extra - 15);
+                }
+                i += length;
+                anchor = i;
+            }
+            const std::size_t literals = size - anchor;
+            out.push_back(static_cast<char>(std::min<std::size_t>(literals, 15) << 4));
+            if (literals >= 15) {
+                putLzLength(out, literals - 15);
+            }
+            out.append(base + anchor, literals);
+        }
+
+        /**
+         * @brief Decompresses `input` into exactly `outSize` bytes at `out`. Returns false for
+         * damaged input; nothing is ever read or written out of bounds.
+         */
+        inline bool lzDecompress(std::string_view input, char* out, std::size_t outSize) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(input.data());
+            const unsigned char* end = p + input.size();
+            std::size_t o = 0;
+            auto readLength = [&](std::size_t& length) {
+                unsigned char byte;
+                do {
+                    if (p == end) {
+                        return false;
+                    }
+                    byte = *p++;
+                    length += byte;
+                } while (byte == 255);
+                return true;
+            };
+            for (;;) {
+                if (p == end) {
+                    return false;
+                }
+                const unsigned token = *p++;
+                std::size_t literals = token >> 4;
+                if (literals == 15 && !readLength(literals)) {
+                    return false;
+                }
+                if (literals > static_cast<std::size_t>(end - p) || literals > outSize - o) {
+                    return false;
+                }
+                std::memcpy(out + o, p, literals);
+                p += literals;
+                o += literals;
+                if (p == end) {
+                    return o == outSize;
+                }
+                if (end - p < 2) {
+                    return false;
+                }
+                const std::size_t offset = static_cast<std::size_t>(p[0]) | (static_cast<std::size_t>(p[1]) << 8);
+                p += 2;
+                std::size_t length = token & 15;
+                if (length == 15 && !readLength(length)) {
+                    return false;
+                }
+                length += 4;
+                if (offset == 0 || offset > o || length > outSize - o) {
+                    return false;
+                }
+                const char* from = out + o - offset;
+                if (offset >= length) {
+                    std::memcpy(out + o, from, length);
+                } else {
+                    // The match overlaps the bytes it produces (a repeated pattern)
+                    for (std::size_t k = 0; k < length; ++k) {
+                        out[o + k] = from[k];
+                    }
+                }
+                o += length;
+            }
+        }
+
+        /**
+         * @brief Collects the strings a file refers to and numbers them in order of first use.
+         */
+        class TableBuilder {
+        public:
+            std::uint64_t index(std::size_t table, StringId id) {
+                std::vector<std::uint32_t>& indexes = fileIndexes[table];
+                if (id >= indexes.size()) {
+                    indexes.resize(std::max<std::size_t>(id + 1, tableDictionary(table).size()), notAssigned);
+                }
+                if (indexes[id] == notAssigned) {
+                    indexes[id] = static_cast<std::uint32_t>(used[table].size());
+                    used[table].push_back(id);
+                }
+                return indexes[id];
+            }
+
+            void writeTo(std::string& out) const {
+                for (std::size_t table = 0; table < tableCount; ++table) {
+                    putVarint(out, used[table].size());
+                    for (StringId id : used[table]) {
+                        const std::string& text = tableDictionary(table).lookup(id);
+                        putVarint(out, text.size());
+                        out.append(text);
+                    }
+                }
+            }
+
+        private:
+            static constexpr std::uint32_t notAssigned = 0xFFFFFFFFu;
+            std::vector<std::uint32_t> fileIndexes[tableCount];
+            std::vector<StringId> used[tableCount];
+        };
+
+        /**
+         * @brief Builds the columns of one block; `C` is the number of columns of the kind.
+         */
+        template <std::size_t C>
+        struct BlockColumns {
+            std::string columns[C];
+            std::int64_t previousYear = 0;
+
+            void clear() {
+                for (std::string& column : columns) {
+                    column.clear();
+                }
+                previousYear = 0;
+            }
+
+            void text(std::size_t lengths, std::string_view value) {
+                putVarint(columns[lengths], value.size());
+                columns[lengths + 1].append(value);
+            }
+
+            /**
+             * @brief The raw block: the column sizes, then the columns.
+             */
+            void join(std::string& raw) const {
+                raw.clear();
+                for (const std::string& column : columns) {
+                    std::uint32_t size = static_cast<std::uint32_t>(column.size());
+                    raw.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                }
+                for (const std::string& column : columns) {
+                    raw.append(column);
+                }
+            }
+        };
+
+        // Columns: title lengths, title bytes, durations, genres, artists
+        inline void encodeRecord(const Song& song, BlockColumns<5>& block, TableBuilder& tables) {
+            block.text(0, song.getTitle());
+            putFixed(block.columns[2], song.getDuration());
+            putVarint(block.columns[3], tables.index(GenreTable, song.getGenreId()));
+            putVarint(block.columns[4], tables.index(ArtistTable, song.getArtistId()));
+        }
+
+        // Columns: names, countries, genres
+        inline void encodeRecord(const Artist& artist, BlockColumns<3>& block, TableBuilder& tables) {
+            putVarint(block.columns[0], tables.index(ArtistTable, artist.getNameId()));
+            putVarint(block.columns[1], tables.index(CountryTable, artist.getCountryId()));
+            putVarint(block.columns[2], tables.index(GenreTable, artist.getGenreId()));
+        }
+
+        // Columns: name lengths, name bytes, artists, years, ratings, genres
+        inline void encodeRecord(const Album& album, BlockColumns<6>& block, TableBuilder& tables) {
+            block.text(0, album.getName());
+            putVarint(block.columns[2], tables.index(ArtistTable, album.getArtistId()));
+            putVarint(block.columns[3], zigzag(album.getYear() - block.previousYear));
+            block.previousYear = album.getYear();
+            putFixed(block.columns[4], album.getRating());
+            putVarint(block.columns[5], tables.index(GenreTable, album.getGenreId()));
+        }
+
+        /**
+         * @brief Reads the next row of a block and calls `visit` with its fields, in the order
+         * the record constructors take them.
+         */
+        template <typename Visit>
+        bool decodeRow(ColumnReader (&c)[5], const std::vector<StringId> (&tables)[tableCount],
+                       std::int64_t&, Visit& visit) {
+            std::uint64_t length;
+            std::string_view title;
+            double duration;
+            StringId genre, artist;
+            if (!c[0].varint(length) || !c[1].bytes(static_cast<std::size_t>(length), title) || !c[2].fixed(duration) ||
+                !c[3].id(tables[GenreTable], genre) || !c[4].id(tables[ArtistTable], artist)) {
+                return false;
+            }
+            visit(title, duration, genre, artist);
+            return true;
+        }
+
+        template <typename Visit>
+        bool decodeRow(ColumnReader (&c)[3], const std::vector<StringId> (&tables)[tableCount],
+                       std::int64_t&, Visit& visit) {
+            StringId name, country, genre;
+            if (!c[0].id(tables[ArtistTable], name) || !c[1].id(tables[CountryTable], country) ||
+                !c[2].id(tables[GenreTable], genre)) {
+                return false;
+            }
+            visit(name, country, genre);
+            return true;
+        }
+
+        template <typename Visit>
+        bool decodeRow(ColumnReader (&c)[6], const std::vector<StringId> (&tables)[tableCount],
+                       std::int64_t& previousYear, Visit& visit) {
+            std::uint64_t length, yearDelta;
+            std::string_view name;
+            double rating;
+            StringId artist, genre;
+            if (!c[0].varint(length) || !c[1].bytes(static_cast<std::size_t>(length), name) ||
+                !c[2].id(tables[ArtistTable], artist) || !c[3].varint(yearDelta) || !c[4].fixed(rating) ||
+                !c[5].id(tables[GenreTable], genre)) {
+                return false;
+            }
+            previousYear += unzigzag(yearDelta);
+            visit(name, artist, static_cast<int>(previousYear), rating, genre);
+            return true;
+        }
+
+        template <typename T> struct CompressedTraits;
+        template <> struct CompressedTraits<Song> {
+            static constexpr CompressedKind kind = CompressedKind::Songs;
+            static constexpr std::size_t columns = 5;
+        };
+        template <> struct CompressedTraits<Artist> {
+            static constexpr CompressedKind kind = CompressedKind::Artists;
+            static constexpr std::size_t columns = 3;
+        };
+        template <> struct CompressedTraits<Album> {
+            static constexpr CompressedKind kind = CompressedKind::Albums;
+            static constexpr std::size_t columns = 6;
+        };
+
+        /**
+         * @brief Writes `records` in the compressed form. Returns the file size, or 0 on failure.
+         */
+        template <typename T>
+        std::uint64_t writeCompressed(const std::vector<T>& records, const std::string& filename) {
+            constexpr std::size_t C = CompressedTraits<T>::columns;
+            std::ofstream file(filename, std::ios::binary);
+            if (!file.is_open()) {
+                std::cerr << "Error - cannot open the file!" << std::endl;
+                return 0;
+            }
+            CompressedHeader header{};
+            std::memcpy(header.magic, compressedMagic, sizeof(header.magic));
+            header.version = compressedVersion;
+            header.byteOrder = compressedByteOrder;
+            header.kind = static_cast<std::uint32_t>(CompressedTraits<T>::kind);
+            header.rows = records.size();
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            TableBuilder tables;
+            BlockColumns<C> block;
+            std::vector<CompressedBlockEntry> directory;
+            std::uint64_t offset = sizeof(header);
+            std::string raw, packed;
+            for (std::size_t start = 0; start < records.size(); start += compressedBlockRows) {
+                const std::size_t end = std::min(records.size(), start + compressedBlockRows);
+                for (std::size_t i = start; i < end; ++i) {
+                    encodeRecord(records[i], block, tables);
+                }
+                block.join(raw);
+                block.clear();
+                packed.clear();
+                lzCompress(raw, packed);
+                const std::string& stored = packed.size() < raw.size() ? packed : raw;
+                directory.push_back({offset, static_cast<std::uint32_t>(stored.size()), static_cast<std::uint32_t>(raw.size()),
+                                     static_cast<std::uint32_t>(end - start), checksum(stored.data(), stored.size())});
+                file.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+                offset += stored.size();
+            }
+            std::string tableBytes;
+            tables.writeTo(tableBytes);
+            file.write(tableBytes.data(), static_cast<std::streamsize>(tableBytes.size()));
+            header.blockCount = static_cast<std::uint32_t>(directory.size());
+            header.tablesOffset = offset;
+            header.directoryOffset = offset + tableBytes.size();
+            file.write(reinterpret_cast<const char*>(directory.data()),
+                       static_cast<std::streamsize>(directory.size() * sizeof(CompressedBlockEntry)));
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.close();
+            if (file.fail()) {
+                return 0;
+            }
+            return header.directoryOffset + directory.size() * sizeof(CompressedBlockEntry);
+        }
+    }
+
+    /**
+     * @brief A validated view of a compressed file held in memory (usually mapped).
+     *
+     * Opening checks the header and the directory and interns the string tables into the
+     * process dictionaries; blocks are only checked when they are decoded.
+     */
+    class CompressedFile {
+    public:
+        bool open(std::string_view data, std::string& error) {
+            detail::CompressedHeader header;
+            if (data.size() < sizeof(header) || !isCompressedData(data)) {
+                error = "not a compressed database file";
+                return false;
+            }
+            std::memcpy(&header, data.data(), sizeof(header));
+            if (header.byteOrder != compressedByteOrder) {
+                error = "written on a machine with a different byte order";
+                return false;
+            }
+            if (header.version != compressedVersion) {
+                error = "unsupported compressed format version " + std::to_string(header.version);
+                return false;
+            }
+            if (header.kind < 1 || header.kind > 3 || header.directoryOffset > data.size() ||
+                header.tablesOffset < sizeof(header) || header.tablesOffset > header.directoryOffset ||
+                header.blockCount != (data.size() - header.directoryOffset) / sizeof(detail::CompressedBlockEntry) ||
+                (data.size() - header.directoryOffset) % sizeof(detail::CompressedBlockEntry) != 0) {
+                error = "damaged or truncated compressed file";
+                return false;
+            }
+            fileKind = static_cast<CompressedKind>(header.kind);
+            rows = header.rows;
+            file = data;
+
+            const std::uint64_t tablesBytes = header.directoryOffset - header.tablesOffset;
+            detail::ColumnReader reader(data.data() + header.tablesOffset, data.data() + header.directoryOffset);
+            for (std::size_t table = 0; table < detail::tableCount; ++table) {
+                std::uint64_t count;
+                if (!reader.varint(count) || count > tablesBytes) {
+                    error = "damaged string table";
+                    return false;
+                }
+                StringDictionary& dictionary = detail::tableDictionary(table);
+                tables[table].clear();
+                tables[table].reserve(static_cast<std::size_t>(count));
+                for (std::uint64_t i = 0; i < count; ++i) {
+                    std::uint64_t length;
+                    std::string_view text;
+                    if (!reader.varint(length) || !reader.bytes(static_cast<std::size_t>(length), text)) {
+                        error = "damaged string table";
+                        return false;
+                    }
+                    tables[table].push_back(dictionary.intern(text));
+                }
+            }
+
+            directory.resize(header.blockCount);
+            std::uint64_t counted = 0;
+            for (std::size_t i = 0; i < directory.size(); ++i) {
+                detail::CompressedBlockEntry& entry = directory[i];
+                std::memcpy(&entry, data.data() + header.directoryOffset + i * sizeof(entry), sizeof(entry));
+                if (entry.offset > header.tablesOffset || entry.packedSize > header.tablesOffset - entry.offset ||
+                    entry.rawSize > detail::maxBlockBytes || entry.packedSize > entry.rawSize) {
+                    error = "damaged block directory";
+                    return false;
+                }
+                counted += entry.rows;
+            }
+            if (counted != rows) {
+                error = "damaged block directory";
+                return false;
+            }
+            return true;
+        }
+
+        CompressedKind kind() const { return fileKind; }
+        std::uint64_t rowCount() const { return rows; }
+        std::size_t blockCount() const { return directory.size(); }
+        std::size_t blockRows(std::size_t block) const { return directory[block].rows; }
+
+        /**
+         * @brief Checks block `block` and decompresses it if needed; `raw` then views either
+         * the file or `buffer`. Returns false for a damaged block. Safe to call from several
+         * threads at once.
+         */
+        bool unpackBlock(std::size_t block, std::string& buffer, std::string_view& raw) const {
+            const detail::CompressedBlockEntry& entry = directory[block];
+            std::string_view stored = file.substr(static_cast<std::size_t>(entry.offset), entry.packedSize);
+            if (detail::checksum(stored.data(), stored.size()) != entry.checksum) {
+                return false;
+            }
+            if (entry.packedSize == entry.rawSize) {
+                raw = stored;
+                return true;
+            }
+            buffer.resize(entry.rawSize);
+            if (!detail::lzDecompress(stored, buffer.data(), buffer.size())) {
+                return false;
+            }
+            raw = buffer;
+            return true;
+        }
+
+        /**
+         * @brief Calls `visit` with the fields of each row of an unpacked block of `T` records
+         * (see `detail::decodeRow`). Returns false if the columns do not hold the block's rows;
+         * the rows before the damage have been visited by then.
+         */
+        template <typename T, typename Visit>
+        bool visitRows(std::size_t block, std::string_view raw, Visit visit) const {
+            constexpr std::size_t C = detail::CompressedTraits<T>::columns;
+            if (raw.size() < C * sizeof(std::uint32_t)) {
+                return false;
+            }
+            detail::ColumnReader columns[C];
+            std::size_t at = C * sizeof(std::uint32_t);
+            for (std::size_t c = 0; c < C; ++c) {
+                std::uint32_t size;
+                std::memcpy(&size, raw.data() + c * sizeof(size), sizeof(size));
+                if (size > raw.size() - at) {
+                    return false;
+                }
+                columns[c] = detail::ColumnReader(raw.data() + at, raw.data() + at + size);
+                at += size;
+            }
+            std::int64_t previousYear = 0;
+            for (std::uint32_t row = 0; row < directory[block].rows; ++row) {
+                if (!detail::decodeRow(columns, tables, previousYear, visit)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        std::string_view file;
+        CompressedKind fileKind = CompressedKind::Songs;
+        std::uint64_t rows = 0;
+        std::vector<StringId> tables[detail::tableCount];
+        std::vector<detail::CompressedBlockEntry> directory;
+    };
+
+    namespace detail {
+        /**
+         * @brief Opens the compressed file in `data` for `T` records; a file that cannot be
+         * used is reported as an error on line 0.
+         */
+        template <typename T>
+        bool openCompressed(std::string_view data, CompressedFile& file, LoadReport& report) {
+            std::string error;
+            if (!file.open(data, error)) {
+                report.errors.push_back({0, error});
+                return false;
+            }
+            if (file.kind() != CompressedTraits<T>::kind) {
+                report.errors.push_back({0, "compressed file holds another collection"});
+                return false;
+            }
+            return true;
+        }
+
+        inline void reportBlock(const CompressedFile& file, std::size_t block, bool decoded, LoadReport& report) {
+            if (!decoded) {
+                report.errors.push_back({report.lines + 1, "damaged compressed block of " +
+                                         std::to_string(file.blockRows(block)) + " rows"});
+            }
+            report.lines += file.blockRows(block);
+        }
+    }
+
+    /**
+     * @brief Appends the records of the compressed file in `data` to `out`, decoding the
+     * blocks on `pool`. `report.lines` counts rows; a damaged block is skipped and reported
+     * at its first row.
+     */
+    template <typename T>
+    LoadReport readCompressed(std::string_view data, std::vector<T>& out, ThreadPool& pool) {
+        LoadReport report;
+        CompressedFile file;
+        if (!detail::openCompressed<T>(data, file, report)) {
+            return report;
+        }
+        auto decode = [&file](std::size_t block, std::vector<T>& part) {
+            std::string buffer;
+            std::string_view raw;
+            part.reserve(file.blockRows(block));
+            bool decoded = file.unpackBlock(block, buffer, raw) &&
+                file.template visitRows<T>(block, raw, [&part](auto... fields) { part.emplace_back(fields...); });
+            if (!decoded) {
+                part.clear();
+            }
+            return decoded;
+        };
+        const std::size_t blocks = file.blockCount();
+        std::vector<std::vector<T>> parts(blocks);
+        std::vector<char> decoded(blocks, 0);
+        if (pool.size() <= 1 || blocks <= 1) {
+            for (std::size_t i = 0; i < blocks; ++i) {
+                decoded[i] = decode(i, parts[i]);
+            }
+        } else {
+            std::vector<std::future<bool>> pending;
+            pending.reserve(blocks);
+            for (std::size_t i = 0; i < blocks; ++i) {
+                pending.push_back(pool.submit([&decode, &parts, i] { return decode(i, parts[i]); }));
+            }
+            // The tasks write into `parts`, so every one must be finished before anything can throw
+            for (auto& future : pending) {
+                future.wait();
+            }
+            for (std::size_t i = 0; i < blocks; ++i) {
+                decoded[i] = pending[i].get();
+            }
+        }
+        out.reserve(out.size() + static_cast<std::size_t>(file.rowCount()));
+        for (std::size_t i = 0; i < blocks; ++i) {
+            detail::reportBlock(file, i, decoded[i], report);
+            report.loaded += parts[i].size();
+            std::move(parts[i].begin(), parts[i].end(), std::back_inserter(out));
+            std::vector<T>().swap(parts[i]);
+        }
+        return report;
+    }
+
+    /**
+     * @brief Calls `visit` with the fields of every row of the compressed file in `data`, in
+     * file order (see `detail::decodeRow` for the fields of each kind). The blocks are
+     * decompressed a few at a time on `pool`, so memory use does not grow with the file.
+     * `report.loaded` counts the rows visited.
+     */
+    template <typename T, typename Visit>
+    LoadReport visitCompressed(std::string_view data, ThreadPool& pool, Visit visit) {
+        LoadReport report;
+        CompressedFile file;
+        if (!detail::openCompressed<T>(data, file, report)) {
+            return report;
+        }
+        const std::size_t window = std::max<std::size_t>(pool.size(), 1) * 2;
+        std::vector<std::string> buffers(window);
+        std::vector<std::string_view> raws(window);
+        std::vector<char> unpacked(window);
+        for (std::size_t first = 0; first < file.blockCount(); first += window) {
+            const std::size_t count = std::min(window, file.blockCount() - first);
+            if (pool.size() <= 1 || count <= 1) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    unpacked[i] = file.unpackBlock(first + i, buffers[i], raws[i]);
+                }
+            } else {
+                std::vector<std::future<bool>> pending;
+                for (std::size_t i = 0; i < count; ++i) {
+                    pending.push_back(pool.submit([&, i] { return file.unpackBlock(first + i, buffers[i], raws[i]); }));
+                }
+                for (auto& future : pending) {
+                    future.wait();
+                }
+                for (std::size_t i = 0; i < count; ++i) {
+                    unpacked[i] = pending[i].get();
+                }
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                std::size_t rows = 0;
+                bool decoded = unpacked[i] && file.template visitRows<T>(first + i, raws[i], [&](auto... fields) {
+                    ++rows;
+                    visit(fields...);
+                });
+                detail::reportBlock(file, first + i, decoded, report);
+                report.loaded += rows;
+            }
+        }
+        return report;
+    }
+}
+
+#endif
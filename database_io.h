@@ -0,0 +1,191 @@
+/**
+ * @file database_io.h
+ * @brief Reading and writing the three database files, as `;`-delimited text or in the
+ * compressed form of `compressed_format.h`.
+ * Shared by the program and the benchmark so both exercise the same code.
+ */
+#ifndef DATABASE_IO_H
+#define DATABASE_IO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "compressed_format.h"
+#include "mapped_file.h"
+#include "metrics.h"
+#include "loader.h"
+#include "record_schema.h"
+#include "thread_pool.h"
+
+namespace rc {
+    enum class StorageFormat {
+        Text,
+        Compressed
+    };
+
+/**
+ * @brief The form `filename` is stored in; text for a file that is missing or empty.
+ */
+    inline StorageFormat fileStorageFormat(const std::string& filename) {
+        char magic[sizeof(compressedMagic)] = {};
+        std::ifstream file(filename, std::ios::binary);
+        file.read(magic, sizeof(magic));
+        return isCompressedData(std::string_view(magic, static_cast<std::size_t>(file.gcount())))
+            ? StorageFormat::Compressed : StorageFormat::Text;
+    }
+
+    namespace detail {
+        /**
+         * @brief Writes `record` as one `;`-delimited line, its fields in schema order.
+         */
+        template <typename T>
+        void writeTextLine(std::ostream& out, const T& record) {
+            const char* separator = "";
+            forEachValue<T>(record, [&](const auto& field, const auto& value) {
+                out << separator;
+                separator = ";";
+                if constexpr (kindOf<decltype(field)> == FieldKind::Name) {
+                    out << field.dictionary().lookup(value);
+                } else {
+                    out << value;
+                }
+            });
+            out << '\n';
+        }
+
+        template <typename T>
+        bool saveRecords(const std::vector<T>& records, const std::string& filename, StorageFormat format, Metric metric) {
+            ScopedTimer timer(metric);
+            if (format == StorageFormat::Compressed) {
+                std::uint64_t written = writeCompressed(records, filename);
+                timer.rows(records.size(), written != 0 ? records.size() : 0);
+                timer.bytesWritten(written);
+                return written != 0;
+            }
+            std::ofstream file(filename);
+            if (file.is_open()) {
+                for (const auto& record : records) {
+                    writeTextLine(file, record);
+                }
+                timer.rows(records.size(), records.size());
+                timer.bytesWritten(static_cast<std::uint64_t>(std::max<std::streamoff>(file.tellp(), 0)));
+                file.close();
+                return !file.fail();
+            } else {
+                std::cerr << "Error - cannot open the file!" << std::endl;
+                return false;
+            }
+        }
+    }
+
+/**
+ * @brief Saves a collection of objects to a file.
+ * 
+ * This function saves the details of objects (such as songs, artists, or albums)
+ * to a specified file. It iterates over the collection 
+ * of objects and writes each object's properties to the file, as text lines
+ * or, with `StorageFormat::Compressed`, in compressed blocks.
+ * Returns false if the file could not be opened or written.
+ * 
+ * Supported object types (fields in the order of `record_schema.h`):
+ * - Songs: title, duration, genre, artist
+ * - Artists: name, country, genre
+ * - Albums: name, artist, year, rating, genre
+ * 
+ */
+    inline bool saveSongsToFile(const std::vector<Song>& songs, const std::string& filename,
+                              StorageFormat format = StorageFormat::Text) {
+        return detail::saveRecords(songs, filename, format, Metric::SaveSongs);
+    }
+    inline bool saveArtistsToFile(const std::vector<Artist>& artists, const std::string& filename,
+                              StorageFormat format = StorageFormat::Text) {
+        return detail::saveRecords(artists, filename, format, Metric::SaveArtists);
+    }
+    inline bool saveAlbumsToFile(const std::vector<Album>& albums, const std::string& filename,
+                              StorageFormat format = StorageFormat::Text) {
+        return detail::saveRecords(albums, filename, format, Metric::SaveAlbums);
+    }
+
+
+
+/**
+ * @brief Loads a collection of objects from a file.
+ * 
+ * This function memory-maps the file and parses it in place (see `loader.h`),
+ * appending the objects (such as songs, artists, or albums) to the vector. 
+ * Large files are split at line boundaries and the chunks are parsed on `pool`;
+ * compressed files are recognized by their header and their blocks decoded on `pool`.
+ * Lines that cannot be parsed are skipped and kept in the returned `FileLoad`;
+ * `reportFileLoad` prints them on `std::cerr` together with their line number,
+ * so one bad line does not stop the load. The three files can therefore be
+ * loaded on separate threads and reported afterwards in a fixed order.
+ * 
+ * Supported object types:
+ * - Songs: title, duration, genre, artist
+ * - Artists: name, country, genre
+ * - Albums: name, artist, year, rating, genre
+ * 
+ */
+    inline void reportLoadErrors(const LoadReport& report, const std::string& filename) {
+        for (const auto& error : report.errors) {
+            if (error.line == 0) {
+                // The whole file could not be used (see `readCompressed`)
+                std::cerr << "Warning - " << filename << ": " << error.message << std::endl;
+                continue;
+            }
+            std::cerr << "Warning - " << filename << ":" << error.line
+                      << ": " << error.message << ", line skipped" << std::endl;
+        }
+    }
+
+    struct FileLoad {
+        bool opened = false;
+        LoadReport report;
+    };
+
+    inline void reportFileLoad(const FileLoad& load, const std::string& filename) {
+        if (load.opened) {
+            reportLoadErrors(load.report, filename);
+        } else {
+            std::cerr << "Error - cannot open the file!" << std::endl;
+        }
+    }
+
+    namespace detail {
+        template <typename T>
+        FileLoad loadRecords(std::vector<T>& records, const std::string& filename, ThreadPool& pool, Metric metric) {
+            ScopedTimer timer(metric);
+            FileLoad load;
+            MappedFile file(filename);
+            if (file.isOpen()) {
+                load.opened = true;
+                load.report = isCompressedData(file.view()) ? readCompressed(file.view(), records, pool)
+                                                              : parseRecords(file.view(), records, pool);
+                timer.bytesRead(file.size());
+                timer.rows(load.report.lines, load.report.loaded);
+            }
+            return load;
+        }
+    }
+
+    inline FileLoad loadSongsFromFile(std::vector<Song>& songs, const std::string& filename, ThreadPool& pool) {
+        return detail::loadRecords(songs, filename, pool, Metric::LoadSongs);
+    }
+
+    inline FileLoad loadArtistsFromFile(std::vector<Artist>& artists, const std::string& filename, ThreadPool& pool) {
+        return detail::loadRecords(artists, filename, pool, Metric::LoadArtists);
+    }
+
+    inline FileLoad loadAlbumsFromFile(std::vector<Album>& albums, const std::string& filename, ThreadPool& pool) {
+        return detail::loadRecords(albums, filename, pool, Metric::LoadAlbums);
+    }
+}
+
+#endif
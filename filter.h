@@ -0,0 +1,300 @@
+/**
+ * @file filter.h
+ * @brief Predicate filters over songs, albums and artists, e.g. `rating > 4.0 and year >= 2015`.
+ * A filter is a conjunction of conditions, each comparing one record field with a constant.
+ */
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <cctype>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "song.h"
+#include "album.h"
+#include "artist.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    enum class Compare { Less, LessEqual, Greater, GreaterEqual, Equal };
+
+    enum class SongField { Duration, Genre, Artist };
+    enum class AlbumField { Year, Rating, Genre, Artist };
+    enum class ArtistField { Name, Country, Genre };
+
+    /**
+     * @brief One `field op value` term. Text fields (genre, artist, country) only support `=`
+     * and are compared through their dictionary ID.
+     */
+    template <typename Field>
+    struct Condition {
+        Field field;
+        Compare op;
+        double number = 0.0;
+        StringId id = StringDictionary::notFound;
+    };
+
+    /**
+     * @brief How text values are resolved: `Lookup` finds them in the dictionaries (a name
+     * that was never loaded matches nothing); `Intern` adds them, for filters that run before
+     * or without loading the collections.
+     */
+    enum class FilterNames { Lookup, Intern };
+
+    using SongFilter = std::vector<Condition<SongField>>;
+    using AlbumFilter = std::vector<Condition<AlbumField>>;
+    using ArtistFilter = std::vector<Condition<ArtistField>>;
+
+    template <typename T>
+    bool compareValues(T value, Compare op, T bound) {
+        switch (op) {
+            case Compare::Less: return value < bound;
+            case Compare::LessEqual: return value <= bound;
+            case Compare::Greater: return value > bound;
+            case Compare::GreaterEqual: return value >= bound;
+            case Compare::Equal: return value == bound;
+        }
+        return false;
+    }
+
+    inline bool matches(const Song& song, const SongFilter& filter) {
+        for (const auto& condition : filter) {
+            bool ok = false;
+            switch (condition.field) {
+                case SongField::Duration: ok = compareValues(song.getDuration(), condition.op, condition.number); break;
+                case SongField::Genre: ok = song.getGenreId() == condition.id; break;
+                case SongField::Artist: ok = song.getArtistId() == condition.id; break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool matches(const Album& album, const AlbumFilter& filter) {
+        for (const auto& condition : filter) {
+            bool ok = false;
+            switch (condition.field) {
+                case AlbumField::Year: ok = compareValues(static_cast<double>(album.getYear()), condition.op, condition.number); break;
+                case AlbumField::Rating: ok = compareValues(album.getRating(), condition.op, condition.number); break;
+                case AlbumField::Genre: ok = album.getGenreId() == condition.id; break;
+                case AlbumField::Artist: ok = album.getArtistId() == condition.id; break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool matches(const Artist& artist, const ArtistFilter& filter) {
+        for (const auto& condition : filter) {
+            bool ok = false;
+            switch (condition.field) {
+                case ArtistField::Name: ok = artist.getNameId() == condition.id; break;
+                case ArtistField::Country: ok = artist.getCountryId() == condition.id; break;
+                case ArtistField::Genre: ok = artist.getGenreId() == condition.id; break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    namespace detail {
+        class FilterLexer {
+        public:
+            explicit FilterLexer(std::string_view text) : text(text) {}
+
+            bool atEnd() {
+                skipSpaces();
+                return pos == text.size();
+            }
+
+            std::string word() {
+                skipSpaces();
+                std::size_t start = pos;
+                while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) {
+                    ++pos;
+                }
+                std::string result(text.substr(start, pos - start));
+                for (auto& c : result) {
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                }
+                return result;
+            }
+
+            bool op(Compare& result) {
+                skipSpaces();
+                auto next = [this](char c) { return pos < text.size() && text[pos] == c; };
+                if (next('<')) {
+                    ++pos;
+                    result = next('=') ? (++pos, Compare::LessEqual) : Compare::Less;
+                } else if (next('>')) {
+                    ++pos;
+                    result = next('=') ? (++pos, Compare::GreaterEqual) : Compare::Greater;
+                } else if (next('=')) {
+                    ++pos;
+                    if (next('=')) {
+                        ++pos;
+                    }
+                    result = Compare::Equal;
+                } else {
+                    return false;
+                }
+                return true;
+            }
+
+            /**
+             * @brief Reads a value: a double-quoted string, or everything up to the next ` and `.
+             */
+            bool value(std::string& result) {
+                skipSpaces();
+                if (pos < text.size() && text[pos] == '"') {
+                    std::size_t close = text.find('"', pos + 1);
+                    if (close == std::string_view::npos) {
+                        return false;
+                    }
+                    result = std::string(text.substr(pos + 1, close - pos - 1));
+                    pos = close + 1;
+                    return true;
+                }
+                std::size_t end = pos;
+                while (end < text.size() && !isAndAt(end)) {
+                    ++end;
+                }
+                std::string_view raw = text.substr(pos, end - pos);
+                while (!raw.empty() && std::isspace(static_cast<unsigned char>(raw.back()))) {
+                    raw.remove_suffix(1);
+                }
+                result = std::string(raw);
+                pos = end;
+                return !result.empty();
+            }
+
+        private:
+            bool isAndAt(std::size_t at) const {
+                if (text[at] != ' ' || at + 4 > text.size()) {
+                    return false;
+                }
+                for (std::size_t i = 0; i < 3; ++i) {
+                    if (std::tolower(static_cast<unsigned char>(text[at + 1 + i])) != "and"[i]) {
+                        return false;
+                    }
+                }
+                return at + 4 == text.size() || text[at + 4] == ' ';
+            }
+
+            void skipSpaces() {
+                while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+                    ++pos;
+                }
+            }
+
+            std::string_view text;
+            std::size_t pos = 0;
+        };
+
+        inline bool parseFilterNumber(const std::string& text, double& value) {
+            const char* first = text.data();
+            const char* last = first + text.size();
+            auto result = std::from_chars(first, last, value);
+            return result.ec == std::errc() && result.ptr == last;
+        }
+
+        /**
+         * @brief Shared parser; `resolve` maps a field name to its enum value and tells whether it is text.
+         */
+        template <typename Field, typename Resolve>
+        bool parseFilter(std::string_view text, std::vector<Condition<Field>>& filter, std::string& error, FilterNames names, Resolve resolve) {
+            FilterLexer lexer(text);
+            filter.clear();
+            do {
+                std::string name = lexer.word();
+                Field field;
+                bool isText = false;
+                if (!resolve(name, field, isText)) {
+                    error = name.empty() ? "expected a field name" : "unknown field '" + name + "'";
+                    return false;
+                }
+                Condition<Field> condition{field, Compare::Equal};
+                if (!lexer.op(condition.op)) {
+                    error = "expected one of < <= > >= = after '" + name + "'";
+                    return false;
+                }
+                std::string value;
+                if (!lexer.value(value)) {
+                    error = "expected a value after '" + name + "'";
+                    return false;
+                }
+                if (isText) {
+                    if (condition.op != Compare::Equal) {
+                        error = "'" + name + "' can only be compared with =";
+                        return false;
+                    }
+                    StringDictionary& dictionary = name == "genre" ? genreDictionary()
+                                                 : name == "country" ? countryDictionary() : artistDictionary();
+                    condition.id = names == FilterNames::Intern ? dictionary.intern(value) : dictionary.find(value);
+                } else if (!parseFilterNumber(value, condition.number)) {
+                    error = "'" + value + "' is not a number";
+                    return false;
+                }
+                filter.push_back(condition);
+                if (lexer.atEnd()) {
+                    return true;
+                }
+            } while (lexer.word() == "and");
+            error = "conditions must be joined with 'and'";
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses a song filter over `duration`, `genre` and `artist`,
+     * e.g. `duration < 3 and genre = Rap`.
+     */
+    inline bool parseSongFilter(std::string_view text, SongFilter& filter, std::string& error,
+                                FilterNames names = FilterNames::Lookup) {
+        return detail::parseFilter(text, filter, error, names, [](const std::string& name, SongField& field, bool& isText) {
+            if (name == "duration") { field = SongField::Duration; isText = false; return true; }
+            if (name == "genre") { field = SongField::Genre; isText = true; return true; }
+            if (name == "artist") { field = SongField::Artist; isText = true; return true; }
+            return false;
+        });
+    }
+
+    /**
+     * @brief Parses an album filter over `year`, `rating`, `genre` and `artist`,
+     * e.g. `rating > 4.0 and year >= 2015`.
+     */
+    inline bool parseAlbumFilter(std::string_view text, AlbumFilter& filter, std::string& error,
+                                 FilterNames names = FilterNames::Lookup) {
+        return detail::parseFilter(text, filter, error, names, [](const std::string& name, AlbumField& field, bool& isText) {
+            if (name == "year") { field = AlbumField::Year; isText = false; return true; }
+            if (name == "rating") { field = AlbumField::Rating; isText = false; return true; }
+            if (name == "genre") { field = AlbumField::Genre; isText = true; return true; }
+            if (name == "artist") { field = AlbumField::Artist; isText = true; return true; }
+            return false;
+        });
+    }
+
+    /**
+     * @brief Parses an artist filter over `name`, `country` and `genre`,
+     * e.g. `country = Canada and genre = Rap`.
+     */
+    inline bool parseArtistFilter(std::string_view text, ArtistFilter& filter, std::string& error,
+                                  FilterNames names = FilterNames::Lookup) {
+        return detail::parseFilter(text, filter, error, names, [](const std::string& name, ArtistField& field, bool& isText) {
+            if (name == "name") { field = ArtistField::Name; isText = true; return true; }
+            if (name == "country") { field = ArtistField::Country; isText = true; return true; }
+            if (name == "genre") { field = ArtistField::Genre; isText = true; return true; }
+            return false;
+        });
+    }
+}
+
+#endif
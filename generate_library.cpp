@@ -0,0 +1,265 @@
+/**
+ * @file generate_library.cpp
+ * @brief Writes synthetic `music_database.txt`, `album_database.txt` and `artist_database.txt`
+ * files for benchmarking.
+ *
+ * Popularity is skewed the way real libraries are: a few artists own most of the songs
+ * and albums and a few genres dominate (Zipf distributions). The output only depends
+ * on the sizes and the seed, so a benchmark run can be reproduced exactly.
+ *
+ * Usage: `generate_library [--songs N] [--albums N] [--artists N] [--seed S] [--out DIR]`
+ * (by default 10000 songs, a tenth as many albums and a fiftieth as many artists).
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const std::vector<std::string> genres = {
+        "Pop", "Rock", "Rap", "R&B", "Electronic", "Indie", "Country", "Jazz", "Metal", "Folk",
+        "Classical", "Soul", "Reggae", "Blues", "Punk", "Latin", "K-Pop", "Funk", "Ambient", "Gospel"
+    };
+
+    const std::vector<std::string> countries = {
+        "USA", "UK", "Canada", "Germany", "France", "Sweden", "Australia", "Japan", "South Korea", "Brazil",
+        "Poland", "Netherlands", "Norway", "Ireland", "Mexico", "Spain", "Italy", "Nigeria", "Jamaica", "Iceland",
+        "Finland", "Denmark", "New Zealand", "Argentina", "Belgium", "Austria", "Colombia", "India", "Chile", "Portugal"
+    };
+
+    const std::vector<std::string> firstWords = {
+        "Black", "Silver", "Golden", "Midnight", "Electric", "Velvet", "Crystal", "Neon", "Broken", "Wild",
+        "Silent", "Burning", "Frozen", "Hollow", "Lonely", "Crimson", "Blue", "Young", "Paper", "Iron",
+        "Little", "Sweet", "Dark", "Bright", "Lost", "Royal", "Cosmic", "Urban", "Savage", "Gentle"
+    };
+
+    const std::vector<std::string> secondWords = {
+        "Wolves", "Hearts", "Rivers", "Kings", "Ghosts", "Lights", "Roses", "Machines", "Tigers", "Dreams",
+        "Shadows", "Saints", "Echoes", "Horses", "Waves", "Stars", "Foxes", "Mountains", "Sparrows", "Queens",
+        "Children", "Strangers", "Lovers", "Giants", "Pilots", "Sisters", "Brothers", "Riders", "Poets", "Engines"
+    };
+
+    const std::vector<std::string> titleWords = {
+        "Love", "Night", "Summer", "Fire", "Rain", "Home", "Heart", "Dance", "Money", "Road",
+        "Dream", "Time", "Light", "Gold", "Ocean", "City", "Sky", "Tears", "Paradise", "Memory",
+        "Highway", "Angel", "Thunder", "Forever", "Sunset", "Shadow", "Kiss", "Storm", "Freedom", "Echo",
+        "Midnight", "Fever", "Diamond", "Winter", "Honey", "Mirror", "Garden", "Signal", "Island", "Ghost"
+    };
+
+    /**
+     * @brief Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent.
+     */
+    class ZipfSampler {
+    public:
+        ZipfSampler(std::size_t n, double exponent) : cumulative(n) {
+            double total = 0.0;
+            for (std::size_t rank = 0; rank < n; ++rank) {
+                total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+                cumulative[rank] = total;
+            }
+        }
+
+        template <typename Random>
+        std::size_t operator()(Random& random) {
+            std::uniform_real_distribution<double> uniform(0.0, cumulative.back());
+            auto it = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(random));
+            return std::min(static_cast<std::size_t>(it - cumulative.begin()), cumulative.size() - 1);
+        }
+
+    private:
+        std::vector<double> cumulative;
+    };
+
+    /**
+     * @brief Buffered line writer; the files can reach several hundred megabytes.
+     */
+    class Output {
+    public:
+        explicit Output(const std::filesystem::path& path) : file(std::fopen(path.string().c_str(), "wb")) {
+            buffer.reserve(bufferSize + 1024);
+        }
+
+        ~Output() { close(); }
+
+        bool isOpen() const { return file != nullptr; }
+
+        void line(const std::string& text) {
+            buffer += text;
+            buffer += '\n';
+            if (buffer.size() >= bufferSize) {
+                flush();
+            }
+        }
+
+        bool close() {
+            if (file == nullptr) {
+                return ok;
+            }
+            flush();
+            ok = std::fclose(file) == 0 && ok;
+            file = nullptr;
+            return ok;
+        }
+
+    private:
+        static constexpr std::size_t bufferSize = 1 << 20;
+
+        void flush() {
+            ok = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && ok;
+            buffer.clear();
+        }
+
+        std::FILE* file;
+        std::string buffer;
+        bool ok = true;
+    };
+
+    /**
+     * @brief Unique, readable artist name for index `i` ("Midnight Foxes", "Midnight Foxes 2", ...).
+     */
+    std::string artistName(std::size_t i) {
+        std::size_t combinations = firstWords.size() * secondWords.size();
+        std::size_t combo = i % combinations;
+        std::string name = firstWords[combo % firstWords.size()] + " " + secondWords[combo / firstWords.size()];
+        if (i >= combinations) {
+            name += " " + std::to_string(i / combinations + 1);
+        }
+        return name;
+    }
+
+    template <typename Random>
+    std::string title(Random& random, ZipfSampler& words) {
+        std::uniform_int_distribution<int> length(1, 3);
+        std::string text;
+        for (int i = length(random); i > 0; --i) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            text += titleWords[words(random)];
+        }
+        return text;
+    }
+
+    std::string fixed2(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f", value);
+        return text;
+    }
+
+    bool parseCount(const char* text, std::uint64_t& value) {
+        char* end = nullptr;
+        value = std::strtoull(text, &end, 10);
+        return end != text && *end == '\0';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::uint64_t songCount = 10000;
+    std::uint64_t albumCount = 0;
+    std::uint64_t artistCount = 0;
+    std::uint64_t seed = 42;
+    std::filesystem::path outDir = ".";
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error - missing value for " << option << std::endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (option == "--songs") {
+            ok = parseCount(value, songCount);
+        } else if (option == "--albums") {
+            ok = parseCount(value, albumCount);
+        } else if (option == "--artists") {
+            ok = parseCount(value, artistCount);
+        } else if (option == "--seed") {
+            ok = parseCount(value, seed);
+        } else if (option == "--out") {
+            outDir = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--songs N] [--albums N] [--artists N] [--seed S] [--out DIR]" << std::endl;
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Error - invalid value for " << option << ": " << value << std::endl;
+            return 1;
+        }
+    }
+    if (albumCount == 0) {
+        albumCount = std::max<std::uint64_t>(1, songCount / 10);
+    }
+    if (artistCount == 0) {
+        artistCount = std::max<std::uint64_t>(1, songCount / 50);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+
+    std::mt19937_64 random(seed);
+    ZipfSampler artistPopularity(artistCount, 1.07);
+    ZipfSampler genrePopularity(genres.size(), 1.2);
+    ZipfSampler countryPopularity(countries.size(), 1.3);
+    ZipfSampler wordPopularity(titleWords.size(), 0.9);
+
+    // Popularity rank -> artist, so the most popular artists are not simply the first ones in the file
+    std::vector<std::uint32_t> byRank(artistCount);
+    std::iota(byRank.begin(), byRank.end(), 0u);
+    std::shuffle(byRank.begin(), byRank.end(), random);
+
+    Output artistsFile(outDir / "artist_database.txt");
+    Output songsFile(outDir / "music_database.txt");
+    Output albumsFile(outDir / "album_database.txt");
+    if (!artistsFile.isOpen() || !songsFile.isOpen() || !albumsFile.isOpen()) {
+        std::cerr << "Error - cannot open the file!" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::uint8_t> artistGenre(artistCount);
+    for (std::uint64_t i = 0; i < artistCount; ++i) {
+        artistGenre[i] = static_cast<std::uint8_t>(genrePopularity(random));
+        artistsFile.line(artistName(i) + ";" + countries[countryPopularity(random)] + ";" + genres[artistGenre[i]]);
+    }
+
+    // Mostly the artist's own genre, sometimes a crossover
+    std::bernoulli_distribution crossover(0.2);
+    auto pickArtist = [&]() -> std::uint32_t { return byRank[artistPopularity(random)]; };
+    auto genreOf = [&](std::uint32_t artist) -> const std::string& {
+        return genres[crossover(random) ? genrePopularity(random) : artistGenre[artist]];
+    };
+
+    std::normal_distribution<double> duration(3.6, 1.1);
+    for (std::uint64_t i = 0; i < songCount; ++i) {
+        std::uint32_t artist = pickArtist();
+        double minutes = std::min(15.0, std::max(0.5, duration(random)));
+        songsFile.line(title(random, wordPopularity) + ";" + fixed2(minutes) + ";" + genreOf(artist) + ";" + artistName(artist));
+    }
+
+    std::exponential_distribution<double> age(1.0 / 14.0);
+    std::normal_distribution<double> rating(3.6, 0.6);
+    for (std::uint64_t i = 0; i < albumCount; ++i) {
+        std::uint32_t artist = pickArtist();
+        int year = 2024 - std::min(74, static_cast<int>(age(random)));
+        double stars = std::min(5.0, std::max(1.0, rating(random)));
+        albumsFile.line(title(random, wordPopularity) + ";" + artistName(artist) + ";" + std::to_string(year) + ";" + fixed2(stars) + ";" + genreOf(artist));
+    }
+
+    bool written = artistsFile.close();
+    written = songsFile.close() && written;
+    written = albumsFile.close() && written;
+    if (!written) {
+        std::cerr << "Error - cannot write the generated files!" << std::endl;
+        return 1;
+    }
+    std::cout << "Generated " << songCount << " songs, " << albumCount << " albums and "
+              << artistCount << " artists in " << outDir.string() << "." << std::endl;
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file join.h
+ * @brief Equi-joins between songs, albums and artists on the artist name, and the
+ * cross-collection reports built on them.
+ *
+ * Every join is a hash join: the filtered build side is put into a `JoinTable`, then the
+ * filtered probe side is streamed through it once, so a join costs O(build + probe + output)
+ * instead of a nested scan. Filters are applied to each side before the join.
+ */
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "filter.h"
+#include "library.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    /**
+     * @brief One result row of a join: a row of the left (probe) collection and a row of the
+     * right (build) collection with the same artist.
+     */
+    struct JoinedRows {
+        std::size_t left;
+        std::size_t right;
+    };
+
+    /**
+     * @brief Build side of a join on an interned key.
+     *
+     * Songs, albums and artists share one artist dictionary, so the dictionary ID is a
+     * perfect hash of the name: buckets are a dense array indexed by ID, and rows with the
+     * same key are chained through `next` in row order.
+     */
+    class JoinTable {
+    public:
+        static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+        /**
+         * @brief Indexes `rows` (ascending) by `keyOf(row)`; keys must be below `keyCount`.
+         */
+        template <typename KeyOf>
+        void build(const std::vector<std::size_t>& rows, std::size_t keyCount, KeyOf keyOf) {
+            head.assign(keyCount, none);
+            next.assign(rows.empty() ? 0 : rows.back() + 1, none);
+            for (auto it = rows.rbegin(); it != rows.rend(); ++it) {
+                StringId key = keyOf(*it);
+                next[*it] = head[key];
+                head[key] = *it;
+            }
+        }
+
+        std::size_t first(StringId key) const { return key < head.size() ? head[key] : none; }
+        std::size_t following(std::size_t row) const { return next[row]; }
+
+    private:
+        std::vector<std::size_t> head;
+        std::vector<std::size_t> next;
+    };
+
+    namespace detail {
+        template <typename KeyOf>
+        std::vector<JoinedRows> probe(const std::vector<std::size_t>& rows, KeyOf keyOf, const JoinTable& table) {
+            std::vector<JoinedRows> result;
+            result.reserve(rows.size());
+            for (std::size_t row : rows) {
+                for (std::size_t match = table.first(keyOf(row)); match != JoinTable::none; match = table.following(match)) {
+                    result.push_back({row, match});
+                }
+            }
+            return result;
+        }
+
+        inline JoinTable artistTable(const Library& library, const ArtistFilter& filter) {
+            const std::vector<Artist>& artists = library.getArtists();
+            JoinTable table;
+            table.build(library.filterArtists(filter), artistDictionary().size(),
+                        [&artists](std::size_t row) { return artists[row].getNameId(); });
+            return table;
+        }
+    }
+
+    /**
+     * @brief Songs matching `songFilter` paired with the artist records (matching `artistFilter`)
+     * of their artist. Songs whose artist has no matching record are left out.
+     */
+    inline std::vector<JoinedRows> joinSongsWithArtists(const Library& library, const SongFilter& songFilter, const ArtistFilter& artistFilter) {
+        const std::vector<Song>& songs = library.getSongs();
+        return detail::probe(library.filterSongs(songFilter), [&songs](std::size_t row) { return songs[row].getArtistId(); },
+                             detail::artistTable(library, artistFilter));
+    }
+
+    /**
+     * @brief Albums matching `albumFilter` paired with the artist records (matching `artistFilter`)
+     * of their artist.
+     */
+    inline std::vector<JoinedRows> joinAlbumsWithArtists(const Library& library, const AlbumFilter& albumFilter, const ArtistFilter& artistFilter) {
+        const std::vector<Album>& albums = library.getAlbums();
+        return detail::probe(library.filterAlbums(albumFilter), [&albums](std::size_t row) { return albums[row].getArtistId(); },
+                             detail::artistTable(library, artistFilter));
+    }
+
+    /**
+     * @brief Songs matching `songFilter` paired with every album matching `albumFilter` by the same artist.
+     */
+    inline std::vector<JoinedRows> joinSongsWithAlbums(const Library& library, const SongFilter& songFilter, const AlbumFilter& albumFilter) {
+        const std::vector<Song>& songs = library.getSongs();
+        const std::vector<Album>& albums = library.getAlbums();
+        JoinTable table;
+        table.build(library.filterAlbums(albumFilter), artistDictionary().size(),
+                    [&albums](std::size_t row) { return albums[row].getArtistId(); });
+        return detail::probe(library.filterSongs(songFilter), [&songs](std::size_t row) { return songs[row].getArtistId(); }, table);
+    }
+
+    /**
+     * @brief Album count and average rating for one artist country.
+     */
+    struct CountryRating {
+        StringId country;
+        std::size_t albums = 0;
+        double averageRating = 0.0;
+    };
+
+    /**
+     * @brief Average album rating per artist country, best first (ties by country name).
+     * Albums are matched to their artist record with `joinAlbumsWithArtists`.
+     */
+    inline std::vector<CountryRating> averageAlbumRatingByCountry(const Library& library, const AlbumFilter& albumFilter = {},
+                                                                  const ArtistFilter& artistFilter = {}) {
+        const std::vector<Album>& albums = library.getAlbums();
+        const std::vector<Artist>& artists = library.getArtists();
+        std::vector<std::size_t> counts(countryDictionary().size(), 0);
+        std::vector<double> sums(counts.size(), 0.0);
+        for (const JoinedRows& rows : joinAlbumsWithArtists(library, albumFilter, artistFilter)) {
+            StringId country = artists[rows.right].getCountryId();
+            ++counts[country];
+            sums[country] += albums[rows.left].getRating();
+        }
+        std::vector<CountryRating> result;
+        for (StringId country = 0; country < counts.size(); ++country) {
+            if (counts[country] != 0) {
+                result.push_back({country, counts[country], sums[country] / static_cast<double>(counts[country])});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const CountryRating& a, const CountryRating& b) {
+            if (a.averageRating != b.averageRating) {
+                return a.averageRating > b.averageRating;
+            }
+            return countryDictionary().lookup(a.country) < countryDictionary().lookup(b.country);
+        });
+        return result;
+    }
+}
+
+#endif
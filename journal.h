@@ -0,0 +1,571 @@
+/**
+ * @file journal.h
+ * @brief Append-only write-ahead log of the adds and removes made since the base files were written.
+ *
+ * Every change is appended as one small checksummed record and flushed, so committing an edit
+ * costs O(size of the edit) and a crash loses nothing that was already committed. On startup the
+ * records are replayed over the base files; compaction later folds them back into the base files.
+ *
+ * File layout: magic `RCJOURNL`, version, then one fingerprint (size and content hash) per base
+ * file (songs, artists, albums). Each record is `length, checksum, op, fields...`. A record is only
+ * replayed if the base file of its collection still has the fingerprint stored in the header, so
+ * entries that a compaction already folded into a base file are never applied twice.
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "mapped_file.h"
+#include "record_schema.h"
+#include "text_arena.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace rc {
+    enum class JournalOp : std::uint8_t {
+        AddSong = 1,
+        AddArtist = 2,
+        AddAlbum = 3,
+        RemoveSong = 4,
+        RemoveArtist = 5,
+        RemoveAlbum = 6,
+        UpsertSong = 7,
+        UpsertArtist = 8,
+        UpsertAlbum = 9,
+        RemoveSongByKey = 10,    // the song with a title by an artist, where `RemoveSong` takes every artist's
+        RemoveAlbumByKey = 11
+    };
+
+    /**
+     * @brief Index of the collection (and base file) a journal operation belongs to:
+     * 0 for songs, 1 for artists, 2 for albums.
+     */
+    inline int journalCollection(JournalOp op) {
+        switch (op) {
+            case JournalOp::AddSong:
+            case JournalOp::RemoveSong:
+            case JournalOp::RemoveSongByKey:
+            case JournalOp::UpsertSong: return 0;
+            case JournalOp::AddArtist:
+            case JournalOp::RemoveArtist:
+            case JournalOp::UpsertArtist: return 1;
+            default: return 2;
+        }
+    }
+
+    inline bool isRemoval(JournalOp op) {
+        return op == JournalOp::RemoveSong || op == JournalOp::RemoveArtist || op == JournalOp::RemoveAlbum ||
+               op == JournalOp::RemoveSongByKey || op == JournalOp::RemoveAlbumByKey;
+    }
+
+    /**
+     * @brief One logged change. Adds and upserts carry the full record, removes only the key:
+     * the title or name, and for the `*ByKey` removals the artist too.
+     */
+    struct JournalEntry {
+        JournalOp op = JournalOp::AddSong;
+        Song song;
+        Artist artist;
+        Album album;
+        std::string key;
+        std::string keyArtist;
+
+        // Copies the text of the record to `arena`, for an entry kept longer than the arena it was parsed into
+        void storeTextIn(TextArena& arena) {
+            song.storeTextIn(arena);
+            album.storeTextIn(arena);
+        }
+    };
+
+    /**
+     * @brief The journal operations on records of type `T`, and the member of `JournalEntry`
+     * holding such a record. An artist's key is its name, so both of its removals are one.
+     */
+    template <typename T>
+    struct JournalOpsOf;
+
+    template <>
+    struct JournalOpsOf<Song> {
+        static constexpr JournalOp add = JournalOp::AddSong;
+        static constexpr JournalOp upsert = JournalOp::UpsertSong;
+        static constexpr JournalOp remove = JournalOp::RemoveSong;
+        static constexpr JournalOp removeByKey = JournalOp::RemoveSongByKey;
+        static Song& record(JournalEntry& entry) { return entry.song; }
+    };
+
+    template <>
+    struct JournalOpsOf<Artist> {
+        static constexpr JournalOp add = JournalOp::AddArtist;
+        static constexpr JournalOp upsert = JournalOp::UpsertArtist;
+        static constexpr JournalOp remove = JournalOp::RemoveArtist;
+        static constexpr JournalOp removeByKey = JournalOp::RemoveArtist;
+        static Artist& record(JournalEntry& entry) { return entry.artist; }
+    };
+
+    template <>
+    struct JournalOpsOf<Album> {
+        static constexpr JournalOp add = JournalOp::AddAlbum;
+        static constexpr JournalOp upsert = JournalOp::UpsertAlbum;
+        static constexpr JournalOp remove = JournalOp::RemoveAlbum;
+        static constexpr JournalOp removeByKey = JournalOp::RemoveAlbumByKey;
+        static Album& record(JournalEntry& entry) { return entry.album; }
+    };
+
+    /**
+     * @brief Size and content hash of a base file, used to tell whether the journal still applies to it.
+     */
+    struct FileFingerprint {
+        std::uint64_t size = 0;
+        std::uint64_t hash = 0;
+
+        bool operator==(const FileFingerprint& other) const { return size == other.size && hash == other.hash; }
+        bool operator!=(const FileFingerprint& other) const { return !(*this == other); }
+    };
+
+    namespace detail {
+        /**
+         * @brief Fast non-cryptographic hash over 8-byte words (FNV offset basis, multiply-xorshift mixing).
+         */
+        inline std::uint64_t hashBytes(const char* data, std::size_t size, std::uint64_t seed = 0xcbf29ce484222325ull) {
+            std::uint64_t hash = seed ^ size;
+            std::size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+                hash ^= hash >> 29;
+            }
+            std::uint64_t tail = 0;
+            if (i < size) {
+                std::memcpy(&tail, data + i, size - i);
+            }
+            hash = (hash ^ tail) * 0x9E3779B97F4A7C15ull;
+            return hash ^ (hash >> 32);
+        }
+
+        inline std::uint32_t checksum(const char* data, std::size_t size) {
+            return static_cast<std::uint32_t>(hashBytes(data, size, 0x84222325cbf29ce4ull));
+        }
+
+        class JournalWriter {
+        public:
+            void u8(std::uint8_t value) { bytes.push_back(static_cast<char>(value)); }
+            void i32(std::int32_t value) { raw(&value, sizeof(value)); }
+            void f64(double value) { raw(&value, sizeof(value)); }
+            void text(std::string_view value) {
+                std::uint32_t length = static_cast<std::uint32_t>(value.size());
+                raw(&length, sizeof(length));
+                bytes.append(value.data(), value.size());
+            }
+
+            std::string bytes;
+
+        private:
+            void raw(const void* data, std::size_t size) { bytes.append(static_cast<const char*>(data), size); }
+        };
+
+        class JournalReader {
+        public:
+            JournalReader(const char* data, std::size_t size) : data(data), size(size) {}
+
+            bool u8(std::uint8_t& value) { return raw(&value, sizeof(value)); }
+            bool i32(std::int32_t& value) { return raw(&value, sizeof(value)); }
+            bool f64(double& value) { return raw(&value, sizeof(value)); }
+            bool text(std::string_view& value) {
+                std::uint32_t length;
+                if (!raw(&length, sizeof(length)) || length > size - at) {
+                    return false;
+                }
+                value = std::string_view(data + at, length);
+                at += length;
+                return true;
+            }
+            bool done() const { return at == size; }
+
+        private:
+            bool raw(void* out, std::size_t bytes) {
+                if (bytes > size - at) {
+                    return false;
+                }
+                std::memcpy(out, data + at, bytes);
+                at += bytes;
+                return true;
+            }
+
+            const char* data;
+            std::size_t size;
+            std::size_t at = 0;
+        };
+
+        /**
+         * @brief Writes the fields of `record` in schema order: texts and names as text,
+         * numbers as `f64` or `i32`.
+         */
+        template <typename T>
+        void encodeRecord(JournalWriter& out, const T& record) {
+            forEachValue<T>(record, [&](const auto& field, const auto& value) {
+                if constexpr (kindOf<decltype(field)> == FieldKind::Name) {
+                    out.text(field.dictionary().lookup(value));
+                } else if constexpr (kindOf<decltype(field)> == FieldKind::Text) {
+                    out.text(value);
+                } else if constexpr (std::is_integral_v<std::decay_t<decltype(value)>>) {
+                    out.i32(value);
+                } else {
+                    out.f64(value);
+                }
+            });
+        }
+
+        template <typename T, std::size_t... I>
+        bool decodeRecord(JournalReader& in, T& record, std::index_sequence<I...>) {
+            constexpr auto schema = RecordSchema<T>::fields();
+            std::tuple<std::conditional_t<kindOf<FieldAt<T, I>> == FieldKind::Number, typename FieldAt<T, I>::Value, std::string_view>...> values;
+            auto read = [&](const auto& field, auto& value) {
+                if constexpr (kindOf<decltype(field)> != FieldKind::Number) {
+                    return in.text(value);
+                } else if constexpr (std::is_integral_v<std::decay_t<decltype(value)>>) {
+                    return in.i32(value);
+                } else {
+                    return in.f64(value);
+                }
+            };
+            if (!(read(std::get<I>(schema), std::get<I>(values)) && ...)) {
+                return false;
+            }
+            // Names are read as text, so this is the constructor that interns them
+            record = T(std::get<I>(values)...);
+            return true;
+        }
+
+        /**
+         * @brief Reads what `encodeRecord` wrote.
+         */
+        template <typename T>
+        bool decodeRecord(JournalReader& in, T& record) {
+            return decodeRecord(in, record, std::make_index_sequence<fieldCount<T>>());
+        }
+
+        inline std::string encodeEntry(const JournalEntry& entry) {
+            JournalWriter out;
+            out.u8(static_cast<std::uint8_t>(entry.op));
+            switch (entry.op) {
+                case JournalOp::AddSong:
+                case JournalOp::UpsertSong:
+                    encodeRecord(out, entry.song);
+                    break;
+                case JournalOp::AddArtist:
+                case JournalOp::UpsertArtist:
+                    encodeRecord(out, entry.artist);
+                    break;
+                case JournalOp::AddAlbum:
+                case JournalOp::UpsertAlbum:
+                    encodeRecord(out, entry.album);
+                    break;
+                case JournalOp::RemoveSongByKey:
+                case JournalOp::RemoveAlbumByKey:
+                    out.text(entry.key);
+                    out.text(entry.keyArtist);
+                    break;
+                default:
+                    out.text(entry.key);
+                    break;
+            }
+            return out.bytes;
+        }
+
+        inline bool decodeEntry(const char* data, std::size_t size, JournalEntry& entry) {
+            JournalReader in(data, size);
+            std::uint8_t op;
+            if (!in.u8(op) || op < 1 || op > 11) {
+                return false;
+            }
+            entry.op = static_cast<JournalOp>(op);
+            switch (entry.op) {
+                case JournalOp::AddSong:
+                case JournalOp::UpsertSong:
+                    return decodeRecord(in, entry.song) && in.done();
+                case JournalOp::AddArtist:
+                case JournalOp::UpsertArtist:
+                    return decodeRecord(in, entry.artist) && in.done();
+                case JournalOp::AddAlbum:
+                case JournalOp::UpsertAlbum:
+                    return decodeRecord(in, entry.album) && in.done();
+                default:
+                    break;
+            }
+            std::string_view key;
+            if (!in.text(key)) {
+                return false;
+            }
+            entry.key = std::string(key);
+            if (entry.op == JournalOp::RemoveSongByKey || entry.op == JournalOp::RemoveAlbumByKey) {
+                std::string_view artist;
+                if (!in.text(artist)) {
+                    return false;
+                }
+                entry.keyArtist = std::string(artist);
+            }
+            return in.done();
+        }
+
+        constexpr char journalMagic[8] = {'R', 'C', 'J', 'O', 'U', 'R', 'N', 'L'};
+        constexpr std::uint32_t journalVersion = 1;
+        constexpr std::size_t journalHeaderSize = 8 + 4 + 4 + 3 * 16;
+    }
+
+    /**
+     * @brief Computes the fingerprint of a file; a missing file has size 0 and hash 0.
+     */
+    inline FileFingerprint fingerprintFile(const std::string& filename) {
+        FileFingerprint fingerprint;
+        MappedFile file(filename);
+        if (file.isOpen()) {
+            fingerprint.size = file.size();
+            fingerprint.hash = detail::hashBytes(file.data(), file.size());
+        }
+        return fingerprint;
+    }
+
+    class Journal {
+    public:
+        Journal() = default;
+        ~Journal() { close(); }
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        /**
+         * @brief Opens (or creates) the journal and replays its records through `apply`.
+         *
+         * `baseFiles` are the songs, artists and albums files the journal is stacked on.
+         * Records for a base file whose fingerprint no longer matches the header are skipped,
+         * and a torn record at the end (from a crash mid-append) is dropped. In both cases
+         * `needsCompaction()` becomes true so the caller can fold the journal right away.
+         * Warnings are appended to `warnings`; returns false only if the journal cannot be used.
+         */
+        bool open(const std::string& journalFilename, const std::vector<std::string>& baseFiles,
+                  const std::function<void(const JournalEntry&)>& apply,
+                  std::vector<std::string>& warnings, std::string& error) {
+            close();
+            filename = journalFilename;
+            bases = baseFiles;
+            for (int i = 0; i < 3; ++i) {
+                touched[i] = false;
+            }
+            pending = 0;
+            forceCompaction = false;
+
+            std::error_code ec;
+            if (!std::filesystem::exists(filename, ec)) {
+                return reset(error);
+            }
+
+            std::uint64_t validBytes = 0;
+            {
+                MappedFile file(filename);
+                if (!file.isOpen()) {
+                    error = "cannot open " + filename;
+                    return false;
+                }
+                const char* data = file.data();
+                std::size_t size = file.size();
+                std::uint32_t version = 0;
+                if (size >= detail::journalHeaderSize) {
+                    std::memcpy(&version, data + 8, sizeof(version));
+                }
+                if (size < detail::journalHeaderSize || std::memcmp(data, detail::journalMagic, 8) != 0 ||
+                    version != detail::journalVersion) {
+                    error = filename + " is not a journal file";
+                    return false;
+                }
+                bool applies[3];
+                for (int i = 0; i < 3; ++i) {
+                    FileFingerprint stored;
+                    std::memcpy(&stored.size, data + 16 + i * 16, 8);
+                    std::memcpy(&stored.hash, data + 24 + i * 16, 8);
+                    applies[i] = stored == fingerprintFile(bases[i]);
+                }
+
+                std::size_t at = detail::journalHeaderSize;
+                std::size_t skipped[3] = {0, 0, 0};
+                JournalEntry entry;
+                while (at < size) {
+                    std::uint32_t length, sum;
+                    if (size - at < 8) {
+                        break;
+                    }
+                    std::memcpy(&length, data + at, 4);
+                    std::memcpy(&sum, data + at + 4, 4);
+                    if (length > size - at - 8 || detail::checksum(data + at + 8, length) != sum ||
+                        !detail::decodeEntry(data + at + 8, length, entry)) {
+                        break;
+                    }
+                    at += 8 + length;
+                    int collection = journalCollection(entry.op);
+                    if (applies[collection]) {
+                        apply(entry);
+                        touched[collection] = true;
+                    } else {
+                        ++skipped[collection];
+                    }
+                    ++pending;
+                }
+                validBytes = at;
+                if (at < size) {
+                    warnings.push_back("dropped " + std::to_string(size - at) + " bytes of an incomplete record at the end of " + filename);
+                    forceCompaction = true;
+                }
+                for (int i = 0; i < 3; ++i) {
+                    if (skipped[i] != 0) {
+                        warnings.push_back("skipped " + std::to_string(skipped[i]) + " journal entries for " + bases[i] +
+                                           ", which changed after they were logged");
+                        forceCompaction = true;
+                    }
+                }
+                journalBytes = validBytes;
+            }
+            if (forceCompaction) {
+                std::filesystem::resize_file(filename, validBytes, ec);
+            }
+            return openForAppend(error);
+        }
+
+        /**
+         * @brief Appends one change and flushes it to the operating system (and to disk with `setSync(true)`).
+         */
+        bool append(const JournalEntry& entry) {
+            if (file == nullptr) {
+                return false;
+            }
+            std::string body = detail::encodeEntry(entry);
+            std::uint32_t header[2] = {static_cast<std::uint32_t>(body.size()), detail::checksum(body.data(), body.size())};
+            bool ok = std::fwrite(header, sizeof(header), 1, file) == 1 &&
+                      std::fwrite(body.data(), 1, body.size(), file) == body.size() &&
+                      std::fflush(file) == 0;
+            if (ok && syncEachCommit) {
+#ifdef _WIN32
+                ok = _commit(_fileno(file)) == 0;
+#else
+                ok = fsync(fileno(file)) == 0;
+#endif
+            }
+            journalBytes += sizeof(header) + body.size();
+            touched[journalCollection(entry.op)] = true;
+            ++pending;
+            if (!ok) {
+                std::cerr << "Error - cannot write the change to " << filename << "!" << std::endl;
+            }
+            return ok;
+        }
+
+        /**
+         * @brief Starts an empty journal for the current base files, replacing the old one atomically.
+         * Called after the touched base files have been rewritten.
+         */
+        bool reset(std::string& error) {
+            close();
+            std::string header(detail::journalMagic, 8);
+            header.append(reinterpret_cast<const char*>(&detail::journalVersion), 4);
+            header.append(4, '\0');
+            for (int i = 0; i < 3; ++i) {
+                FileFingerprint fingerprint = fingerprintFile(bases[i]);
+                header.append(reinterpret_cast<const char*>(&fingerprint.size), 8);
+                header.append(reinterpret_cast<const char*>(&fingerprint.hash), 8);
+            }
+            const std::string tempName = filename + ".tmp";
+            std::FILE* out = std::fopen(tempName.c_str(), "wb");
+            if (out == nullptr) {
+                error = "cannot open " + tempName + " for writing";
+                return false;
+            }
+            bool ok = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+            ok = std::fclose(out) == 0 && ok;
+            std::error_code ec;
+            if (ok) {
+                std::filesystem::rename(tempName, filename, ec);
+            }
+            if (!ok || ec) {
+                error = "cannot write " + filename;
+                return false;
+            }
+            for (int i = 0; i < 3; ++i) {
+                touched[i] = false;
+            }
+            pending = 0;
+            forceCompaction = false;
+            journalBytes = header.size();
+            return openForAppend(error);
+        }
+
+        void close() {
+            if (file != nullptr) {
+                std::fclose(file);
+                file = nullptr;
+            }
+        }
+
+        void setSync(bool enabled) { syncEachCommit = enabled; }
+
+        /**
+         * @brief True if records for the given collection (0 songs, 1 artists, 2 albums) are waiting to be folded.
+         */
+        bool isTouched(int collection) const { return touched[collection]; }
+        std::size_t pendingEntries() const { return pending; }
+        std::uint64_t sizeInBytes() const { return journalBytes; }
+
+        /**
+         * @brief Compaction policy: fold once the journal grows past a quarter of the base files
+         * (and at least 64 KiB), or right away after replay had to skip or drop records.
+         */
+        bool needsCompaction(std::uint64_t baseBytes) const {
+            if (forceCompaction) {
+                return true;
+            }
+            std::uint64_t threshold = baseBytes / 4;
+            if (threshold < 64 * 1024) {
+                threshold = 64 * 1024;
+            }
+            return pending != 0 && journalBytes > threshold;
+        }
+
+    private:
+        bool openForAppend(std::string& error) {
+            file = std::fopen(filename.c_str(), "ab");
+            if (file == nullptr) {
+                error = "cannot open " + filename + " for appending";
+                return false;
+            }
+            return true;
+        }
+
+        std::string filename;
+        std::vector<std::string> bases;
+        std::FILE* file = nullptr;
+        bool touched[3] = {false, false, false};
+        bool forceCompaction = false;
+        bool syncEachCommit = false;
+        std::size_t pending = 0;
+        std::uint64_t journalBytes = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,1082 @@
+/**
+ * @file library.h
+ * @brief Class owning the songs, artists and albums collections together with their indexes.
+ * Every add and remove goes through the library so the indexes always match the collections.
+ * The titles and names of the records live in the library's own text arena (see `text_arena.h`).
+ */
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "secondary_index.h"
+#include "primary_key.h"
+#include "query_cache.h"
+#include "range_index.h"
+#include "record_schema.h"
+#include "filter.h"
+#include "column_store.h"
+#include "ranking.h"
+#include "text_index.h"
+#include "artist_names.h"
+#include "aggregates.h"
+#include "journal.h"
+#include "metrics.h"
+#include "text_arena.h"
+
+namespace rc {
+    namespace detail {
+        /**
+         * @brief Rows of `items` (except the `removed` ones) whose key (as returned by `keyOf`)
+         * is one of `keys`, in ascending order, found in one pass over `items`. `matched[i]`
+         * tells whether `keys[i]` found any row; a key listed twice only matches the first
+         * time, as if the removals were made one after the other.
+         */
+        template <typename T, typename Key, typename KeyOf, typename Hash = std::hash<Key>>
+        std::vector<std::size_t> rowsWithKeys(const std::vector<T>& items, const RemovedRows& removed, const std::vector<Key>& keys,
+                                              KeyOf keyOf, std::vector<bool>& matched, Hash hash = Hash()) {
+            std::vector<std::size_t> rows;
+            if (keys.size() == 1) {
+                // The common case: a plain comparison is cheaper than hashing every key
+                const Key& key = keys.front();
+                for (std::size_t row = 0; row < items.size(); ++row) {
+                    if (keyOf(items[row]) == key && !removed.contains(row)) {
+                        rows.push_back(row);
+                    }
+                }
+                matched[0] = !rows.empty();
+                return rows;
+            }
+            std::unordered_map<Key, std::size_t, Hash> first(keys.size(), hash);
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                first.emplace(keys[i], i);
+            }
+            for (std::size_t row = 0; row < items.size(); ++row) {
+                auto it = first.find(keyOf(items[row]));
+                if (it != first.end() && !removed.contains(row)) {
+                    rows.push_back(row);
+                    matched[it->second] = true;
+                }
+            }
+            return rows;
+        }
+
+        /**
+         * @brief Rows of `keys` found one key at a time by `rowsOf` (an index lookup returning
+         * ascending rows), in ascending order, with `matched` filled in like `rowsWithKeys`.
+         */
+        template <typename Key, typename RowsOf>
+        std::vector<std::size_t> rowsOfKeys(const std::vector<Key>& keys, RowsOf rowsOf, std::vector<bool>& matched) {
+            std::vector<std::size_t> rows;
+            std::set<Key> seen;
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                if (keys.size() > 1 && !seen.insert(keys[i]).second) {
+                    continue;
+                }
+                std::vector<std::size_t> found = rowsOf(keys[i]);
+                matched[i] = !found.empty();
+                rows.insert(rows.end(), found.begin(), found.end());
+            }
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+            return rows;
+        }
+    }
+
+    class Library {
+    public:
+        Library() = default;
+
+        /**
+         * @brief Takes the collections together with the arena holding their text, e.g. the one
+         * they were loaded into, which the library then shares. Without one, the text is
+         * copied into a new arena.
+         */
+        Library(std::vector<Song> songs, std::vector<Artist> artists, std::vector<Album> albums,
+                std::shared_ptr<TextArena> text = nullptr)
+            : songs(std::move(songs)), artists(std::move(artists)), albums(std::move(albums)), text(std::move(text)) {
+            if (this->text == nullptr) {
+                this->text = std::make_shared<TextArena>();
+                storeAllText(*this->text);
+            }
+            for (const auto& song : this->songs) {
+                liveTextBytes += song.getTitle().size();
+            }
+            for (const auto& album : this->albums) {
+                liveTextBytes += album.getName().size();
+            }
+            rebuildIndexes();
+        }
+
+        /**
+         * @brief The collections, removed records included until they are erased (see
+         * `compact`): whoever goes over a whole collection skips the rows `is*Removed` reports.
+         * The rows returned by the lookups, filters and searches never include removed records.
+         */
+        const std::vector<Song>& getSongs() const { return songs; }
+        const std::vector<Artist>& getArtists() const { return artists; }
+        const std::vector<Album>& getAlbums() const { return albums; }
+
+        bool isSongRemoved(std::size_t row) const { return removedSongs.contains(row); }
+        bool isArtistRemoved(std::size_t row) const { return removedArtists.contains(row); }
+        bool isAlbumRemoved(std::size_t row) const { return removedAlbums.contains(row); }
+
+        /**
+         * @brief Number of records, not counting the removed ones.
+         */
+        std::size_t songCount() const { return songs.size() - removedSongs.count(); }
+        std::size_t artistCount() const { return artists.size() - removedArtists.count(); }
+        std::size_t albumCount() const { return albums.size() - removedAlbums.count(); }
+
+        /**
+         * @brief Adds a record unless one with the same primary key (see `upsertSong`) exists
+         * already. Returns false, without changing or logging anything, if one does.
+         */
+        bool addSong(Song song) { return add(std::move(song)); }
+        bool addArtist(Artist artist) { return add(std::move(artist)); }
+        bool addAlbum(Album album) { return add(std::move(album)); }
+
+        /**
+         * @brief Replaces the record with the same primary key (song: title and artist, album:
+         * name and artist, artist: name), or adds the record if there is none. Returns true if
+         * a record was replaced; with duplicate keys the first one is. The row keeps its place,
+         * and only the indexes whose fields changed are touched (none, and cached results stay
+         * valid, when the record is unchanged).
+         */
+        bool upsertSong(Song song) { return upsert(std::move(song)); }
+        bool upsertArtist(Artist artist) { return upsert(std::move(artist)); }
+        bool upsertAlbum(Album album) { return upsert(std::move(album)); }
+
+        /**
+         * @brief Removes records, keeping the order of the remaining ones.
+         *
+         * - `removeSong(title, artist)` and `removeAlbum(name, artist)` remove the records with
+         *   that primary key, `removeArtist(name)` the artists with that name. The rows are
+         *   found through the primary key indexes (see `enablePrimaryKeys`).
+         * - `removeSong(title)` and `removeAlbum(name)` remove every song or album with that
+         *   title or name, whatever its artist. The rows are found through the text indexes
+         *   (see `enableTextSearch`).
+         *
+         * Without those indexes the collection is scanned. A removed record is only marked as
+         * such: it keeps its row, so no other row is renumbered, and each index takes out just
+         * that row. The removed rows are erased, and the rows after them renumbered, by the
+         * next `compact`. Returns true if anything was removed.
+         */
+        bool removeSong(const std::string& title) { return removeSongs({title}).front(); }
+        bool removeSong(const std::string& title, const std::string& artist) { return removeSongsByKey({{title, artist}}).front(); }
+        bool removeArtist(const std::string& name) { return removeArtists({name}).front(); }
+        bool removeAlbum(const std::string& name) { return removeAlbums({name}).front(); }
+        bool removeAlbum(const std::string& name, const std::string& artist) { return removeAlbumsByKey({{name, artist}}).front(); }
+
+        /**
+         * @brief Removes the records of every title, name or key in the list, looking them up
+         * with a single pass over a collection that is not indexed instead of one per entry.
+         * Returns, per entry, whether it removed anything; an entry listed twice only removes
+         * the first time, as if the removals were made one after the other.
+         */
+        std::vector<bool> removeSongs(const std::vector<std::string>& titles) { return removeNamed<Song>(titles); }
+        std::vector<bool> removeSongsByKey(const std::vector<KeyText<Song>>& keys) { return removeKeys<Song>(keys); }
+        std::vector<bool> removeAlbums(const std::vector<std::string>& names) { return removeNamed<Album>(names); }
+        std::vector<bool> removeAlbumsByKey(const std::vector<KeyText<Album>>& keys) { return removeKeys<Album>(keys); }
+
+        std::vector<bool> removeArtists(const std::vector<std::string>& names) {
+            std::vector<KeyText<Artist>> keys;
+            keys.reserve(names.size());
+            for (const auto& name : names) {
+                keys.push_back({name});
+            }
+            return removeKeys<Artist>(keys);
+        }
+
+        /**
+         * @brief Whether the removed records of some collection make up more than an eighth of
+         * it, the point from which `compact` is worth its pass over the collection.
+         */
+        bool needsCompaction() const {
+            return needsCompaction<Song>() || needsCompaction<Artist>() || needsCompaction<Album>();
+        }
+
+        /**
+         * @brief Erases the removed records and renumbers the rows after them in every index,
+         * with one pass per collection that has removed records. Row numbers obtained before
+         * are no longer valid afterwards.
+         */
+        void compact() {
+            eraseRemoved<Song>();
+            eraseRemoved<Artist>();
+            eraseRemoved<Album>();
+        }
+
+        /**
+         * @brief Whether a removal that leaves a collection needing compaction compacts it right
+         * away (the default), so the cost is spread over the removals. A caller that compacts
+         * off the request path instead, such as the server (see `server.h`), turns it off.
+         */
+        void setAutoCompact(bool enabled) { autoCompact = enabled; }
+
+        /**
+         * @brief Builds the primary key indexes (see `primary_key.h`) and keeps them up to date
+         * from now on. Without them, key lookups and upserts scan the collection.
+         */
+        void enablePrimaryKeys() {
+            compact();   // the index is built from every record, so the removed ones go first
+            songKeys.build(songs);
+            artistKeys.build(artists);
+            albumKeys.build(albums);
+        }
+
+        bool hasPrimaryKeys() const { return songKeys.isBuilt(); }
+
+        /**
+         * @brief Row of the record with the given primary key, or `noRow`. A name that was
+         * never interned cannot match anything.
+         */
+        std::size_t findSong(std::string_view title, std::string_view artist) const { return findKey<Song>({title, artist}); }
+        std::size_t findArtist(std::string_view name) const { return findKey<Artist>({name}); }
+        std::size_t findAlbum(std::string_view name, std::string_view artist) const { return findKey<Album>({name, artist}); }
+
+        /**
+         * @brief Index lookups; each returns the matching rows in collection order.
+         * A name that was never interned cannot match anything and yields an empty list.
+         */
+        const std::vector<std::size_t>& findSongsByArtist(const std::string& artist) const {
+            ScopedTimer timer(Metric::FindByArtist);
+            return timer.found(songsByArtist.find(artistDictionary().find(artist)));
+        }
+        const std::vector<std::size_t>& findSongsByGenre(const std::string& genre) const {
+            ScopedTimer timer(Metric::FindByGenre);
+            return timer.found(songsByGenre.find(genreDictionary().find(genre)));
+        }
+        const std::vector<std::size_t>& findAlbumsByArtist(const std::string& artist) const {
+            ScopedTimer timer(Metric::FindByArtist);
+            return timer.found(albumsByArtist.find(artistDictionary().find(artist)));
+        }
+        const std::vector<std::size_t>& findAlbumsByGenre(const std::string& genre) const {
+            ScopedTimer timer(Metric::FindByGenre);
+            return timer.found(albumsByGenre.find(genreDictionary().find(genre)));
+        }
+
+        /**
+         * @brief Builds the column store (see `column_store.h`) and keeps it in sync from now on.
+         * Without it, filters fall back to checking every record object.
+         */
+        void enableColumnStore() {
+            if (columnsEnabled) {
+                return;
+            }
+            columnsEnabled = true;
+            for (const auto& song : songs) {
+                songColumns.append(song);
+            }
+            for (const auto& album : albums) {
+                albumColumns.append(album);
+            }
+        }
+
+        bool hasColumnStore() const { return columnsEnabled; }
+
+        /**
+         * @brief Builds the sorted range indexes on song duration, album year and album rating
+         * (see `range_index.h`) and keeps them up to date from now on.
+         */
+        void enableRangeIndexes() {
+            compact();
+            songsByDuration.build(songs);
+            albumsByYear.build(albums);
+            albumsByRating.build(albums);
+        }
+
+        bool hasRangeIndexes() const { return songsByDuration.isBuilt(); }
+
+        /**
+         * @brief Returns the rows matching every condition of the filter, in collection order.
+         *
+         * With `enableRangeIndexes`, a filter whose numeric conditions select only a small
+         * share of the records reads its candidates from the narrowest range and checks the
+         * remaining conditions on those rows alone. Otherwise the column store or the records
+         * are scanned. With `enableQueryCache`, a repeated filter is answered from the cache.
+         */
+        std::vector<std::size_t> filterSongs(const SongFilter& filter) const {
+            ScopedTimer timer(Metric::Filter);
+            std::vector<std::size_t> rows;
+            const std::string key = QueryKey('s').add(filter).str();
+            if (queryCache.find(key, songsGeneration, rows)) {
+                timer.rows(0, rows.size());
+                return rows;
+            }
+            if (songsByDuration.isBuilt() &&
+                detail::selectFromRange(songs, filter, {songsByDuration.find(filterRange(filter, SongField::Duration))}, rows)) {
+                timer.rows(rows.size(), rows.size());
+            } else {
+                if (columnsEnabled) {
+                    rows = songColumns.select(filter).rows();
+                    removedSongs.dropFrom(rows);
+                } else {
+                    for (std::size_t row = 0; row < songs.size(); ++row) {
+                        if (matches(songs[row], filter) && !removedSongs.contains(row)) {
+                            rows.push_back(row);
+                        }
+                    }
+                }
+                timer.rows(songs.size(), rows.size());
+            }
+            queryCache.store(key, songsGeneration, rows);
+            return rows;
+        }
+
+        std::vector<std::size_t> filterAlbums(const AlbumFilter& filter) const {
+            ScopedTimer timer(Metric::Filter);
+            std::vector<std::size_t> rows;
+            const std::string key = QueryKey('a').add(filter).str();
+            if (queryCache.find(key, albumsGeneration, rows)) {
+                timer.rows(0, rows.size());
+                return rows;
+            }
+            if (albumsByYear.isBuilt() &&
+                detail::selectFromRange(albums, filter, {albumsByYear.find(filterRange(filter, AlbumField::Year)),
+                                                         albumsByRating.find(filterRange(filter, AlbumField::Rating))}, rows)) {
+                timer.rows(rows.size(), rows.size());
+            } else {
+                if (columnsEnabled) {
+                    rows = albumColumns.select(filter).rows();
+                    removedAlbums.dropFrom(rows);
+                } else {
+                    for (std::size_t row = 0; row < albums.size(); ++row) {
+                        if (matches(albums[row], filter) && !removedAlbums.contains(row)) {
+                            rows.push_back(row);
+                        }
+                    }
+                }
+                timer.rows(albums.size(), rows.size());
+            }
+            queryCache.store(key, albumsGeneration, rows);
+            return rows;
+        }
+
+        /**
+         * @brief Artist rows matching `filter`. Artists are few, so they have no column copy.
+         */
+        std::vector<std::size_t> filterArtists(const ArtistFilter& filter) const {
+            ScopedTimer timer(Metric::Filter);
+            std::vector<std::size_t> rows;
+            const std::string key = QueryKey('r').add(filter).str();
+            if (queryCache.find(key, artistsGeneration, rows)) {
+                timer.rows(0, rows.size());
+                return rows;
+            }
+            for (std::size_t row = 0; row < artists.size(); ++row) {
+                if (matches(artists[row], filter) && !removedArtists.contains(row)) {
+                    rows.push_back(row);
+                }
+            }
+            timer.rows(artists.size(), rows.size());
+            queryCache.store(key, artistsGeneration, rows);
+            return rows;
+        }
+
+        /**
+         * @brief Builds the live album ranking (see `ranking.h`) and keeps it ordered from now on.
+         */
+        void enableRankingIndex() {
+            if (rankingEnabled) {
+                return;
+            }
+            compact();
+            rankingEnabled = true;
+            ranking.build(albums);
+        }
+
+        bool hasRankingIndex() const { return rankingEnabled; }
+
+        /**
+         * @brief Returns the rows of the `k` best ranked albums (all albums if `k` is 0).
+         * Reads the live ranking when it is enabled, otherwise runs a partial selection, whose
+         * result goes to the query cache.
+         */
+        std::vector<std::size_t> rankAlbums(std::size_t k) const {
+            ScopedTimer timer(Metric::RankAlbums);
+            if (rankingEnabled) {
+                // The live ranking only walks the rows it returns
+                std::vector<std::size_t> rows = ranking.top(k);
+                timer.rows(rows.size(), rows.size());
+                return rows;
+            }
+            std::vector<std::size_t> rows;
+            const std::string key = QueryKey('k').add(static_cast<std::uint64_t>(k)).str();
+            if (queryCache.find(key, albumsGeneration, rows)) {
+                timer.rows(0, rows.size());
+                return rows;
+            }
+            // Enough rows that `k` remain once the removed albums are dropped
+            rows = topAlbums(albums, k == 0 ? 0 : k + removedAlbums.count());
+            removedAlbums.dropFrom(rows);
+            rows.resize(std::min(rows.size(), k == 0 ? rows.size() : k));
+            timer.rows(albums.size(), rows.size());
+            queryCache.store(key, albumsGeneration, rows);
+            return rows;
+        }
+
+        /**
+         * @brief Builds the prefix, trigram and fuzzy search indexes over song titles, album names
+         * and artist names (see `text_index.h` and `artist_names.h`) and keeps them up to date from now on.
+         */
+        void enableTextSearch() {
+            compact();
+            songTitles.build(songs);
+            albumNames.build(albums);
+            artistNames.build(artists);
+            usedArtistNames.buildSearch();
+        }
+
+        /**
+         * @brief Case-insensitive title and name search returning up to `limit` rows, best match first.
+         * `TextMatch::Fuzzy` also finds names with a few typos or different punctuation, closest first.
+         * Without `enableTextSearch` the records are scanned instead.
+         */
+        std::vector<std::size_t> searchSongs(std::string_view query, TextMatch match, std::size_t limit) const {
+            return search('S', songsGeneration, query, match, limit, [&] {
+                return songTitles.search(songs, query, match, limit);
+            });
+        }
+        std::vector<std::size_t> searchAlbums(std::string_view query, TextMatch match, std::size_t limit) const {
+            return search('A', albumsGeneration, query, match, limit, [&] {
+                return albumNames.search(albums, query, match, limit);
+            });
+        }
+        std::vector<std::size_t> searchArtists(std::string_view query, TextMatch match, std::size_t limit) const {
+            return search('R', artistsGeneration, query, match, limit, [&] {
+                return artistNames.search(artists, query, match, limit);
+            });
+        }
+
+        /**
+         * @brief Like `searchArtists`, but over the names of every artist a song, album or artist
+         * record refers to, with or without an artist record (see `artist_names.h`). Returns
+         * their artist dictionary IDs.
+         */
+        std::vector<StringId> searchArtistNames(std::string_view query, TextMatch match, std::size_t limit) const {
+            ScopedTimer timer(Metric::TextSearch);
+            std::vector<StringId> names = usedArtistNames.search(query, match, limit);
+            timer.rows(names.size(), names.size());
+            return names;
+        }
+
+        /**
+         * @brief Keeps up to `maxBytes` bytes of filter, text search and ranking results (see
+         * `query_cache.h`), so repeating a query between changes does not recompute it.
+         * 0 turns the cache off, which is the default.
+         */
+        void enableQueryCache(std::size_t maxBytes) { queryCache.setLimit(maxBytes); }
+
+        /**
+         * @brief Computes the per-artist and per-genre statistics (see `aggregates.h`) and
+         * updates them on every following add and remove.
+         */
+        void enableAggregates() {
+            if (aggregatesEnabled) {
+                return;
+            }
+            compact();
+            aggregatesEnabled = true;
+            for (const auto& song : songs) {
+                aggregates.add(song);
+            }
+            for (const auto& album : albums) {
+                aggregates.add(album);
+            }
+        }
+
+        bool hasAggregates() const { return aggregatesEnabled; }
+
+        /**
+         * @brief Statistics of the songs and albums matching the filters, grouped by artist or
+         * genre and sorted by name. Without filters the maintained aggregates are copied when
+         * enabled; otherwise the matching rows are grouped in one pass.
+         */
+        std::vector<GroupSummary> groupStats(GroupBy by, const SongFilter& songFilter = {}, const AlbumFilter& albumFilter = {}) const {
+            ScopedTimer timer(Metric::GroupStats);
+            if (aggregatesEnabled && songFilter.empty() && albumFilter.empty()) {
+                return aggregates.groups(by);
+            }
+            return aggregateRows(songs, filterSongs(songFilter), albums, filterAlbums(albumFilter), by);
+        }
+
+        /**
+         * @brief Statistics of a single artist or genre (empty if it has no songs or albums).
+         */
+        GroupStats groupStats(GroupBy by, const std::string& key) const {
+            ScopedTimer timer(Metric::GroupStats);
+            const StringId id = groupDictionary(by).find(key);
+            if (aggregatesEnabled) {
+                return aggregates.find(by, id);
+            }
+            bool byArtist = by == GroupBy::Artist;
+            std::vector<GroupSummary> groups = aggregateRows(songs, byArtist ? songsByArtist.find(id) : songsByGenre.find(id),
+                                                             albums, byArtist ? albumsByArtist.find(id) : albumsByGenre.find(id), by);
+            return groups.empty() ? GroupStats() : groups.front().stats;
+        }
+
+        /**
+         * @brief Logs every following add and remove to `journal` (see `journal.h`); nullptr stops logging.
+         */
+        void attachJournal(Journal* journal) { this->journal = journal; }
+
+        /**
+         * @brief Makes the change described by `entry` (logged like any other change).
+         * Returns false for an add whose key exists already and a removal that matched nothing.
+         */
+        bool change(const JournalEntry& entry) {
+            switch (entry.op) {
+                case JournalOp::AddSong: return addSong(entry.song);
+                case JournalOp::AddArtist: return addArtist(entry.artist);
+                case JournalOp::AddAlbum: return addAlbum(entry.album);
+                case JournalOp::RemoveSong: return removeSong(entry.key);
+                case JournalOp::RemoveSongByKey: return removeSong(entry.key, entry.keyArtist);
+                case JournalOp::RemoveArtist: return removeArtist(entry.key);
+                case JournalOp::RemoveAlbum: return removeAlbum(entry.key);
+                case JournalOp::RemoveAlbumByKey: return removeAlbum(entry.key, entry.keyArtist);
+                case JournalOp::UpsertSong: upsertSong(entry.song); return true;
+                case JournalOp::UpsertArtist: upsertArtist(entry.artist); return true;
+                case JournalOp::UpsertAlbum: upsertAlbum(entry.album); return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Makes the changes in order, like `change` on each one, except that every run of
+         * consecutive removals from the same collection is made with one `remove*s` call.
+         * Returns, per entry, whether it changed anything.
+         */
+        std::vector<bool> changeAll(const std::vector<JournalEntry>& entries) {
+            std::vector<bool> changed(entries.size(), false);
+            std::size_t i = 0;
+            while (i < entries.size()) {
+                const JournalOp op = entries[i].op;
+                if (!isRemoval(op)) {
+                    changed[i] = change(entries[i]);
+                    ++i;
+                    continue;
+                }
+                std::vector<std::string> keys;
+                std::vector<KeyText<Song>> keyed;   // the keys of songs and albums alike: a title or name and an artist
+                std::size_t end = i;
+                for (; end < entries.size() && entries[end].op == op; ++end) {
+                    keys.push_back(entries[end].key);
+                    keyed.push_back({entries[end].key, entries[end].keyArtist});
+                }
+                std::vector<bool> removed;
+                switch (op) {
+                    case JournalOp::RemoveSong: removed = removeSongs(keys); break;
+                    case JournalOp::RemoveSongByKey: removed = removeSongsByKey(keyed); break;
+                    case JournalOp::RemoveArtist: removed = removeArtists(keys); break;
+                    case JournalOp::RemoveAlbum: removed = removeAlbums(keys); break;
+                    default: removed = removeAlbumsByKey(keyed); break;
+                }
+                std::copy(removed.begin(), removed.end(), changed.begin() + static_cast<std::ptrdiff_t>(i));
+                i = end;
+            }
+            return changed;
+        }
+
+        /**
+         * @brief Applies a replayed journal entry without logging it again.
+         */
+        bool apply(const JournalEntry& entry) {
+            Journal* attached = journal;
+            journal = nullptr;
+            bool changed = change(entry);
+            journal = attached;
+            return changed;
+        }
+
+        /**
+         * @brief Applies replayed journal entries with `changeAll`, without logging them again.
+         * Returns, per entry, whether it changed anything.
+         */
+        std::vector<bool> applyAll(const std::vector<JournalEntry>& entries) {
+            Journal* attached = journal;
+            journal = nullptr;
+            std::vector<bool> changed = changeAll(entries);
+            journal = attached;
+            return changed;
+        }
+
+    private:
+        /**
+         * @brief A text search through the query cache; `run` computes the rows on a miss.
+         */
+        template <typename Run>
+        std::vector<std::size_t> search(char kind, std::uint64_t generation, std::string_view query, TextMatch match,
+                                        std::size_t limit, Run run) const {
+            ScopedTimer timer(Metric::TextSearch);
+            std::vector<std::size_t> rows;
+            const std::string key = QueryKey(kind).add(static_cast<std::uint64_t>(match)).add(static_cast<std::uint64_t>(limit)).add(query).str();
+            if (queryCache.find(key, generation, rows)) {
+                timer.rows(0, rows.size());
+                return rows;
+            }
+            rows = run();
+            timer.rows(rows.size(), rows.size());
+            queryCache.store(key, generation, rows);
+            return rows;
+        }
+
+        /**
+         * @brief Logs one removal per name or key that removed something, as if they were made one by one.
+         */
+        void logRemovals(JournalOp op, const std::vector<std::string>& names, const std::vector<bool>& matched) {
+            if (journal == nullptr) {
+                return;
+            }
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                if (matched[i]) {
+                    JournalEntry entry;
+                    entry.op = op;
+                    entry.key = names[i];
+                    journal->append(entry);
+                }
+            }
+        }
+
+        template <std::size_t N>
+        void logRemovals(JournalOp op, const std::vector<std::array<std::string, N>>& keys, const std::vector<bool>& matched) {
+            if (journal == nullptr) {
+                return;
+            }
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                if (matched[i]) {
+                    JournalEntry entry;
+                    entry.op = op;
+                    entry.key = keys[i][0];
+                    if constexpr (N > 1) {
+                        entry.keyArtist = keys[i][1];
+                    }
+                    journal->append(entry);
+                }
+            }
+        }
+
+        template <typename T>
+        void logRecord(JournalOp op, const T& record) {
+            if (journal != nullptr) {
+                JournalEntry entry;
+                entry.op = op;
+                JournalOpsOf<T>::record(entry) = record;
+                journal->append(entry);
+            }
+        }
+
+        /**
+         * @brief The records of type `T` of `library`, and their primary key and text indexes.
+         */
+        template <typename T, typename Self>
+        static auto& recordsOf(Self& library) {
+            if constexpr (std::is_same_v<T, Song>) {
+                return library.songs;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return library.artists;
+            } else {
+                return library.albums;
+            }
+        }
+
+        template <typename T, typename Self>
+        static auto& keysOf(Self& library) {
+            if constexpr (std::is_same_v<T, Song>) {
+                return library.songKeys;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return library.artistKeys;
+            } else {
+                return library.albumKeys;
+            }
+        }
+
+        template <typename T, typename Self>
+        static auto& namesOf(Self& library) {
+            if constexpr (std::is_same_v<T, Song>) {
+                return library.songTitles;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return library.artistNames;
+            } else {
+                return library.albumNames;
+            }
+        }
+
+        template <typename T, typename Self>
+        static auto& removedOf(Self& library) {
+            if constexpr (std::is_same_v<T, Song>) {
+                return library.removedSongs;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return library.removedArtists;
+            } else {
+                return library.removedAlbums;
+            }
+        }
+
+        template <typename T>
+        bool needsCompaction() const {
+            return removedOf<T>(*this).count() * 8 > recordsOf<T>(*this).size();
+        }
+
+        template <typename T>
+        std::uint64_t& generationOf() {
+            if constexpr (std::is_same_v<T, Song>) {
+                return songsGeneration;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return artistsGeneration;
+            } else {
+                return albumsGeneration;
+            }
+        }
+
+        template <typename T>
+        static constexpr Metric removeMetric() {
+            if constexpr (std::is_same_v<T, Song>) {
+                return Metric::RemoveSong;
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                return Metric::RemoveArtist;
+            } else {
+                return Metric::RemoveAlbum;
+            }
+        }
+
+        /**
+         * @brief Calls `visit(index)` for every index kept over the records of type `T`: the
+         * secondary, primary key, text and range indexes, and the column store, the ranking and
+         * the aggregates once enabled. Each keeps in step with the records through four hooks:
+         *
+         * - `insert(records, row)` after a record was appended at `row`,
+         * - `replace(records, row, old)` after `old` was replaced in place by `records[row]`
+         *   (a record with the same primary key),
+         * - `remove(records, row)` after the record at `row` was removed; it stays in `records`
+         *   and keeps its row until the removed rows are erased,
+         * - `eraseRows(records, removedRows)` before a compaction erases the removed rows
+         *   (sorted) from `records`, so the rows after them can still be looked up by key.
+         *
+         * A new index is listed here, and every add, upsert and removal keeps it up to date.
+         */
+        template <typename T, typename Visit>
+        void forEachIndex(Visit visit) {
+            if constexpr (std::is_same_v<T, Song>) {
+                visit(songsByArtist);
+                visit(songsByGenre);
+                visit(songKeys);
+                visit(songTitles);
+                visit(songsByDuration);
+                visit(usedArtistNames);
+                if (columnsEnabled) {
+                    visit(songColumns);
+                }
+                if (aggregatesEnabled) {
+                    visit(aggregates);
+                }
+            } else if constexpr (std::is_same_v<T, Artist>) {
+                visit(artistKeys);
+                visit(artistNames);
+                visit(usedArtistNames);
+            } else {
+                visit(albumsByArtist);
+                visit(albumsByGenre);
+                visit(albumKeys);
+                visit(albumNames);
+                visit(albumsByYear);
+                visit(albumsByRating);
+                visit(usedArtistNames);
+                if (columnsEnabled) {
+                    visit(albumColumns);
+                }
+                if (rankingEnabled) {
+                    visit(ranking);
+                }
+                if (aggregatesEnabled) {
+                    visit(aggregates);
+                }
+            }
+        }
+
+        template <typename T>
+        bool add(T record) {
+            if (findKey<T>(recordKey<T>(record)) != noRow) {
+                return false;
+            }
+            logRecord(JournalOpsOf<T>::add, record);
+            append(std::move(record));
+            return true;
+        }
+
+        /**
+         * @brief Adds a record without logging it, e.g. for an upsert, which was logged already.
+         */
+        template <typename T>
+        void append(T record) {
+            ++generationOf<T>();
+            keepText(record);
+            auto& records = recordsOf<T>(*this);
+            records.push_back(std::move(record));
+            forEachIndex<T>([&](auto& index) { index.insert(records, records.size() - 1); });
+        }
+
+        template <typename T>
+        bool upsert(T record) {
+            ScopedTimer timer(Metric::Upsert);
+            logRecord(JournalOpsOf<T>::upsert, record);
+            auto& records = recordsOf<T>(*this);
+            const std::size_t row = findKey<T>(recordKey<T>(record));
+            if (row == noRow) {
+                append(std::move(record));
+                return false;
+            }
+            if (sameRecord(records[row], record)) {
+                timer.rows(1, 1);
+                return true;
+            }
+            ++generationOf<T>();
+            forgetText(records[row]);
+            keepText(record);
+            const T old = std::exchange(records[row], std::move(record));
+            forEachIndex<T>([&](auto& index) { index.replace(records, row, old); });
+            reclaimText();
+            timer.rows(1, 1);
+            return true;
+        }
+
+        /**
+         * @brief Row of the first record with `key`, or `noRow`.
+         */
+        template <typename T>
+        std::size_t findKey(const RecordKey<T>& key) const {
+            ScopedTimer timer(Metric::FindByKey);
+            const auto& index = keysOf<T>(*this);
+            const auto& removed = removedOf<T>(*this);
+            if (index.isBuilt() || removed.empty()) {
+                // The index holds no removed rows
+                return index.find(recordsOf<T>(*this), key);
+            }
+            for (std::size_t row : index.findAll(recordsOf<T>(*this), key)) {
+                if (!removed.contains(row)) {
+                    return row;
+                }
+            }
+            return noRow;
+        }
+
+        template <typename T>
+        std::size_t findKey(const std::array<std::string_view, keySize<T>>& key) const {
+            return findKey<T>(recordKeyOfText<T>(key));
+        }
+
+        /**
+         * @brief Removes the records with the primary keys, found through the primary key index
+         * when it is built and with one pass over the records otherwise.
+         */
+        template <typename T>
+        std::vector<bool> removeKeys(const std::vector<KeyText<T>>& keys) {
+            ScopedTimer timer(removeMetric<T>());
+            const auto& records = recordsOf<T>(*this);
+            const auto& index = keysOf<T>(*this);
+            std::vector<bool> matched(keys.size(), false);
+            std::vector<std::size_t> removed;
+            if (index.isBuilt()) {
+                removed = detail::rowsOfKeys(keys, [&](const KeyText<T>& key) { return index.findAll(records, recordKeyOfText<T>(key)); },
+                                             matched);
+                timer.rows(removed.size(), 0);
+            } else {
+                std::vector<RecordKey<T>> values;
+                values.reserve(keys.size());
+                for (const auto& key : keys) {
+                    values.push_back(recordKeyOfText<T>(key));
+                }
+                timer.rows(records.size(), 0);
+                removed = detail::rowsWithKeys(records, removedOf<T>(*this), values, [](const T& record) { return recordKey<T>(record); },
+                                               matched, RecordKeyHash<T>());
+            }
+            markRemoved<T>(removed);
+            logRemovals(JournalOpsOf<T>::removeByKey, keys, matched);
+            timer.rows(0, removed.size());
+            return matched;
+        }
+
+        /**
+         * @brief Removes the songs or albums with the titles or names, whatever their artist,
+         * found through the text index when it is built and with one pass over the records otherwise.
+         */
+        template <typename T>
+        std::vector<bool> removeNamed(const std::vector<std::string>& names) {
+            ScopedTimer timer(removeMetric<T>());
+            const auto& records = recordsOf<T>(*this);
+            const auto& index = namesOf<T>(*this);
+            std::vector<bool> matched(names.size(), false);
+            std::vector<std::size_t> removed;
+            if (index.isBuilt()) {
+                removed = detail::rowsOfKeys(names, [&](const std::string& name) { return index.exact(records, name); }, matched);
+                timer.rows(removed.size(), 0);
+            } else {
+                timer.rows(records.size(), 0);
+                removed = detail::rowsWithKeys(records, removedOf<T>(*this), std::vector<std::string_view>(names.begin(), names.end()),
+                                               [](const T& record) { return textOf(record); }, matched);
+            }
+            markRemoved<T>(removed);
+            logRemovals(JournalOpsOf<T>::remove, names, matched);
+            timer.rows(0, removed.size());
+            return matched;
+        }
+
+        /**
+         * @brief Marks the rows (sorted) of the records of type `T` as removed and takes them out
+         * of the indexes, then compacts the collection if that is due and `autoCompact` is on.
+         */
+        template <typename T>
+        void markRemoved(const std::vector<std::size_t>& rows) {
+            if (rows.empty()) {
+                return;
+            }
+            ++generationOf<T>();
+            auto& records = recordsOf<T>(*this);
+            auto& removed = removedOf<T>(*this);
+            for (std::size_t row : rows) {
+                removed.add(row);
+                forgetText(records[row]);
+                forEachIndex<T>([&](auto& index) { index.remove(records, row); });
+            }
+            if (autoCompact && needsCompaction<T>()) {
+                eraseRemoved<T>();
+            }
+        }
+
+        /**
+         * @brief Erases the removed records of type `T` and renumbers the rows of every index,
+         * in one pass over each.
+         */
+        template <typename T>
+        void eraseRemoved() {
+            auto& removed = removedOf<T>(*this);
+            if (removed.empty()) {
+                return;
+            }
+            const std::vector<std::size_t> rows = removed.rows();
+            ++generationOf<T>();
+            auto& records = recordsOf<T>(*this);
+            forEachIndex<T>([&](auto& index) { index.eraseRows(records, rows); });
+            detail::eraseColumnRows(records, rows);
+            removed.clear();
+            reclaimText();
+        }
+
+        /**
+         * @brief Copies the text of a record that joins the library into the library's arena;
+         * the record may have been parsed into a scratch arena that is about to be cleared.
+         */
+        template <typename T>
+        void keepText(T& record) {
+            if constexpr (!std::is_same_v<T, Artist>) {
+                record.storeTextIn(*text);
+                liveTextBytes += textOf(record).size();
+            }
+        }
+
+        template <typename T>
+        void forgetText(const T& record) {
+            if constexpr (!std::is_same_v<T, Artist>) {
+                liveTextBytes -= textOf(record).size();
+            }
+        }
+
+        static std::string_view textOf(const Song& song) { return song.getTitle(); }
+        static std::string_view textOf(const Album& album) { return album.getName(); }
+
+        /**
+         * @brief Moves the text to a new arena once more than half of the old one is taken by
+         * removed and replaced records. The copies sharing the old arena keep it alive.
+         */
+        void reclaimText() {
+            if (text->reservedBytes() <= 2 * liveTextBytes + TextArena::blockSize) {
+                return;
+            }
+            auto compact = std::make_shared<TextArena>();
+            storeAllText(*compact);
+            text = std::move(compact);
+        }
+
+        void storeAllText(TextArena& arena) {
+            for (auto& song : songs) {
+                song.storeTextIn(arena);
+            }
+            for (auto& album : albums) {
+                album.storeTextIn(arena);
+            }
+        }
+
+        void rebuildIndexes() {
+            songsByArtist.build(songs);
+            songsByGenre.build(songs);
+            albumsByArtist.build(albums);
+            albumsByGenre.build(albums);
+            usedArtistNames.build(songs, artists, albums);
+        }
+
+        std::vector<Song> songs;
+        std::vector<Artist> artists;
+        std::vector<Album> albums;
+
+        FieldIndex<Song, fieldIndex<Song>("artist")> songsByArtist;
+        FieldIndex<Song, fieldIndex<Song>("genre")> songsByGenre;
+        FieldIndex<Album, fieldIndex<Album>("artist")> albumsByArtist;
+        FieldIndex<Album, fieldIndex<Album>("genre")> albumsByGenre;
+
+        bool columnsEnabled = false;
+        SongColumns songColumns;
+        AlbumColumns albumColumns;
+
+        bool rankingEnabled = false;
+        AlbumRanking ranking;
+
+        TextIndex<Song> songTitles{[](const Song& song) { return song.getTitle(); }};
+        TextIndex<Album> albumNames{[](const Album& album) { return album.getName(); }};
+        TextIndex<Artist> artistNames{[](const Artist& artist) -> std::string_view { return artist.getName(); }};
+        ArtistNameIndex usedArtistNames;
+
+        PrimaryKeyIndex<Song> songKeys;
+        PrimaryKeyIndex<Artist> artistKeys;
+        PrimaryKeyIndex<Album> albumKeys;
+
+        // Rows of removed records, erased by the next compaction
+        RemovedRows removedSongs;
+        RemovedRows removedArtists;
+        RemovedRows removedAlbums;
+        bool autoCompact = true;
+
+        RangeIndex<Song, double> songsByDuration{[](const Song& song) { return song.getDuration(); }};
+        RangeIndex<Album, int> albumsByYear{[](const Album& album) { return album.getYear(); }};
+        RangeIndex<Album, double> albumsByRating{[](const Album& album) { return album.getRating(); }};
+
+        bool aggregatesEnabled = false;
+        Aggregates aggregates;
+
+        // Bumped by every change to the collection, so cached results over it go stale
+        std::uint64_t songsGeneration = 0;
+        std::uint64_t artistsGeneration = 0;
+        std::uint64_t albumsGeneration = 0;
+        mutable QueryCache queryCache;
+
+        std::shared_ptr<TextArena> text = std::make_shared<TextArena>();
+        std::size_t liveTextBytes = 0;   // text of the records, the rest of the arena is garbage
+
+        Journal* journal = nullptr;
+    };
+}
+
+#endif
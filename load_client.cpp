@@ -0,0 +1,285 @@
+/**
+ * @file load_client.cpp
+ * @brief Load generator for the server mode (`music_library --serve <socket>`, see `server.h`).
+ *
+ * Opens one connection per reader and per writer and keeps them busy for a fixed time.
+ * Readers send a mix of lookups (by artist, title search, genre statistics, top 10 albums)
+ * drawn with a fixed seed from the database files; writers alternately add and remove a
+ * song. At the end it prints the throughput and latency percentiles of reads and writes as
+ * JSON, so runs with more readers show how reads scale while writers are active.
+ *
+ * The writers change the library the server serves, and the server journals their changes.
+ * Each one removes the song it added last before it disconnects, so the library ends up with
+ * the songs it had, but a client killed half way can leave a `load test` song behind.
+ *
+ * Usage: `load_client [--socket PATH] [--data DIR] [--readers N] [--writers N] [--seconds N] [--output FILE]`
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "database_io.h"
+#include "thread_pool.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string socketPath = "music_library.sock";
+        std::filesystem::path dataDir = ".";
+        std::size_t readers = rc::defaultThreadCount();
+        std::size_t writers = 1;
+        std::size_t seconds = 5;
+        std::string output;
+    };
+
+    /**
+     * @brief Latencies of the requests one client made, in microseconds.
+     */
+    struct ClientResult {
+        std::vector<double> micros;
+        std::size_t errors = 0;
+        bool connected = false;
+    };
+
+    /**
+     * @brief One connection speaking the line protocol: a command out, lines back up to an empty line.
+     */
+    class Connection {
+    public:
+        ~Connection() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        bool open(const std::string& path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) {
+                return false;
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            return fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        }
+
+        /**
+         * @brief Sends `command` and reads the whole response; counts `Error - ` lines in `errors`.
+         */
+        bool request(const std::string& command, std::size_t& errors) {
+            std::string line = command + '\n';
+            for (std::size_t sent = 0; sent < line.size();) {
+                ssize_t n = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    return false;
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+            for (;;) {
+                std::size_t end = buffer.find('\n', start);
+                if (end == std::string::npos) {
+                    buffer.erase(0, start);
+                    start = 0;
+                    char block[1 << 16];
+                    ssize_t got = ::recv(fd, block, sizeof(block), 0);
+                    if (got <= 0) {
+                        return false;
+                    }
+                    buffer.append(block, static_cast<std::size_t>(got));
+                    continue;
+                }
+                bool last = end == start;
+                if (buffer.compare(start, 8, "Error - ") == 0) {
+                    ++errors;
+                }
+                start = end + 1;
+                if (last) {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        int fd = -1;
+        std::string buffer;
+        std::size_t start = 0;
+    };
+
+    double percentile(std::vector<double>& values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+        return values[index];
+    }
+
+    /**
+     * @brief Sends requests made by `next(random)` until `deadline`, then the one `last()`
+     * makes, if it is not empty, without timing it.
+     */
+    template <typename Next, typename Last>
+    ClientResult runClient(const std::string& socketPath, std::uint64_t seed, Clock::time_point deadline, Next next, Last last) {
+        ClientResult result;
+        Connection connection;
+        if (!connection.open(socketPath)) {
+            return result;
+        }
+        result.connected = true;
+        std::mt19937_64 random(seed);
+        while (Clock::now() < deadline) {
+            const std::string command = next(random);
+            auto start = Clock::now();
+            if (!connection.request(command, result.errors)) {
+                ++result.errors;
+                break;
+            }
+            result.micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        const std::string command = last();
+        if (!command.empty() && !connection.request(command, result.errors)) {
+            ++result.errors;
+        }
+        return result;
+    }
+
+    void writeSummary(std::ostream& out, const char* name, std::vector<ClientResult>& results, double seconds) {
+        std::vector<double> micros;
+        std::size_t errors = 0;
+        for (ClientResult& result : results) {
+            micros.insert(micros.end(), result.micros.begin(), result.micros.end());
+            errors += result.errors;
+        }
+        out << "  \"" << name << "\": {\"clients\": " << results.size() << ", \"requests\": " << micros.size()
+            << ", \"per_second\": " << static_cast<double>(micros.size()) / seconds
+            << ", \"p50_us\": " << percentile(micros, 0.50) << ", \"p99_us\": " << percentile(micros, 0.99)
+            << ", \"max_us\": " << percentile(micros, 1.0) << ", \"errors\": " << errors << "}";
+    }
+
+    bool parseCount(const char* text, std::size_t& value) {
+        char* end = nullptr;
+        unsigned long long parsed = std::strtoull(text, &end, 10);
+        value = static_cast<std::size_t>(parsed);
+        return end != text && *end == '\0';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error - missing value for " << option << std::endl;
+            return 1;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (option == "--socket") {
+            options.socketPath = value;
+        } else if (option == "--data") {
+            options.dataDir = value;
+        } else if (option == "--readers") {
+            ok = parseCount(value, options.readers);
+        } else if (option == "--writers") {
+            ok = parseCount(value, options.writers);
+        } else if (option == "--seconds") {
+            ok = parseCount(value, options.seconds) && options.seconds > 0;
+        } else if (option == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--socket PATH] [--data DIR] [--readers N] [--writers N]"
+                      << " [--seconds N] [--output FILE]" << std::endl;
+            std::cerr << "Warning - the writers add and remove songs in the library the server serves." << std::endl;
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Error - invalid value for " << option << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    // Query keys come from the same files the server loaded
+    std::vector<rc::Song> songs;
+    std::vector<rc::Album> albums;
+    {
+        rc::ThreadPool pool;
+        if (!rc::loadSongsFromFile(songs, (options.dataDir / "music_database.txt").string(), pool).opened ||
+            !rc::loadAlbumsFromFile(albums, (options.dataDir / "album_database.txt").string(), pool).opened || songs.empty()) {
+            std::cerr << "Error - cannot open the database files in " << options.dataDir.string() << "!" << std::endl;
+            return 1;
+        }
+    }
+    auto read = [&songs](std::mt19937_64& random) {
+        const rc::Song& song = songs[std::uniform_int_distribution<std::size_t>(0, songs.size() - 1)(random)];
+        switch (random() % 4) {
+            case 0: return "by-artist " + song.getArtist();
+            case 1: return "search " + std::string(song.getTitle().substr(song.getTitle().size() / 3, 4));
+            case 2: return "stats genre " + song.getGenre();
+            default: return std::string("rank 10");
+        }
+    };
+
+    const auto deadline = Clock::now() + std::chrono::seconds(options.seconds);
+    std::vector<ClientResult> readers(options.readers);
+    std::vector<ClientResult> writers(options.writers);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < options.readers; ++i) {
+        threads.emplace_back([&, i] {
+            readers[i] = runClient(options.socketPath, i + 1, deadline, read, [] { return std::string(); });
+        });
+    }
+    for (std::size_t i = 0; i < options.writers; ++i) {
+        threads.emplace_back([&, i] {
+            // Every song added is removed by the next request, or after the deadline when the
+            // last request was an add, so the library keeps its size
+            std::size_t count = 0;
+            auto write = [i, &count] {
+                const std::string title = "load test " + std::to_string(i) + "-" + std::to_string(count / 2);
+                return count++ % 2 == 0 ? "add-song " + title + ";3.5;Load Test;Load Test" : "remove-song " + title + ";Load Test";
+            };
+            writers[i] = runClient(options.socketPath, 1000 + i, deadline, [&write](std::mt19937_64&) { return write(); },
+                                   [&write, &count] { return count % 2 == 1 ? write() : std::string(); });
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto* group : {&readers, &writers}) {
+        for (const ClientResult& result : *group) {
+            if (!result.connected) {
+                std::cerr << "Error - cannot connect to " << options.socketPath << "!" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file.is_open()) {
+            std::cerr << "Error - cannot open the file!" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    const double seconds = static_cast<double>(options.seconds);
+    out << "{\n  \"seconds\": " << options.seconds << ",\n";
+    writeSummary(out, "reads", readers, seconds);
+    out << ",\n";
+    writeSummary(out, "writes", writers, seconds);
+    out << "\n}\n";
+    return 0;
+}
@@ -0,0 +1,420 @@
+/**
+ * @file loader.h
+ * @brief Parsers for the `;`-delimited database files working directly on a memory-mapped buffer.
+ * Fields are located with a vectorized byte scan, numbers are parsed with `std::from_chars`,
+ * and records are built straight from views into the buffer. Malformed lines are collected
+ * in a `LoadReport` instead of aborting the load. Large files can be split at line boundaries
+ * and parsed chunk by chunk on a `ThreadPool`.
+ */
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "record_schema.h"
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RC_HAVE_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rc {
+    /**
+     * @brief A line that could not be turned into a record.
+     */
+    struct LoadError {
+        std::size_t line;      // 1-based line number in the file
+        std::string message;
+    };
+
+    /**
+     * @brief Result of parsing one database file.
+     */
+    struct LoadReport {
+        std::size_t loaded = 0;
+        std::size_t lines = 0;     // lines read, including blank and skipped ones
+        std::vector<LoadError> errors;
+    };
+
+    namespace detail {
+        inline unsigned countTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        /**
+         * @brief Returns the first `;` or newline in [p, end), or `end` if there is none.
+         *
+         * Checks 16 bytes per step with SSE2 where available.
+         */
+        inline const char* findFieldEnd(const char* p, const char* end) {
+#ifdef RC_HAVE_SSE2
+            const __m128i semicolon = _mm_set1_epi8(';');
+            const __m128i newline = _mm_set1_epi8('\n');
+            while (end - p >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, semicolon), _mm_cmpeq_epi8(chunk, newline));
+                unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+                if (mask != 0) {
+                    return p + countTrailingZeros(mask);
+                }
+                p += 16;
+            }
+#endif
+            while (p < end && *p != ';' && *p != '\n') {
+                ++p;
+            }
+            return p;
+        }
+
+        /**
+         * @brief Returns the first newline in [p, end), or `end` if there is none.
+         */
+        inline const char* findLineEnd(const char* p, const char* end) {
+            const void* hit = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+            return hit != nullptr ? static_cast<const char*>(hit) : end;
+        }
+
+        inline std::string_view trimSpaces(std::string_view text) {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+                text.remove_prefix(1);
+            }
+            while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+                text.remove_suffix(1);
+            }
+            return text;
+        }
+
+        template <typename T>
+        bool parseNumber(std::string_view text, T& value) {
+            text = trimSpaces(text);
+            const char* first = text.data();
+            const char* last = first + text.size();
+            auto result = std::from_chars(first, last, value);
+            return result.ec == std::errc() && result.ptr == last && first != last;
+        }
+
+        /**
+         * @brief Splits one line (without its newline) into exactly `N` fields.
+         *
+         * The last field takes the rest of the line, so it may itself contain `;`,
+         * which matches how the text files have always been read.
+         */
+        template <std::size_t N>
+        bool splitFields(const char* p, const char* eol, std::string_view (&fields)[N]) {
+            for (std::size_t i = 0; i + 1 < N; ++i) {
+                const char* q = findFieldEnd(p, eol);
+                if (q == eol) {
+                    return false;
+                }
+                fields[i] = std::string_view(p, static_cast<std::size_t>(q - p));
+                p = q + 1;
+            }
+            fields[N - 1] = std::string_view(p, static_cast<std::size_t>(eol - p));
+            return true;
+        }
+
+        /**
+         * @brief Walks every non-empty line of `data` and hands its fields to `build`.
+         *
+         * `build` returns an error message for a malformed record, or nullptr on success.
+         * Trailing carriage returns are stripped so files saved on Windows load the same way.
+         */
+        template <std::size_t N, typename Build>
+        LoadReport parseLines(std::string_view data, Build build) {
+            LoadReport report;
+            const char* p = data.data();
+            const char* end = p + data.size();
+            std::size_t line = 0;
+            std::string_view fields[N];
+            while (p < end) {
+                ++line;
+                const char* eol = findLineEnd(p, end);
+                const char* next = eol == end ? end : eol + 1;
+                const char* contentEnd = eol;
+                if (contentEnd > p && contentEnd[-1] == '\r') {
+                    --contentEnd;
+                }
+                if (contentEnd == p) {
+                    p = next;
+                    continue;
+                }
+                if (!splitFields(p, contentEnd, fields)) {
+                    report.errors.push_back({line, "expected " + std::to_string(N) + " fields"});
+                } else if (const char* error = build(fields)) {
+                    report.errors.push_back({line, error});
+                } else {
+                    ++report.loaded;
+                }
+                p = next;
+            }
+            report.lines = line;
+            return report;
+        }
+
+        inline std::size_t estimateLines(std::string_view data) {
+            return static_cast<std::size_t>(std::count(data.begin(), data.end(), '\n')) + 1;
+        }
+
+        /**
+         * @brief Parser-local front of a `StringDictionary`.
+         *
+         * Genres, countries and artist names repeat on many lines; remembering the IDs already
+         * seen in this buffer keeps most lookups off the dictionary's shared lock, which the
+         * chunks parsed in parallel would otherwise all contend on. Keys are views into the
+         * parsed buffer, so a cache must not outlive it.
+         */
+        class InternCache {
+        public:
+            explicit InternCache(StringDictionary& dictionary) : dictionary(dictionary) {}
+
+            StringId intern(std::string_view text) {
+                auto it = ids.find(text);
+                if (it != ids.end()) {
+                    return it->second;
+                }
+                StringId id = dictionary.intern(text);
+                ids.emplace(text, id);
+                return id;
+            }
+
+        private:
+            StringDictionary& dictionary;
+            std::unordered_map<std::string_view, StringId> ids;
+        };
+
+        /**
+         * @brief Turns the text of one field into its value, as the schema describes it.
+         */
+        template <typename Field, FieldKind Kind = Field::kind>
+        class FieldParser;
+
+        template <typename Field>
+        class FieldParser<Field, FieldKind::Text> {
+        public:
+            explicit FieldParser(const Field&) {}
+
+            const char* parse(std::string_view text, std::string_view& value) {
+                value = text;
+                return nullptr;
+            }
+        };
+
+        template <typename Field>
+        class FieldParser<Field, FieldKind::Number> {
+        public:
+            explicit FieldParser(const Field& field) : invalid(field.invalid) {}
+
+            const char* parse(std::string_view text, typename Field::Value& value) {
+                return parseNumber(text, value) ? nullptr : invalid;
+            }
+
+        private:
+            const char* invalid;
+        };
+
+        template <typename Field>
+        class FieldParser<Field, FieldKind::Name> {
+        public:
+            explicit FieldParser(const Field& field)
+                : dictionary(field.dictionary()), repeats(field.repeats), cache(dictionary) {}
+
+            const char* parse(std::string_view text, StringId& value) {
+                value = repeats ? cache.intern(text) : dictionary.intern(text);
+                return nullptr;
+            }
+
+        private:
+            StringDictionary& dictionary;
+            bool repeats;
+            InternCache cache;
+        };
+
+        /**
+         * @brief Parses the fields of one `T` line with a `FieldParser` per field. Keeps the
+         * intern caches of the name fields, so it must not outlive the buffer it parses.
+         */
+        template <typename T>
+        class RecordParser {
+        public:
+            static constexpr std::size_t fields = fieldCount<T>;
+
+            RecordParser() : parsers(makeParsers(std::make_index_sequence<fields>())) {}
+
+            /**
+             * @brief Calls `visit(values...)` with the values of the record, in constructor
+             * order. Returns the error of the first field that does not parse, or nullptr.
+             */
+            template <typename Visit>
+            const char* parse(const std::string_view (&text)[fields], Visit&& visit) {
+                return parse(text, visit, std::make_index_sequence<fields>());
+            }
+
+        private:
+            template <std::size_t... I>
+            static auto makeParsers(std::index_sequence<I...>) {
+                constexpr auto schema = RecordSchema<T>::fields();
+                return std::tuple<FieldParser<FieldAt<T, I>>...>(FieldParser<FieldAt<T, I>>(std::get<I>(schema))...);
+            }
+
+            template <typename Visit, std::size_t... I>
+            const char* parse(const std::string_view (&text)[fields], Visit& visit, std::index_sequence<I...>) {
+                RecordValues<T> values;
+                const char* error = nullptr;
+                (((error = std::get<I>(parsers).parse(text[I], std::get<I>(values))) == nullptr) && ...);
+                if (error != nullptr) {
+                    return error;
+                }
+                visit(std::get<I>(values)...);
+                return nullptr;
+            }
+
+            decltype(makeParsers(std::make_index_sequence<fields>())) parsers;
+        };
+
+        /**
+         * @brief Cuts `data` into pieces of roughly `data.size() / pieces` bytes (at least
+         * `minBytes`), each ending right after a newline or at the end of the buffer.
+         */
+        inline std::vector<std::string_view> splitChunks(std::string_view data, std::size_t pieces, std::size_t minBytes) {
+            std::vector<std::string_view> chunks;
+            std::size_t target = std::max(minBytes, data.size() / std::max<std::size_t>(pieces, 1));
+            std::size_t start = 0;
+            while (start < data.size()) {
+                std::size_t end = data.size();
+                if (data.size() - start > target) {
+                    std::size_t newline = data.find('\n', start + target);
+                    end = newline == std::string_view::npos ? data.size() : newline + 1;
+                }
+                chunks.push_back(data.substr(start, end - start));
+                start = end;
+            }
+            return chunks;
+        }
+
+        /**
+         * @brief Runs `parse` over line-aligned chunks of `data` on `pool` and appends the
+         * records to `out` in file order. Error line numbers are made relative to the whole file.
+         */
+        template <typename T, typename Parse>
+        LoadReport parseChunked(std::string_view data, std::vector<T>& out, ThreadPool& pool, Parse parse) {
+            constexpr std::size_t minChunkBytes = 1 << 20;
+            std::vector<std::string_view> chunks = splitChunks(data, pool.size() * 4, minChunkBytes);
+            if (chunks.size() <= 1 || pool.size() <= 1) {
+                return parse(data, out);
+            }
+            std::vector<std::vector<T>> parts(chunks.size());
+            std::vector<std::future<LoadReport>> pending;
+            pending.reserve(chunks.size());
+            for (std::size_t i = 0; i < chunks.size(); ++i) {
+                pending.push_back(pool.submit([&parse, &parts, chunk = chunks[i], i] { return parse(chunk, parts[i]); }));
+            }
+            // The tasks write into `parts`, so every one must be finished before anything can throw
+            for (auto& future : pending) {
+                future.wait();
+            }
+            std::size_t total = out.size();
+            for (const auto& part : parts) {
+                total += part.size();
+            }
+            out.reserve(total);
+            LoadReport report;
+            for (std::size_t i = 0; i < chunks.size(); ++i) {
+                LoadReport part = pending[i].get();
+                for (auto& error : part.errors) {
+                    error.line += report.lines;
+                    report.errors.push_back(std::move(error));
+                }
+                report.loaded += part.loaded;
+                report.lines += part.lines;
+                std::move(parts[i].begin(), parts[i].end(), std::back_inserter(out));
+                std::vector<T>().swap(parts[i]);
+            }
+            return report;
+        }
+    }
+
+    /**
+     * @brief Parses the lines of a `T` file and calls `visit(values...)` with the values of
+     * each record, in constructor order.
+     */
+    template <typename T, typename Visit>
+    LoadReport parseRecordValues(std::string_view data, Visit visit) {
+        detail::RecordParser<T> parser;
+        return detail::parseLines<fieldCount<T>>(data, [&](const std::string_view (&fields)[fieldCount<T>]) -> const char* {
+            return parser.parse(fields, visit);
+        });
+    }
+
+    /**
+     * @brief Parses the lines of a `T` file and appends the records to `records`.
+     */
+    template <typename T>
+    LoadReport parseRecords(std::string_view data, std::vector<T>& records) {
+        records.reserve(records.size() + detail::estimateLines(data));
+        return parseRecordValues<T>(data, [&](const auto&... values) { records.emplace_back(values...); });
+    }
+
+    template <typename T>
+    LoadReport parseRecords(std::string_view data, std::vector<T>& records, ThreadPool& pool) {
+        return detail::parseChunked(data, records, pool, [](std::string_view chunk, std::vector<T>& part) { return parseRecords(chunk, part); });
+    }
+
+    /**
+     * @brief Parses `title;duration;genre;artist` lines and appends the songs to `songs`.
+     */
+    inline LoadReport parseSongs(std::string_view data, std::vector<Song>& songs) {
+        return parseRecords(data, songs);
+    }
+
+    inline LoadReport parseSongs(std::string_view data, std::vector<Song>& songs, ThreadPool& pool) {
+        return parseRecords(data, songs, pool);
+    }
+
+    /**
+     * @brief Parses `name;country;genre` lines and appends the artists to `artists`.
+     */
+    inline LoadReport parseArtists(std::string_view data, std::vector<Artist>& artists) {
+        return parseRecords(data, artists);
+    }
+
+    inline LoadReport parseArtists(std::string_view data, std::vector<Artist>& artists, ThreadPool& pool) {
+        return parseRecords(data, artists, pool);
+    }
+
+    /**
+     * @brief Parses `name;artist;year;rating;genre` lines and appends the albums to `albums`.
+     */
+    inline LoadReport parseAlbums(std::string_view data, std::vector<Album>& albums) {
+        return parseRecords(data, albums);
+    }
+
+    inline LoadReport parseAlbums(std::string_view data, std::vector<Album>& albums, ThreadPool& pool) {
+        return parseRecords(data, albums, pool);
+    }
+}
+
+#endif
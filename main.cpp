@@ -1,510 +1,1074 @@
-/**
- * @brief Includes essential headers and dependencies for the program.
- * 
- * - `<iostream>`: Provides input and output functionality.
- * - `<vector>`: Used for managing collections of songs, artists, and albums.
- * - `<string>`: Facilitates string handling for names, genres, and other text data.
- * - `<fstream>`: Supports file input and output operations.
- * - `<algorithm>`: Used for operations like searching and removing elements from collections.
- * - `"song.h"`: Declares the `Song` class and its associated methods.
- * - `"artist.h"`: Declares the `Artist` class and its associated methods.
- * - `"album.h"`: Declares the `Album` class and its associated methods.
- */
-#include <iostream>
-#include <vector>
-#include <string>
-#include <fstream>
-#include <algorithm>
-#include "song.h"
-#include "artist.h"
-#include "album.h"
-
-
-
-namespace rc {
-/**
- * @brief Saves a collection of objects to a file.
- * 
- * This function saves the details of objects (such as songs, artists, or albums)
- * to a specified file. It iterates over the collection 
- * of objects and writes each object's properties to the file.
- * 
- * Supported object types:
- * - Songs: title, duration, genre, artist
- * - Artists: name, country, genre
- * - Albums: name, artist, year, rating, genre
- * 
- */
-    void saveSongsToFile(const std::vector<Song>& songs, const std::string& filename) {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            for (const auto& song : songs) {
-                file << song.getTitle() << ";"
-                     << song.getDuration() << ";"
-                     << song.getGenre() << ";"
-                     << song.getArtist() << std::endl;
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-    void saveArtistsToFile(const std::vector<Artist>& artists, const std::string& filename) {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            for (const auto& artist : artists) {
-                file << artist.getName() << ";"
-                     << artist.getCountry() << ";"
-                     << artist.getGenre() << std::endl;
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-    void saveAlbumsToFile(const std::vector<Album>& albums, const std::string& filename) {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            for (const auto& album : albums) {
-                file << album.getName() << ";"
-                     << album.getArtist() << ";"
-                     << album.getYear() << ";"
-                     << album.getRating() << ";"
-                     << album.getGenre() << std::endl;
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-
-
-
-/**
- * @brief Loads a collection of objects from a file.
- * 
- * This function reads data from a file and populates a vector 
- * with objects (such as songs, artists, or albums). The function parses each line, 
- * extracts the relevant properties, and creates objects to store in the vector.
- * 
- * Supported object types:
- * - Songs: title, duration, genre, artist
- * - Artists: name, country, genre
- * - Albums: name, artist, year, rating, genre
- * 
- */
-    void loadSongsFromFile(std::vector<Song>& songs, const std::string& filename) {
-        std::ifstream file(filename);
-        if (file.is_open()) {
-            std::string title, genre, artist, durationStr;
-            while (std::getline(file, title, ';') &&
-                   std::getline(file, durationStr, ';') &&
-                   std::getline(file, genre, ';') &&
-                   std::getline(file, artist)) {
-                double duration = std::stod(durationStr);
-                songs.emplace_back(title, duration, genre, artist);
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-
-    void loadArtistsFromFile(std::vector<Artist>& artists, const std::string& filename) {
-        std::ifstream file(filename);
-        if (file.is_open()) {
-            std::string name, country, genre;
-            while (std::getline(file, name, ';') &&
-                   std::getline(file, country, ';') &&
-                   std::getline(file, genre)) {
-                artists.emplace_back(name, country, genre);
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-
-    void loadAlbumsFromFile(std::vector<Album>& albums, const std::string& filename) {
-        std::ifstream file(filename);
-        if (file.is_open()) {
-            std::string name, artist, yearStr, ratingStr, genre;
-            while (std::getline(file, name, ';') &&
-                   std::getline(file, artist, ';') &&
-                   std::getline(file, yearStr, ';') &&
-                   std::getline(file, ratingStr, ';') &&
-                   std::getline(file, genre)) {
-                int year = std::stoi(yearStr);
-                double rating = std::stod(ratingStr);
-                albums.emplace_back(name, artist, year, rating, genre);
-            }
-            file.close();
-        } else {
-            std::cerr << "Error - cannot open the file!" << std::endl;
-        }
-    }
-
-
-
-/**
- * @brief Removes an object from a collection.
- * 
- * This function removes an object (such as a song, artist, or album) from a vector
- * by searching for a match to a given attribute (e.g., title, name). It uses a lambda 
- * function and `std::remove_if` to locate the object in the collection and then erases it.
- * 
- * Supported operations:
- * - Removing songs by title.
- * - Removing artists by name.
- * - Removing albums by name.
- */
-bool removeSong(std::vector<Song>& songs, const std::string& title) {
-    auto it = std::remove_if(songs.begin(), songs.end(),
-        [&title](const Song& song) { return song.getTitle() == title; });
-
-    if (it != songs.end()) {
-        songs.erase(it, songs.end());
-        return true;  
-    }
-    return false;  
-}
-
-bool removeArtist(std::vector<Artist>& artists, const std::string& name) {
-    auto it = std::remove_if(artists.begin(), artists.end(),
-        [&name](const Artist& artist) { return artist.getName() == name; });
-
-    if (it != artists.end()) {
-        artists.erase(it, artists.end());
-        return true;  
-    }
-    return false;  
-}
-
-bool removeAlbum(std::vector<Album>& albums, const std::string& name) {
-    auto it = std::remove_if(albums.begin(), albums.end(),
-        [&name](const Album& album) { return album.getName() == name; });
-
-    if (it != albums.end()) {
-        albums.erase(it, albums.end());
-        return true;  
-    }
-    return false;  
-}
-
-}
-
-
-
-/**
- * @brief Displays the main menu for the Music Library application.
- * 
- * The `displayMenu` function presents the user with a list of available options 
- * to interact with the Music Library. Users can add, display, remove, or search 
- * for songs, artists, and albums, as well as exit the program.
- * 
- *  After displaying the menu, the function waits for the user's choice.
- */
-void displayMenu() {
-    std::cout << "\n--- Music Library ---" << std::endl;
-    std::cout << "1. Add a song" << std::endl;
-    std::cout << "2. Add an artist" << std::endl;
-    std::cout << "3. Add an album" << std::endl;
-    std::cout << "4. Display songs" << std::endl;
-    std::cout << "5. Display artists" << std::endl;
-    std::cout << "6. Display albums" << std::endl;
-    std::cout << "7. Remove a song" << std::endl;
-    std::cout << "8. Remove an artist" << std::endl;
-    std::cout << "9. Remove an album" << std::endl;
-    std::cout << "10. Search by artist" << std::endl;
-    std::cout << "11. Search by genre" << std::endl;
-    std::cout << "12. Rankings" << std::endl;
-    std::cout << "13. Exit program and save changes" << std::endl;
-    std::cout << "Your choice: ";
-}
-
-
-
-int main() {
-    /**
- * @brief Initializes the application by loading songs, artists, and albums from files.
- * 
- * This section of code manages the initialization of the Music Library by:
- * - Defining three vectors to store songs, artists, and albums (`std::vector<rc::Song>`, `std::vector<rc::Artist>`, `std::vector<rc::Album>`).
- * - Specifying the filenames for storing and retrieving data
- * - Loading data from the respective files into the vectors using the provided functions:
- * 
- * This ensures that the application starts with the data previously saved to the files.
- */
-    std::vector<rc::Song> songs;
-    std::vector<rc::Artist> artists;
-    std::vector<rc::Album> albums;
-
-    const std::string songsFilename = "music_database.txt";
-    const std::string artistsFilename = "artist_database.txt";
-    const std::string albumsFilename = "album_database.txt";
-
-    rc::loadSongsFromFile(songs, songsFilename);
-    rc::loadArtistsFromFile(artists, artistsFilename);
-    rc::loadAlbumsFromFile(albums, albumsFilename);
-
-
-
-/**
- * @brief Main loop for the music library menu.
- *
- * This loop presents a menu with various options to the user for interacting with the music library. 
- * The user can add or remove songs, artists, or albums, search for songs or albums by artist or genre,
- * display the current library, and rank albums based on their ratings.
- * The loop continues running until the user selects the option to exit (choice 13).
- * 
- * @details The switch statement processes user choices and performs the corresponding action.
- * - Options 1-3 allow adding new songs, artists, and albums.
- * - Options 4-6 display the current list of songs, artists, or albums.
- * - Options 7-9 allow deleting songs, artists, and albums.
- * - Option 10 allows searching songs and albums by a specific artist.
- * - Option 11 allows searching songs and albums by a specific genre.
- * - Option 12 ranks albums by their ratings.
- * - Option 13 saves any changes made and exits the program.
- */
-int choice;
-do {
-    displayMenu();
-    std::cin >> choice;
-
-    switch (choice) {
-        case 1: {  // Add song
-            std::string title, genre, artist;
-            double duration;
-
-            std::cout << "Title of the song: ";
-            std::cin.ignore();
-            std::getline(std::cin, title);
-
-            std::cout << "Duration of the song (in minutes): ";
-            std::cin >> duration;
-
-            std::cout << "Genre of the song: ";
-            std::cin.ignore();
-            std::getline(std::cin, genre);
-
-            std::cout << "By artist: ";
-            std::getline(std::cin, artist);
-
-            songs.emplace_back(title, duration, genre, artist);
-            std::cout << "Song added!" << std::endl;
-            break;
-        }
-        case 2: {  // Add artist
-            std::string name, country, genre;
-
-            std::cout << "Enter the artist's name: ";
-            std::cin.ignore();
-            std::getline(std::cin, name);
-
-            std::cout << "Enter the artist's country: ";
-            std::getline(std::cin, country);
-
-            std::cout << "Enter the artist's genre: ";
-            std::getline(std::cin, genre);
-
-            artists.emplace_back(name, country, genre);
-            std::cout << "The artist has been added!" << std::endl;
-            break;
-        }
-        case 3: {  // Add album
-            std::string name, artist, genre;
-            int year;
-            double rating;
-
-            std::cout << "Enter the album name: ";
-            std::cin.ignore();
-            std::getline(std::cin, name);
-
-            std::cout << "Enter the album artist: ";
-            std::getline(std::cin, artist);
-
-            std::cout << "Enter the album release year: ";
-            std::cin >> year;
-
-            std::cout << "Enter the album rating (0-5): ";
-            std::cin >> rating;
-
-            std::cout << "Enter the album genre: ";
-            std::cin.ignore();
-            std::getline(std::cin, genre);
-
-            albums.emplace_back(name, artist, year, rating, genre);
-            std::cout << "The album has been added!" << std::endl;
-            break;
-        }
-        case 4: {  // Display songs
-            std::cout << "\nSongs in the database:" << std::endl;
-            for (const auto& song : songs) {
-                std::cout << song.getTitle() << " (" << song.getArtist() << "): "
-                          << song.getDuration() << " minutes, Genre: " << song.getGenre() << std::endl;
-            }
-            break;
-        }
-        case 5: {  // Display artists
-            std::cout << "\nArtists in the database:" << std::endl;
-            for (const auto& artist : artists) {
-                std::cout << artist.getName() << " (" << artist.getCountry() << ") Genre: " << artist.getGenre() << std::endl;
-            }
-            break;
-        }
-        case 6: {  // Display albums
-            std::cout << "\nAlbums in the database:" << std::endl;
-            for (const auto& album : albums) {
-                std::cout << album.getName() << " (" << album.getArtist() << ") Year: "
-                          << album.getYear() << ", Rating: " << album.getRating() << "/5, Genre: " << album.getGenre() << std::endl;
-            }
-            break;
-        }
-        case 7: {  // Delete song
-            std::string title;
-            std::cout << "Enter the title of the song to delete: ";
-            std::cin.ignore();
-            std::getline(std::cin, title);
-
-            if (rc::removeSong(songs, title)) {
-                std::cout << "The song has been deleted!" << std::endl;
-            } else {
-                std::cout << "There is no such song, please try again." << std::endl;
-            }
-            break;
-        }
-        case 8: {  // Delete artist
-            std::string name;
-            std::cout << "Enter the artist's name to delete: ";
-            std::cin.ignore();
-            std::getline(std::cin, name);
-
-            if (rc::removeArtist(artists, name)) {
-                std::cout << "The artist '" << name << "' has been deleted!" << std::endl;
-            } else {
-                std::cout << "No artist found with the name: " << name << std::endl;
-            }
-            break;
-        }
-        case 9: {  // Delete album
-            std::string name;
-            std::cout << "Enter the name of the album to delete: ";
-            std::cin.ignore();
-            std::getline(std::cin, name);
-
-            if (rc::removeAlbum(albums, name)) {
-                std::cout << "The album '" << name << "' has been deleted!" << std::endl;
-            } else {
-                std::cout << "No album found with the name: " << name << std::endl;
-            }
-            break;
-        }
-        case 10: {  // Search songs and albums by artist
-            std::string artist;
-            std::cout << "Enter the name of the artist: ";
-            std::cin.ignore();
-            std::getline(std::cin, artist);
-
-            // Display songs by the artist
-            std::cout << "\nSongs by artist " << artist << ":" << std::endl;
-            bool songsFound = false;
-            for (const auto& song : songs) {
-                if (song.getArtist() == artist) {
-                    std::cout << "- " << song.getTitle() << " (" << song.getDuration() 
-                              << " minutes, Genre: " << song.getGenre() << ")" << std::endl;
-                    songsFound = true;
-                }
-            }
-            if (!songsFound) {
-                std::cout << "No songs by this artist in the database." << std::endl;
-            }
-
-            // Display albums by the artist
-            std::cout << "\nAlbums by artist " << artist << ":" << std::endl;
-            bool albumsFound = false;
-            for (const auto& album : albums) {
-                if (album.getArtist() == artist) {
-                    std::cout << "- " << album.getName() << " (Year: " << album.getYear() 
-                              << ", Rating: " << album.getRating() << "/5, Genre: " 
-                              << album.getGenre() << ")" << std::endl;
-                    albumsFound = true;
-                }
-            }
-            if (!albumsFound) {
-                std::cout << "No albums by this artist in the database." << std::endl;
-            }
-            break;
-        }
-        case 11: {  // Search songs and albums by genre
-            std::string genre;
-            std::cout << "Enter the genre to search for: ";
-            std::cin.ignore();
-            std::getline(std::cin, genre);
-
-            // Search for songs by genre
-            std::cout << "\nSongs in the genre '" << genre << "':" << std::endl;
-            bool foundSongs = false;
-            for (const auto& song : songs) {
-                if (song.getGenre() == genre) {
-                    std::cout << "- " << song.getTitle() << " (" << song.getArtist() << "), Duration: "
-                              << song.getDuration() << " minutes" << std::endl;
-                    foundSongs = true;
-                }
-            }
-            if (!foundSongs) {
-                std::cout << "No songs found in this genre." << std::endl;
-            }
-
-            // Search for albums by genre
-            std::cout << "\nAlbums in the genre '" << genre << "':" << std::endl;
-            bool foundAlbums = false;
-            for (const auto& album : albums) {
-                if (album.getGenre() == genre) {
-                    std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: "
-                              << album.getYear() << ", Rating: " << album.getRating() << "/5" << std::endl;
-                    foundAlbums = true;
-                }
-            }
-            if (!foundAlbums) {
-                std::cout << "No albums found in this genre." << std::endl;
-            }
-            break;
-        }
-        case 12: {  // Ranking albums by rating
-            if (albums.empty()) {
-                std::cout << "No albums in the database to sort." << std::endl;
-                break;
-            }
-
-            // Create a copy of the album vector to sort it
-            std::vector<rc::Album> sortedAlbums = albums;
-
-            // Sorting using std::sort
-            std::sort(sortedAlbums.begin(), sortedAlbums.end(), [](const rc::Album& a, const rc::Album& b) {
-                return a.getRating() > b.getRating();  // Sorting in descending order by rating
-            });
-
-            // Displaying sorted albums
-            std::cout << "\nAlbum ranking by rating:" << std::endl;
-            for (const auto& album : sortedAlbums) {
-                std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: "
-                          << album.getYear() << ", Rating: " << album.getRating() << "/5, Genre: "
-                          << album.getGenre() << std::endl;
-            }
-
-            break;
-        }
-        case 13: {  // Exit the program
-            rc::saveSongsToFile(songs, songsFilename);
-            rc::saveArtistsToFile(artists, artistsFilename);
-            rc::saveAlbumsToFile(albums, albumsFilename);
-            std::cout << "Changes have been saved." << std::endl;
-            break;
-        }
-        default:
-            std::cout << "Invalid choice! Please try again." << std::endl;
-    }
-} while (choice != 13);
-
-return 0;
-}
+/**
+ * @brief Includes essential headers and dependencies for the program.
+ * 
+ * - `<iostream>`: Provides input and output functionality.
+ * - `<vector>`: Used for managing collections of songs, artists, and albums.
+ * - `<string>`: Facilitates string handling for names, genres, and other text data.
+ * - `<fstream>`: Supports file input and output operations.
+ * - `<algorithm>`: Used for operations like searching and removing elements from collections.
+ * - `<filesystem>`: Compares modification times of the snapshot and the text files.
+ * - `<future>`: Loads the three database files concurrently.
+ * - `"song.h"`: Declares the `Song` class and its associated methods.
+ * - `"artist.h"`: Declares the `Artist` class and its associated methods.
+ * - `"album.h"`: Declares the `Album` class and its associated methods.
+ * - `"database_io.h"`: Loading and saving of the database text files.
+ * - `"thread_pool.h"`: Worker threads parsing chunks of large files in parallel.
+ * - `"snapshot.h"`: Binary snapshot format used for fast startup.
+ * - `"library.h"`: Declares the `Library` class owning the collections and their indexes.
+ * - `"journal.h"`: Write-ahead log of the changes made since the text files were written.
+ * - `"join.h"`: Joins between songs, albums and artists on the artist name.
+ * - `"batch.h"`: Non-interactive command mode with buffered output.
+ * - `"server.h"`: Server mode answering many clients over a local socket.
+ * - `"aggregates.h"`: Song and album statistics per artist and per genre.
+ * - `"paged_store.h"`: Page file read through a buffer pool, for libraries larger than memory.
+ * - `"stream_scan.h"`: Filtered scans straight over the text files, without loading them.
+ * - `"metrics.h"`: Timings, row, byte and allocation counts of the library operations.
+ * - `"text_arena.h"`: Storage of the titles and names, one arena per library.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <cstdlib>
+#include <new>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "database_io.h"
+#include "thread_pool.h"
+#include "snapshot.h"
+#include "library.h"
+#include "journal.h"
+#include "join.h"
+#include "batch.h"
+#include "server.h"
+#include "aggregates.h"
+#include "paged_store.h"
+#include "stream_scan.h"
+#include "metrics.h"
+#include "text_arena.h"
+
+
+
+/**
+ * @brief Replaces the global allocation functions to count allocations for `metrics.h`;
+ * the array and nothrow forms fall back on these two.
+ */
+void* operator new(std::size_t size) {
+    rc::detail::countAllocation();
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC takes `free` in a replaced `operator delete` for a mismatch once it is inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace rc {
+/**
+ * @brief Names of the files making up the database on disk.
+ */
+    struct DatabaseFiles {
+        std::string songs;
+        std::string artists;
+        std::string albums;
+        std::string snapshot;   // empty when no snapshot is kept
+    };
+
+    std::uint64_t baseFilesSize(const DatabaseFiles& files) {
+        std::uint64_t total = 0;
+        for (const std::string* name : {&files.songs, &files.artists, &files.albums}) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(*name, ec);
+            if (!ec) {
+                total += size;
+            }
+        }
+        return total;
+    }
+
+/**
+ * @brief Replaces a file atomically.
+ * 
+ * `write` is called with a temporary file name next to `filename`; if it succeeds,
+ * the temporary file is renamed over `filename`, so readers and crashes only ever
+ * see the old or the new content.
+ */
+    template <typename Write>
+    bool replaceFile(const std::string& filename, Write write) {
+        const std::string tempName = filename + ".tmp";
+        if (!write(tempName)) {
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempName, filename, ec);
+        if (ec) {
+            std::cerr << "Error - cannot replace " << filename << ": " << ec.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+/**
+ * @brief Folds the journal back into the database files.
+ * 
+ * Only the files of collections that have journal entries are rewritten, each one
+ * through `replaceFile` and in the form (text or compressed) it already had. The
+ * snapshot, if any, is rewritten afterwards, and the journal is restarted for the new
+ * files. If the process dies half way, the journal header tells on the next start
+ * which files already contain its entries. The removed records still held by the
+ * library are erased first, so the files get the remaining ones.
+ */
+    bool compactJournal(Journal& journal, Library& library, const DatabaseFiles& files) {
+        library.compact();
+        bool ok = true;
+        if (journal.isTouched(0)) {
+            ok = replaceFile(files.songs, [&library, format = fileStorageFormat(files.songs)](const std::string& name) {
+                return saveSongsToFile(library.getSongs(), name, format);
+            }) && ok;
+        }
+        if (journal.isTouched(1)) {
+            ok = replaceFile(files.artists, [&library, format = fileStorageFormat(files.artists)](const std::string& name) {
+                return saveArtistsToFile(library.getArtists(), name, format);
+            }) && ok;
+        }
+        if (journal.isTouched(2)) {
+            ok = replaceFile(files.albums, [&library, format = fileStorageFormat(files.albums)](const std::string& name) {
+                return saveAlbumsToFile(library.getAlbums(), name, format);
+            }) && ok;
+        }
+        if (!ok) {
+            return false;
+        }
+        std::string error;
+        if (!files.snapshot.empty() &&
+            !saveSnapshot(files.snapshot, library.getSongs(), library.getArtists(), library.getAlbums(), error)) {
+            std::cerr << "Error - " << error << std::endl;
+        }
+        if (!journal.reset(error)) {
+            std::cerr << "Error - " << error << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+/**
+ * @brief Checks whether a snapshot can be used instead of the text files.
+ * 
+ * The snapshot is considered fresh when it exists and is not older than any of
+ * the text files, so edits made to the text files by hand are never hidden by it.
+ */
+    bool isSnapshotFresh(const std::string& snapshotFilename, std::initializer_list<std::string> sources) {
+        std::error_code ec;
+        auto snapshotTime = std::filesystem::last_write_time(snapshotFilename, ec);
+        if (ec) {
+            return false;
+        }
+        for (const auto& source : sources) {
+            auto sourceTime = std::filesystem::last_write_time(source, ec);
+            if (!ec && sourceTime > snapshotTime) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+/**
+ * @brief Writes the operation metrics as JSON to `filename` (if set) when it goes out of
+ * scope, so every way out of `main` leaves a dump behind.
+ */
+    struct MetricsDump {
+        std::string filename;
+
+        ~MetricsDump() {
+            if (filename.empty()) {
+                return;
+            }
+            std::ofstream file(filename);
+            if (!file.is_open()) {
+                std::cerr << "Error - cannot open the file!" << std::endl;
+                return;
+            }
+            writeMetricsJson(file, metrics().snapshot());
+        }
+    };
+
+}
+
+
+
+/**
+ * @brief Displays the main menu for the Music Library application.
+ * 
+ * The `displayMenu` function presents the user with a list of available options 
+ * to interact with the Music Library. Users can add, display, remove, or search 
+ * for songs, artists, and albums, as well as exit the program.
+ * 
+ *  After displaying the menu, the function waits for the user's choice.
+ */
+void displayMenu() {
+    std::cout << "\n--- Music Library ---" << std::endl;
+    std::cout << "1. Add a song" << std::endl;
+    std::cout << "2. Add an artist" << std::endl;
+    std::cout << "3. Add an album" << std::endl;
+    std::cout << "4. Display songs" << std::endl;
+    std::cout << "5. Display artists" << std::endl;
+    std::cout << "6. Display albums" << std::endl;
+    std::cout << "7. Remove a song" << std::endl;
+    std::cout << "8. Remove an artist" << std::endl;
+    std::cout << "9. Remove an album" << std::endl;
+    std::cout << "10. Search by artist" << std::endl;
+    std::cout << "11. Search by genre" << std::endl;
+    std::cout << "12. Rankings" << std::endl;
+    std::cout << "13. Exit program and save changes" << std::endl;
+    std::cout << "14. Filter songs" << std::endl;
+    std::cout << "15. Filter albums" << std::endl;
+    std::cout << "16. Songs by matching artists" << std::endl;
+    std::cout << "17. Album ratings by artist country" << std::endl;
+    std::cout << "18. Search titles and names" << std::endl;
+    std::cout << "19. Statistics by artist or genre" << std::endl;
+    std::cout << "20. Performance statistics" << std::endl;
+    std::cout << "Your choice: ";
+}
+
+
+
+int main(int argc, char* argv[]) {
+    /**
+ * @brief Initializes the application by loading songs, artists, and albums from files.
+ * 
+ * This section of code manages the initialization of the Music Library by:
+ * - Defining three vectors to store songs, artists, and albums (`std::vector<rc::Song>`, `std::vector<rc::Artist>`, `std::vector<rc::Album>`).
+ * - Specifying the filenames for storing and retrieving data
+ * - Reading the command line options:
+ *   - `--snapshot <file>`: start from a binary snapshot (see `snapshot.h`) when it is newer
+ *     than the text files; it is rewritten whenever the text files are.
+ *   - `--export-snapshot <file>`: convert the text files into a snapshot and exit.
+ *   - `--import-snapshot <file>`: convert a snapshot back into the database files and exit.
+ *   - `--compress` / `--decompress`: rewrite the three database files in the compressed form
+ *     of `compressed_format.h` (or back as text) and exit. Either form is loaded the same
+ *     way, and later saves keep the form each file has.
+ *   - `--sync`: force every journal record to disk before the change is reported as done.
+ *   - `--compact`: fold the journal into the text files right after startup.
+ *   - `--batch <file>`: run the commands in `<file>` (`-` for standard input) instead of
+ *     showing the menu, see `batch.h`; `--format text|json` selects the output format.
+ *   - `--serve <socket>`: answer the same commands from many clients at once over a Unix
+ *     domain socket until interrupted, see `server.h`.
+ *   - `--export-pages <file>`: convert the text files into a page file and exit, without
+ *     holding the collections in memory (see `paged_store.h`).
+ *   - `--pages <file>`: run the batch commands read-only against a page file, reading it
+ *     through a buffer pool of `--memory-mb <n>` megabytes (64 by default).
+ *   - `--scan-songs <filter>` / `--scan-albums <filter>`: print the songs or albums matching
+ *     a filter such as `genre = Rap and duration < 3` by scanning the text file in parallel,
+ *     without loading the library (see `stream_scan.h`); `--format` applies.
+ *   - `--metrics-out <file>`: write the timings and counts of the library operations
+ *     (see `metrics.h`) to `<file>` as JSON when the program ends.
+ *   - `--cache-mb <n>`: keep up to `<n>` megabytes of filter, search and ranking results
+ *     for repeated queries (16 by default, 0 turns the cache off; see `query_cache.h`).
+ * - Loading data from the respective files into the vectors using the provided functions,
+ *   all three files at once and large files in parallel chunks
+ * - Handing the vectors over to an `rc::Library`, which builds the artist and genre indexes
+ *   and keeps them up to date on every add and remove, and enabling its column store and range
+ *   indexes for filters (see `range_index.h`), its live album ranking and its primary key indexes
+ *   (see `primary_key.h`).
+ * - Replaying the journal (see `journal.h`) over the loaded data and attaching it to the library,
+ *   so that every later add and remove is logged as soon as it is made.
+ * 
+ * This ensures that the application starts with the data previously saved to the files.
+ */
+    std::vector<rc::Song> songs;
+    std::vector<rc::Artist> artists;
+    std::vector<rc::Album> albums;
+
+    const std::string songsFilename = "music_database.txt";
+    const std::string artistsFilename = "artist_database.txt";
+    const std::string albumsFilename = "album_database.txt";
+
+    const std::string journalFilename = "library_journal.bin";
+
+    std::string snapshotFilename;
+    std::string exportFilename;
+    std::string importFilename;
+    bool syncJournal = false;
+    bool compactOnStart = false;
+    std::string batchFilename;
+    std::string socketPath;
+    std::string exportPagesFilename;
+    std::string pagesFilename;
+    std::size_t memoryMegabytes = 64;
+    std::size_t cacheMegabytes = 16;
+    rc::MetricsDump metricsDump;
+    std::string scanFilter;
+    std::string scanCollection;
+    bool convertStorage = false;
+    rc::StorageFormat storageTarget = rc::StorageFormat::Text;
+    rc::BatchFormat batchFormat = rc::BatchFormat::Text;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if ((option == "--snapshot" || option == "--export-snapshot" || option == "--import-snapshot") && i + 1 < argc) {
+            std::string& target = option == "--snapshot" ? snapshotFilename
+                                : option == "--export-snapshot" ? exportFilename : importFilename;
+            target = argv[++i];
+        } else if (option == "--sync") {
+            syncJournal = true;
+        } else if (option == "--compact") {
+            compactOnStart = true;
+        } else if (option == "--compress" || option == "--decompress") {
+            convertStorage = true;
+            storageTarget = option == "--compress" ? rc::StorageFormat::Compressed : rc::StorageFormat::Text;
+        } else if (option == "--batch" && i + 1 < argc) {
+            batchFilename = argv[++i];
+        } else if (option == "--serve" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if ((option == "--export-pages" || option == "--pages") && i + 1 < argc) {
+            (option == "--pages" ? pagesFilename : exportPagesFilename) = argv[++i];
+        } else if ((option == "--scan-songs" || option == "--scan-albums") && i + 1 < argc) {
+            scanCollection = option == "--scan-songs" ? "songs" : "albums";
+            scanFilter = argv[++i];
+        } else if (option == "--metrics-out" && i + 1 < argc) {
+            metricsDump.filename = argv[++i];
+        } else if (option == "--memory-mb" && i + 1 < argc) {
+            const std::string megabytes = argv[++i];
+            if (!rc::detail::parseNumber(megabytes, memoryMegabytes) || memoryMegabytes == 0) {
+                std::cerr << "Invalid memory size: " << megabytes << std::endl;
+                return 1;
+            }
+        } else if (option == "--cache-mb" && i + 1 < argc) {
+            const std::string megabytes = argv[++i];
+            if (!rc::detail::parseNumber(megabytes, cacheMegabytes)) {
+                std::cerr << "Invalid cache size: " << megabytes << std::endl;
+                return 1;
+            }
+        } else if (option == "--format" && i + 1 < argc) {
+            const std::string format = argv[++i];
+            if (format != "text" && format != "json") {
+                std::cerr << "Unknown format: " << format << std::endl;
+                return 1;
+            }
+            batchFormat = format == "json" ? rc::BatchFormat::Json : rc::BatchFormat::Text;
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    if (!scanCollection.empty()) {
+        const bool scanSongs = scanCollection == "songs";
+        const std::string& filename = scanSongs ? songsFilename : albumsFilename;
+        rc::SongFilter songFilter;
+        rc::AlbumFilter albumFilter;
+        std::string error;
+        if (scanSongs ? !rc::parseSongFilter(scanFilter, songFilter, error, rc::FilterNames::Intern)
+                      : !rc::parseAlbumFilter(scanFilter, albumFilter, error, rc::FilterNames::Intern)) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        rc::ThreadPool pool;
+        rc::FileLoad scan;
+        {
+            rc::OutputBuffer out(stdout);
+            rc::detail::RecordPrinter print(out, batchFormat);
+            scan = scanSongs ? rc::scanSongsFile(filename, songFilter, pool, [&print](const rc::Song& song) { print.song(song); })
+                             : rc::scanAlbumsFile(filename, albumFilter, pool, [&print](const rc::Album& album) { print.album(album); });
+        }
+        rc::reportFileLoad(scan, filename);
+        if (!scan.opened) {
+            return 1;
+        }
+        std::cerr << scan.report.loaded << " of " << scan.report.lines << " line(s) matched." << std::endl;
+        return 0;
+    }
+
+    if (!exportPagesFilename.empty()) {
+        std::error_code ec;
+        if (std::filesystem::file_size(journalFilename, ec) > rc::detail::journalHeaderSize && !ec) {
+            std::cerr << "Warning - the changes in " << journalFilename << " are not in the text files yet"
+                      << " and will be missing from the page file; run with --compact first" << std::endl;
+        }
+        rc::FileLoad loads[3];
+        std::string error;
+        bool written = rc::convertToPageFile(songsFilename, artistsFilename, albumsFilename, exportPagesFilename, loads, error);
+        rc::reportFileLoad(loads[0], songsFilename);
+        rc::reportFileLoad(loads[1], artistsFilename);
+        rc::reportFileLoad(loads[2], albumsFilename);
+        if (!written) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Text files converted to page file " << exportPagesFilename << "." << std::endl;
+        return 0;
+    }
+
+    if (!pagesFilename.empty()) {
+        rc::PagedLibrary paged;
+        std::string error;
+        if (!paged.open(pagesFilename, memoryMegabytes << 20, error)) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        std::ifstream batchFile;
+        if (!batchFilename.empty() && batchFilename != "-") {
+            batchFile.open(batchFilename);
+            if (!batchFile.is_open()) {
+                std::cerr << "Error - cannot open the file!" << std::endl;
+                return 1;
+            }
+        }
+        std::size_t failures;
+        {
+            rc::OutputBuffer out(stdout);
+            failures = rc::runPagedBatch(batchFile.is_open() ? batchFile : std::cin, paged, out, batchFormat);
+        }
+        const rc::BufferPool::Stats& stats = paged.bufferPool().getStats();
+        std::cerr << "Buffer pool: " << paged.bufferPool().frameCount() << " pages, " << stats.hits << " hit(s), "
+                  << stats.misses << " miss(es), " << stats.evictions << " eviction(s)" << std::endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    if (!importFilename.empty()) {
+        std::string error;
+        if (!rc::loadSnapshot(importFilename, songs, artists, albums, error)) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        rc::saveSongsToFile(songs, songsFilename, rc::fileStorageFormat(songsFilename));
+        rc::saveArtistsToFile(artists, artistsFilename, rc::fileStorageFormat(artistsFilename));
+        rc::saveAlbumsToFile(albums, albumsFilename, rc::fileStorageFormat(albumsFilename));
+        std::cout << "Snapshot " << importFilename << " converted to database files." << std::endl;
+        return 0;
+    }
+
+    if (convertStorage) {
+        // The journal records fingerprints of the files it applies to, so it must be empty
+        std::error_code ec;
+        if (std::filesystem::file_size(journalFilename, ec) > rc::detail::journalHeaderSize && !ec) {
+            std::cerr << "Error - the changes in " << journalFilename << " are not in the database files yet;"
+                      << " run with --compact first" << std::endl;
+            return 1;
+        }
+        const rc::DatabaseFiles files{songsFilename, artistsFilename, albumsFilename, {}};
+        const std::uint64_t sizeBefore = rc::baseFilesSize(files);
+        rc::ThreadPool pool;
+        rc::FileLoad loads[3] = {rc::loadSongsFromFile(songs, songsFilename, pool),
+                                 rc::loadArtistsFromFile(artists, artistsFilename, pool),
+                                 rc::loadAlbumsFromFile(albums, albumsFilename, pool)};
+        rc::reportFileLoad(loads[0], songsFilename);
+        rc::reportFileLoad(loads[1], artistsFilename);
+        rc::reportFileLoad(loads[2], albumsFilename);
+        if (!loads[0].opened || !loads[1].opened || !loads[2].opened) {
+            return 1;
+        }
+        bool written = rc::replaceFile(songsFilename, [&](const std::string& name) { return rc::saveSongsToFile(songs, name, storageTarget); });
+        written = rc::replaceFile(artistsFilename, [&](const std::string& name) { return rc::saveArtistsToFile(artists, name, storageTarget); }) && written;
+        written = rc::replaceFile(albumsFilename, [&](const std::string& name) { return rc::saveAlbumsToFile(albums, name, storageTarget); }) && written;
+        if (!written) {
+            return 1;
+        }
+        std::cout << "Database files " << (storageTarget == rc::StorageFormat::Compressed ? "compressed" : "decompressed")
+                  << ": " << sizeBefore << " -> " << rc::baseFilesSize(files) << " bytes." << std::endl;
+        return 0;
+    }
+
+    // The loaded records keep their text here, and the library takes the arena over
+    auto text = std::make_shared<rc::TextArena>();
+    {
+        rc::TextArena::Scope loading(*text);
+        std::string snapshotError;
+        bool fromSnapshot = !snapshotFilename.empty() &&
+            rc::isSnapshotFresh(snapshotFilename, {songsFilename, artistsFilename, albumsFilename}) &&
+            rc::loadSnapshot(snapshotFilename, songs, artists, albums, snapshotError);
+        if (!snapshotError.empty()) {
+            std::cerr << "Warning - " << snapshotError << ", loading the text files instead" << std::endl;
+        }
+        if (!fromSnapshot) {
+            // One thread per file; the chunks of large files are parsed on the shared pool
+            rc::ThreadPool pool;
+            auto songsLoad = std::async(std::launch::async, [&] {
+                rc::TextArena::Scope scope(*text);
+                return rc::loadSongsFromFile(songs, songsFilename, pool);
+            });
+            auto artistsLoad = std::async(std::launch::async, [&] { return rc::loadArtistsFromFile(artists, artistsFilename, pool); });
+            auto albumsLoad = std::async(std::launch::async, [&] {
+                rc::TextArena::Scope scope(*text);
+                return rc::loadAlbumsFromFile(albums, albumsFilename, pool);
+            });
+            rc::reportFileLoad(songsLoad.get(), songsFilename);
+            rc::reportFileLoad(artistsLoad.get(), artistsFilename);
+            rc::reportFileLoad(albumsLoad.get(), albumsFilename);
+            // The snapshot must mirror the text files, not the journal replayed on top of them
+            if (!snapshotFilename.empty() && exportFilename.empty()) {
+                std::string error;
+                if (!rc::saveSnapshot(snapshotFilename, songs, artists, albums, error)) {
+                    std::cerr << "Error - " << error << std::endl;
+                }
+            }
+        }
+    }
+
+    if (!exportFilename.empty()) {
+        std::string error;
+        if (!rc::saveSnapshot(exportFilename, songs, artists, albums, error)) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Text files converted to snapshot " << exportFilename << "." << std::endl;
+        return 0;
+    }
+
+    rc::Library library(std::move(songs), std::move(artists), std::move(albums), std::move(text));
+    library.enableColumnStore();
+    library.enableRangeIndexes();
+    library.enableRankingIndex();
+    library.enableTextSearch();
+    library.enableAggregates();
+    library.enablePrimaryKeys();
+    library.enableQueryCache(cacheMegabytes << 20);
+
+    const rc::DatabaseFiles files{songsFilename, artistsFilename, albumsFilename, snapshotFilename};
+    rc::Journal journal;
+    journal.setSync(syncJournal);
+    std::vector<std::string> journalWarnings;
+    std::string journalError;
+    {
+        // Replayed together, so runs of removals are made in one pass each; the library copies
+        // the text of the replayed records, so theirs goes with the replay
+        rc::TextArena replayedText;
+        rc::TextArena::Scope replaying(replayedText);
+        std::vector<rc::JournalEntry> replayed;
+        if (!journal.open(journalFilename, {songsFilename, artistsFilename, albumsFilename},
+                          [&replayed](const rc::JournalEntry& entry) { replayed.push_back(entry); },
+                          journalWarnings, journalError)) {
+            std::cerr << "Error - " << journalError << std::endl;
+            return 1;
+        }
+        library.applyAll(replayed);
+    }
+    for (const auto& warning : journalWarnings) {
+        std::cerr << "Warning - " << warning << std::endl;
+    }
+    library.attachJournal(&journal);
+    if (compactOnStart || journal.needsCompaction(rc::baseFilesSize(files))) {
+        rc::compactJournal(journal, library, files);
+    }
+
+    if (!batchFilename.empty()) {
+        std::ifstream batchFile;
+        if (batchFilename != "-") {
+            batchFile.open(batchFilename);
+            if (!batchFile.is_open()) {
+                std::cerr << "Error - cannot open the file!" << std::endl;
+                return 1;
+            }
+        }
+        std::size_t failures;
+        {
+            rc::OutputBuffer out(stdout);
+            failures = rc::runBatch(batchFilename == "-" ? std::cin : batchFile, library, out, batchFormat);
+        }
+        if (journal.needsCompaction(rc::baseFilesSize(files))) {
+            rc::compactJournal(journal, library, files);
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    if (!socketPath.empty()) {
+        rc::VersionedLibrary versions(std::move(library), &journal);
+        versions.setJournalCompaction([&] { return journal.needsCompaction(rc::baseFilesSize(files)); },
+                                      [&](rc::Library& latest) { rc::compactJournal(journal, latest, files); });
+        rc::LibraryServer server(versions, batchFormat);
+        std::string error;
+        if (!server.run(socketPath, error)) {
+            std::cerr << "Error - " << error << std::endl;
+            return 1;
+        }
+        versions.withLatest([&](rc::Library& latest) {
+            if (journal.needsCompaction(rc::baseFilesSize(files))) {
+                rc::compactJournal(journal, latest, files);
+            }
+        });
+        return 0;
+    }
+
+
+
+/**
+ * @brief Main loop for the music library menu.
+ *
+ * This loop presents a menu with various options to the user for interacting with the music library. 
+ * The user can add or remove songs, artists, or albums, search for songs or albums by artist or genre,
+ * display the current library, and rank albums based on their ratings.
+ * The loop continues running until the user selects the option to exit (choice 13).
+ * 
+ * @details The switch statement processes user choices and performs the corresponding action.
+ * - Options 1-3 allow adding new songs, artists, and albums; a record with the key of an
+ *   existing one (song: title and artist, album: name and artist, artist: name) replaces it.
+ * - Options 4-6 display the current list of songs, artists, or albums.
+ * - Options 7-9 allow deleting songs, artists, and albums; songs and albums by title or name
+ *   and artist, or by title or name alone for every artist.
+ * - Option 10 allows searching songs and albums by a specific artist; a name without an exact match
+ *   falls back to the closest name of an artist with songs, albums or a record (see
+ *   `Library::searchArtistNames`).
+ * - Option 11 allows searching songs and albums by a specific genre.
+ * - Option 12 shows the top albums ranked by rating, then year, then name.
+ * - Option 13 exits the program. Changes are already saved in the journal at this point;
+ *   it is folded into the text files when it has grown large enough.
+ * - Options 14-15 list songs or albums matching a filter such as `rating > 4 and year >= 2015`.
+ * - Option 16 lists the songs whose artist record matches a filter such as `country = Canada`.
+ * - Option 17 shows the average album rating per artist country.
+ * - Option 18 finds songs, albums and artists whose title or name contains a piece of text,
+ *   or failing that, is within a few typos of it.
+ * - Option 19 shows song and album statistics for one artist or genre, or for all of them.
+ * - Option 20 shows how often each library operation ran, how long it took and how many
+ *   rows, bytes and allocations it involved.
+ */
+int choice;
+do {
+    // Records typed in are built here; the library keeps its own copy of their text
+    rc::TextArena scratch;
+    rc::TextArena::Scope typing(scratch);
+    displayMenu();
+    std::cin >> choice;
+
+    switch (choice) {
+        case 1: {  // Add song
+            std::string title, genre, artist;
+            double duration;
+
+            std::cout << "Title of the song: ";
+            std::cin.ignore();
+            std::getline(std::cin, title);
+
+            std::cout << "Duration of the song (in minutes): ";
+            std::cin >> duration;
+
+            std::cout << "Genre of the song: ";
+            std::cin.ignore();
+            std::getline(std::cin, genre);
+
+            std::cout << "By artist: ";
+            std::getline(std::cin, artist);
+
+            // A song with the same title and artist is replaced rather than added twice
+            if (library.upsertSong(rc::Song(title, duration, genre, artist))) {
+                std::cout << "The song already existed and has been updated!" << std::endl;
+            } else {
+                std::cout << "Song added!" << std::endl;
+            }
+            break;
+        }
+        case 2: {  // Add artist
+            std::string name, country, genre;
+
+            std::cout << "Enter the artist's name: ";
+            std::cin.ignore();
+            std::getline(std::cin, name);
+
+            std::cout << "Enter the artist's country: ";
+            std::getline(std::cin, country);
+
+            std::cout << "Enter the artist's genre: ";
+            std::getline(std::cin, genre);
+
+            if (library.upsertArtist(rc::Artist(name, country, genre))) {
+                std::cout << "The artist already existed and has been updated!" << std::endl;
+            } else {
+                std::cout << "The artist has been added!" << std::endl;
+            }
+            break;
+        }
+        case 3: {  // Add album
+            std::string name, artist, genre;
+            int year;
+            double rating;
+
+            std::cout << "Enter the album name: ";
+            std::cin.ignore();
+            std::getline(std::cin, name);
+
+            std::cout << "Enter the album artist: ";
+            std::getline(std::cin, artist);
+
+            std::cout << "Enter the album release year: ";
+            std::cin >> year;
+
+            std::cout << "Enter the album rating (0-5): ";
+            std::cin >> rating;
+
+            std::cout << "Enter the album genre: ";
+            std::cin.ignore();
+            std::getline(std::cin, genre);
+
+            if (library.upsertAlbum(rc::Album(name, artist, year, rating, genre))) {
+                std::cout << "The album already existed and has been updated!" << std::endl;
+            } else {
+                std::cout << "The album has been added!" << std::endl;
+            }
+            break;
+        }
+        case 4: {  // Display songs
+            std::cout << "\nSongs in the database:" << std::endl;
+            for (std::size_t row = 0; row < library.getSongs().size(); ++row) {
+                if (library.isSongRemoved(row)) {
+                    continue;
+                }
+                const rc::Song& song = library.getSongs()[row];
+                std::cout << song.getTitle() << " (" << song.getArtist() << "): "
+                          << song.getDuration() << " minutes, Genre: " << song.getGenre() << '\n';
+            }
+            break;
+        }
+        case 5: {  // Display artists
+            std::cout << "\nArtists in the database:" << std::endl;
+            for (std::size_t row = 0; row < library.getArtists().size(); ++row) {
+                if (library.isArtistRemoved(row)) {
+                    continue;
+                }
+                const rc::Artist& artist = library.getArtists()[row];
+                std::cout << artist.getName() << " (" << artist.getCountry() << ") Genre: " << artist.getGenre() << '\n';
+            }
+            break;
+        }
+        case 6: {  // Display albums
+            std::cout << "\nAlbums in the database:" << std::endl;
+            for (std::size_t row = 0; row < library.getAlbums().size(); ++row) {
+                if (library.isAlbumRemoved(row)) {
+                    continue;
+                }
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << album.getName() << " (" << album.getArtist() << ") Year: "
+                          << album.getYear() << ", Rating: " << album.getRating() << "/5, Genre: " << album.getGenre() << '\n';
+            }
+            break;
+        }
+        case 7: {  // Delete song
+            std::string title, artist;
+            std::cout << "Enter the title of the song to delete: ";
+            std::cin.ignore();
+            std::getline(std::cin, title);
+
+            std::cout << "By artist (empty for every artist): ";
+            std::getline(std::cin, artist);
+
+            if (artist.empty() ? library.removeSong(title) : library.removeSong(title, artist)) {
+                std::cout << "The song has been deleted!" << std::endl;
+            } else {
+                std::cout << "There is no such song, please try again." << std::endl;
+            }
+            break;
+        }
+        case 8: {  // Delete artist
+            std::string name;
+            std::cout << "Enter the artist's name to delete: ";
+            std::cin.ignore();
+            std::getline(std::cin, name);
+
+            if (library.removeArtist(name)) {
+                std::cout << "The artist '" << name << "' has been deleted!" << std::endl;
+            } else {
+                std::cout << "No artist found with the name: " << name << std::endl;
+            }
+            break;
+        }
+        case 9: {  // Delete album
+            std::string name, artist;
+            std::cout << "Enter the name of the album to delete: ";
+            std::cin.ignore();
+            std::getline(std::cin, name);
+
+            std::cout << "Enter the album artist (empty for every artist): ";
+            std::getline(std::cin, artist);
+
+            if (artist.empty() ? library.removeAlbum(name) : library.removeAlbum(name, artist)) {
+                std::cout << "The album '" << name << "' has been deleted!" << std::endl;
+            } else {
+                std::cout << "No album found with the name: " << name << (artist.empty() ? "" : " by " + artist) << std::endl;
+            }
+            break;
+        }
+        case 10: {  // Search songs and albums by artist
+            std::string artist;
+            std::cout << "Enter the name of the artist: ";
+            std::cin.ignore();
+            std::getline(std::cin, artist);
+
+            // A name that matches nothing exactly may be a typo or differ in case or punctuation
+            if (library.findSongsByArtist(artist).empty() && library.findAlbumsByArtist(artist).empty()) {
+                std::vector<rc::StringId> closest = library.searchArtistNames(artist, rc::TextMatch::Fuzzy, 1);
+                if (!closest.empty()) {
+                    artist = rc::artistDictionary().lookup(closest.front());
+                    std::cout << "No exact match, showing the closest artist: " << artist << std::endl;
+                }
+            }
+
+            // Display songs by the artist
+            std::cout << "\nSongs by artist " << artist << ":" << std::endl;
+            const std::vector<std::size_t>& songRows = library.findSongsByArtist(artist);
+            for (std::size_t row : songRows) {
+                const rc::Song& song = library.getSongs()[row];
+                std::cout << "- " << song.getTitle() << " (" << song.getDuration() 
+                          << " minutes, Genre: " << song.getGenre() << ")" << '\n';
+            }
+            if (songRows.empty()) {
+                std::cout << "No songs by this artist in the database." << std::endl;
+            }
+
+            // Display albums by the artist
+            std::cout << "\nAlbums by artist " << artist << ":" << std::endl;
+            const std::vector<std::size_t>& albumRows = library.findAlbumsByArtist(artist);
+            for (std::size_t row : albumRows) {
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << "- " << album.getName() << " (Year: " << album.getYear() 
+                          << ", Rating: " << album.getRating() << "/5, Genre: " 
+                          << album.getGenre() << ")" << '\n';
+            }
+            if (albumRows.empty()) {
+                std::cout << "No albums by this artist in the database." << std::endl;
+            }
+            break;
+        }
+        case 11: {  // Search songs and albums by genre
+            std::string genre;
+            std::cout << "Enter the genre to search for: ";
+            std::cin.ignore();
+            std::getline(std::cin, genre);
+
+            // Search for songs by genre
+            std::cout << "\nSongs in the genre '" << genre << "':" << std::endl;
+            const std::vector<std::size_t>& songRows = library.findSongsByGenre(genre);
+            for (std::size_t row : songRows) {
+                const rc::Song& song = library.getSongs()[row];
+                std::cout << "- " << song.getTitle() << " (" << song.getArtist() << "), Duration: "
+                          << song.getDuration() << " minutes" << '\n';
+            }
+            if (songRows.empty()) {
+                std::cout << "No songs found in this genre." << std::endl;
+            }
+
+            // Search for albums by genre
+            std::cout << "\nAlbums in the genre '" << genre << "':" << std::endl;
+            const std::vector<std::size_t>& albumRows = library.findAlbumsByGenre(genre);
+            for (std::size_t row : albumRows) {
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: "
+                          << album.getYear() << ", Rating: " << album.getRating() << "/5" << '\n';
+            }
+            if (albumRows.empty()) {
+                std::cout << "No albums found in this genre." << std::endl;
+            }
+            break;
+        }
+        case 12: {  // Ranking albums by rating
+            if (library.albumCount() == 0) {
+                std::cout << "No albums in the database to sort." << std::endl;
+                break;
+            }
+
+            std::size_t count;
+            std::cout << "How many albums to show (0 for all): ";
+            std::cin >> count;
+
+            // The live ranking is already ordered by rating, then year, then name
+            std::vector<std::size_t> rows = library.rankAlbums(count);
+
+            // Displaying sorted albums
+            std::cout << "\nAlbum ranking by rating:" << std::endl;
+            for (std::size_t row : rows) {
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: "
+                          << album.getYear() << ", Rating: " << album.getRating() << "/5, Genre: "
+                          << album.getGenre() << '\n';
+            }
+
+            break;
+        }
+        case 13: {  // Exit the program
+            // Every change is already in the journal; the text files are only rewritten once it has grown
+            if (journal.needsCompaction(rc::baseFilesSize(files))) {
+                rc::compactJournal(journal, library, files);
+            }
+            std::cout << "Changes have been saved." << std::endl;
+            break;
+        }
+        case 14: {  // Filter songs
+            std::string text, error;
+            std::cout << "Enter the filter (e.g. duration < 3 and genre = Rap): ";
+            std::cin.ignore();
+            std::getline(std::cin, text);
+
+            rc::SongFilter filter;
+            if (!rc::parseSongFilter(text, filter, error)) {
+                std::cout << "Invalid filter: " << error << std::endl;
+                break;
+            }
+            std::vector<std::size_t> rows = library.filterSongs(filter);
+            std::cout << "\nSongs matching the filter:" << std::endl;
+            for (std::size_t row : rows) {
+                const rc::Song& song = library.getSongs()[row];
+                std::cout << "- " << song.getTitle() << " (" << song.getArtist() << "): "
+                          << song.getDuration() << " minutes, Genre: " << song.getGenre() << '\n';
+            }
+            if (rows.empty()) {
+                std::cout << "No songs match this filter." << std::endl;
+            }
+            break;
+        }
+        case 15: {  // Filter albums
+            std::string text, error;
+            std::cout << "Enter the filter (e.g. rating > 4.0 and year >= 2015): ";
+            std::cin.ignore();
+            std::getline(std::cin, text);
+
+            rc::AlbumFilter filter;
+            if (!rc::parseAlbumFilter(text, filter, error)) {
+                std::cout << "Invalid filter: " << error << std::endl;
+                break;
+            }
+            std::vector<std::size_t> rows = library.filterAlbums(filter);
+            std::cout << "\nAlbums matching the filter:" << std::endl;
+            for (std::size_t row : rows) {
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: "
+                          << album.getYear() << ", Rating: " << album.getRating() << "/5, Genre: "
+                          << album.getGenre() << '\n';
+            }
+            if (rows.empty()) {
+                std::cout << "No albums match this filter." << std::endl;
+            }
+            break;
+        }
+        case 16: {  // Songs joined with their artist records
+            std::string text, error;
+            std::cout << "Enter the artist filter (e.g. country = Canada and genre = Rap): ";
+            std::cin.ignore();
+            std::getline(std::cin, text);
+
+            rc::ArtistFilter filter;
+            if (!rc::parseArtistFilter(text, filter, error)) {
+                std::cout << "Invalid filter: " << error << std::endl;
+                break;
+            }
+            std::vector<rc::JoinedRows> rows = rc::joinSongsWithArtists(library, {}, filter);
+            std::cout << "\nSongs by matching artists:" << std::endl;
+            for (const rc::JoinedRows& joined : rows) {
+                const rc::Song& song = library.getSongs()[joined.left];
+                const rc::Artist& artist = library.getArtists()[joined.right];
+                std::cout << "- " << song.getTitle() << " (" << artist.getName() << ", " << artist.getCountry() << "): "
+                          << song.getDuration() << " minutes, Genre: " << song.getGenre() << '\n';
+            }
+            if (rows.empty()) {
+                std::cout << "No songs by matching artists." << std::endl;
+            }
+            break;
+        }
+        case 17: {  // Average album rating per artist country
+            std::vector<rc::CountryRating> ratings = rc::averageAlbumRatingByCountry(library);
+            std::cout << "\nAverage album rating by artist country:" << std::endl;
+            for (const rc::CountryRating& rating : ratings) {
+                std::cout << "- " << rc::countryDictionary().lookup(rating.country) << ": " << rating.averageRating
+                          << "/5 over " << rating.albums << " album(s)" << '\n';
+            }
+            if (ratings.empty()) {
+                std::cout << "No albums by artists in the database." << std::endl;
+            }
+            break;
+        }
+        case 18: {  // Search titles and names
+            std::string text;
+            std::cout << "Enter part of a title or name: ";
+            std::cin.ignore();
+            std::getline(std::cin, text);
+
+            // Without a substring match, fall back to titles and names within a few typos
+            const std::size_t limit = 10;
+            auto search = [&](auto find) {
+                std::vector<std::size_t> rows = find(rc::TextMatch::Substring);
+                return rows.empty() ? find(rc::TextMatch::Fuzzy) : rows;
+            };
+            std::cout << "\nSongs:" << std::endl;
+            for (std::size_t row : search([&](rc::TextMatch match) { return library.searchSongs(text, match, limit); })) {
+                const rc::Song& song = library.getSongs()[row];
+                std::cout << "- " << song.getTitle() << " (" << song.getArtist() << ")" << '\n';
+            }
+            std::cout << "Albums:" << std::endl;
+            for (std::size_t row : search([&](rc::TextMatch match) { return library.searchAlbums(text, match, limit); })) {
+                const rc::Album& album = library.getAlbums()[row];
+                std::cout << "- " << album.getName() << " (" << album.getArtist() << "), Year: " << album.getYear() << '\n';
+            }
+            std::cout << "Artists:" << std::endl;
+            for (std::size_t row : search([&](rc::TextMatch match) { return library.searchArtists(text, match, limit); })) {
+                const rc::Artist& artist = library.getArtists()[row];
+                std::cout << "- " << artist.getName() << " (" << artist.getCountry() << ")" << '\n';
+            }
+            break;
+        }
+        case 19: {  // Statistics per artist or genre
+            std::string group, name;
+            std::cout << "Group by (artist or genre): ";
+            std::cin >> group;
+            if (group != "artist" && group != "genre") {
+                std::cout << "Unknown grouping: " << group << std::endl;
+                break;
+            }
+            const rc::GroupBy by = group == "artist" ? rc::GroupBy::Artist : rc::GroupBy::Genre;
+            std::cout << "Enter the " << group << " (leave empty for all): ";
+            std::cin.ignore();
+            std::getline(std::cin, name);
+
+            std::vector<rc::GroupSummary> groups;
+            if (name.empty()) {
+                groups = library.groupStats(by);
+            } else {
+                rc::GroupStats stats = library.groupStats(by, name);
+                if (!stats.empty()) {
+                    groups.push_back({rc::groupDictionary(by).find(name), std::move(stats)});
+                }
+            }
+            std::cout << "\nStatistics by " << group << ":" << std::endl;
+            for (const rc::GroupSummary& summary : groups) {
+                const rc::GroupStats& stats = summary.stats;
+                std::cout << "- " << rc::groupDictionary(by).lookup(summary.key) << ": " << stats.songs << " song(s), "
+                          << stats.totalDuration << " minutes (average " << stats.averageDuration() << "), "
+                          << stats.albums << " album(s), average rating " << stats.averageRating() << "/5";
+                if (stats.albums != 0) {
+                    std::cout << ", years " << stats.firstYear() << "-" << stats.lastYear();
+                }
+                std::cout << '\n';
+            }
+            if (groups.empty()) {
+                std::cout << "No songs or albums found." << std::endl;
+            }
+            break;
+        }
+        case 20: {  // Performance statistics
+            std::vector<rc::OperationStats> operations = rc::metrics().snapshot();
+            std::cout << "\nPerformance statistics:" << std::endl;
+            for (const rc::OperationStats& op : operations) {
+                std::cout << "- ";
+                rc::writeOperationLine(std::cout, op);
+            }
+            if (operations.empty()) {
+                std::cout << "No operations recorded yet." << std::endl;
+            }
+            break;
+        }
+        default:
+            std::cout << "Invalid choice! Please try again." << std::endl;
+    }
+} while (choice != 13);
+
+return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file mapped_file.h
+ * @brief Read-only memory mapping of a whole file.
+ * Lets the loaders parse the database files in place instead of copying them through a stream.
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rc {
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string& path) { open(path); }
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept { swap(other); }
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                close();
+                swap(other);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Maps the whole file into memory.
+         *
+         * An empty file opens successfully with a null data pointer and a size of zero.
+         * Returns false if the file cannot be opened or mapped.
+         */
+        bool open(const std::string& path) {
+            close();
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize)) {
+                CloseHandle(file);
+                return false;
+            }
+            if (fileSize.QuadPart > 0) {
+                HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping == nullptr) {
+                    CloseHandle(file);
+                    return false;
+                }
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+                if (view == nullptr) {
+                    CloseHandle(file);
+                    return false;
+                }
+                bytes = static_cast<const char*>(view);
+                length = static_cast<std::size_t>(fileSize.QuadPart);
+            }
+            CloseHandle(file);
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                return false;
+            }
+            if (info.st_size > 0) {
+                void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view == MAP_FAILED) {
+                    ::close(fd);
+                    return false;
+                }
+                madvise(view, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+                bytes = static_cast<const char*>(view);
+                length = static_cast<std::size_t>(info.st_size);
+            }
+            ::close(fd);
+#endif
+            opened = true;
+            return true;
+        }
+
+        void close() {
+            if (bytes != nullptr) {
+#ifdef _WIN32
+                UnmapViewOfFile(bytes);
+#else
+                munmap(const_cast<char*>(bytes), length);
+#endif
+            }
+            bytes = nullptr;
+            length = 0;
+            opened = false;
+        }
+
+        bool isOpen() const { return opened; }
+        const char* data() const { return bytes; }
+        std::size_t size() const { return length; }
+        std::string_view view() const { return std::string_view(bytes, length); }
+
+    private:
+        void swap(MappedFile& other) noexcept {
+            std::swap(bytes, other.bytes);
+            std::swap(length, other.length);
+            std::swap(opened, other.opened);
+        }
+
+        const char* bytes = nullptr;
+        std::size_t length = 0;
+        bool opened = false;
+    };
+}
+
+#endif
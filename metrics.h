@@ -0,0 +1,404 @@
+/**
+ * @file metrics.h
+ * @brief Built-in instrumentation: call counts, latency histograms, rows scanned and matched,
+ * bytes read and written, and allocations, per library operation.
+ *
+ * Operations are timed with a `ScopedTimer` placed at the top of the function; it adds its
+ * numbers to the process-wide `metrics()` once, when it goes out of scope. Each thread
+ * counts in its own shard, so the server threads record concurrently without a lock or a
+ * shared cache line. Latencies
+ * go into power-of-two histograms (bucket `i` holds durations below 2^(i+1) ns), which is
+ * enough to tell a microsecond lookup from a millisecond scan at a fixed memory cost;
+ * percentiles are reported as the upper bound of their bucket.
+ *
+ * Allocations are counted only in programs that route `operator new` through
+ * `detail::countAllocation` (`main.cpp` does). The counter is process-wide, so an operation
+ * running next to others (such as the three files loading at once) also sees theirs.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rc {
+    enum class Metric : std::size_t {
+        LoadSongs, LoadArtists, LoadAlbums,
+        SaveSongs, SaveArtists, SaveAlbums,
+        FindByArtist, FindByGenre,
+        Filter, TextSearch, RankAlbums, GroupStats,
+        FindByKey, Upsert,
+        RemoveSong, RemoveArtist, RemoveAlbum,
+        Count
+    };
+
+    inline const char* metricName(Metric metric) {
+        static const char* const names[] = {
+            "load_songs", "load_artists", "load_albums",
+            "save_songs", "save_artists", "save_albums",
+            "find_by_artist", "find_by_genre",
+            "filter", "text_search", "rank_albums", "group_stats",
+            "find_by_key", "upsert",
+            "remove_song", "remove_artist", "remove_album",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<std::size_t>(Metric::Count), "one name per metric");
+        return names[static_cast<std::size_t>(metric)];
+    }
+
+    constexpr std::size_t metricCount = static_cast<std::size_t>(Metric::Count);
+    constexpr std::size_t histogramBuckets = 40;   // the last one takes everything from ~9 minutes up
+
+    namespace detail {
+        inline std::atomic<std::uint64_t> allocationCounter{0};
+
+        inline void countAllocation() { allocationCounter.fetch_add(1, std::memory_order_relaxed); }
+
+        /**
+         * @brief floor(log2(nanos)), capped to the last bucket.
+         */
+        inline std::size_t histogramBucket(std::uint64_t nanos) {
+            if (nanos <= 1) {
+                return 0;
+            }
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanReverse64(&index, nanos);
+            const std::size_t bucket = index;
+#else
+            const std::size_t bucket = 63 - static_cast<std::size_t>(__builtin_clzll(nanos));
+#endif
+            return std::min(bucket, histogramBuckets - 1);
+        }
+    }
+
+    /**
+     * @brief Totals of one operation at the time `Metrics::snapshot` was taken.
+     */
+    struct OperationStats {
+        Metric metric = Metric::Count;
+        std::uint64_t calls = 0;
+        std::uint64_t totalNanos = 0;
+        std::uint64_t maxNanos = 0;
+        std::uint64_t rowsScanned = 0;
+        std::uint64_t rowsMatched = 0;
+        std::uint64_t bytesRead = 0;
+        std::uint64_t bytesWritten = 0;
+        std::uint64_t allocations = 0;
+        std::array<std::uint64_t, histogramBuckets> histogram{};
+
+        const char* name() const { return metricName(metric); }
+        double totalMillis() const { return static_cast<double>(totalNanos) / 1e6; }
+        double meanMicros() const { return calls == 0 ? 0.0 : static_cast<double>(totalNanos) / 1e3 / static_cast<double>(calls); }
+        double maxMicros() const { return static_cast<double>(maxNanos) / 1e3; }
+
+        static double bucketLimitMicros(std::size_t bucket) {
+            return static_cast<double>(std::uint64_t(1) << (bucket + 1)) / 1e3;
+        }
+
+        /**
+         * @brief Upper bound of the histogram bucket holding the `fraction` quantile, in
+         * microseconds, but never more than the slowest call.
+         */
+        double percentileMicros(double fraction) const {
+            const double rank = fraction * static_cast<double>(calls);
+            std::uint64_t seen = 0;
+            for (std::size_t bucket = 0; bucket < histogramBuckets; ++bucket) {
+                seen += histogram[bucket];
+                if (seen != 0 && static_cast<double>(seen) >= rank) {
+                    return std::min(bucketLimitMicros(bucket), maxMicros());
+                }
+            }
+            return maxMicros();
+        }
+    };
+
+    /**
+     * @brief Process-wide counters, one set per `Metric`.
+     *
+     * Every thread records into a shard of its own with plain loads and stores (it is the
+     * only writer), so concurrent readers in the server never fight over a cache line.
+     * `snapshot` adds the shards up; a thread that ends leaves its totals behind. `reset`
+     * starts a new epoch instead of touching other threads' shards: a shard from an older
+     * epoch is ignored by `snapshot` and zeroed by its owner on its next record.
+     */
+    class Metrics {
+    public:
+        struct Sample {
+            std::uint64_t nanos = 0;
+            std::uint64_t rowsScanned = 0;
+            std::uint64_t rowsMatched = 0;
+            std::uint64_t bytesRead = 0;
+            std::uint64_t bytesWritten = 0;
+            std::uint64_t allocations = 0;
+        };
+
+        Metrics() = default;
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        void record(Metric metric, const Sample& sample) {
+            Shard& shard = localShard();
+            const std::uint64_t current = epoch.load(std::memory_order_relaxed);
+            if (shard.epoch.load(std::memory_order_relaxed) != current) {
+                for (Counters& c : shard.counters) {
+                    c.clear();
+                }
+                shard.epoch.store(current, std::memory_order_relaxed);
+            }
+            Counters& c = shard.counters[static_cast<std::size_t>(metric)];
+            bump(c.calls, 1);
+            bump(c.totalNanos, sample.nanos);
+            bump(c.histogram[detail::histogramBucket(sample.nanos)], 1);
+            if (sample.nanos > c.maxNanos.load(std::memory_order_relaxed)) {
+                c.maxNanos.store(sample.nanos, std::memory_order_relaxed);
+            }
+            bump(c.rowsScanned, sample.rowsScanned);
+            bump(c.rowsMatched, sample.rowsMatched);
+            bump(c.bytesRead, sample.bytesRead);
+            bump(c.bytesWritten, sample.bytesWritten);
+            bump(c.allocations, sample.allocations);
+        }
+
+        /**
+         * @brief The operations that were called at least once, in `Metric` order.
+         */
+        std::vector<OperationStats> snapshot() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::array<OperationStats, metricCount> totals = retired;
+            const std::uint64_t current = epoch.load(std::memory_order_relaxed);
+            for (const Shard* shard : shards) {
+                if (shard->epoch.load(std::memory_order_relaxed) == current) {
+                    addShard(totals, *shard);
+                }
+            }
+            std::vector<OperationStats> result;
+            for (std::size_t i = 0; i < metricCount; ++i) {
+                if (totals[i].calls != 0) {
+                    totals[i].metric = static_cast<Metric>(i);
+                    result.push_back(totals[i]);
+                }
+            }
+            return result;
+        }
+
+        void reset() {
+            std::lock_guard<std::mutex> lock(mutex);
+            epoch.fetch_add(1, std::memory_order_relaxed);
+            retired = {};
+        }
+
+        /**
+         * @brief Turns the timers off (or on again); while off, `ScopedTimer` records nothing.
+         */
+        void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    private:
+        struct Counters {
+            std::atomic<std::uint64_t> calls{0};
+            std::atomic<std::uint64_t> totalNanos{0};
+            std::atomic<std::uint64_t> maxNanos{0};
+            std::atomic<std::uint64_t> rowsScanned{0};
+            std::atomic<std::uint64_t> rowsMatched{0};
+            std::atomic<std::uint64_t> bytesRead{0};
+            std::atomic<std::uint64_t> bytesWritten{0};
+            std::atomic<std::uint64_t> allocations{0};
+            std::array<std::atomic<std::uint64_t>, histogramBuckets> histogram{};
+
+            void clear() {
+                for (std::atomic<std::uint64_t>* value : {&calls, &totalNanos, &maxNanos, &rowsScanned, &rowsMatched,
+                                                          &bytesRead, &bytesWritten, &allocations}) {
+                    value->store(0, std::memory_order_relaxed);
+                }
+                for (auto& bucket : histogram) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        struct Shard {
+            std::array<Counters, metricCount> counters;
+            std::atomic<std::uint64_t> epoch{0};
+        };
+
+        /**
+         * @brief Owns the calling thread's shard and hands its totals over when the thread ends.
+         */
+        struct ShardOwner {
+            Metrics* metrics = nullptr;
+            std::unique_ptr<Shard> shard;
+
+            ~ShardOwner() {
+                if (metrics != nullptr) {
+                    metrics->retire(*shard);
+                }
+            }
+        };
+
+        // Only the owning thread writes a shard, so a load and a store replace a locked add
+        static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+            if (value != 0) {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        }
+
+        static void addShard(std::array<OperationStats, metricCount>& totals, const Shard& shard) {
+            for (std::size_t i = 0; i < metricCount; ++i) {
+                const Counters& c = shard.counters[i];
+                OperationStats& total = totals[i];
+                total.calls += c.calls.load(std::memory_order_relaxed);
+                total.totalNanos += c.totalNanos.load(std::memory_order_relaxed);
+                total.maxNanos = std::max(total.maxNanos, c.maxNanos.load(std::memory_order_relaxed));
+                total.rowsScanned += c.rowsScanned.load(std::memory_order_relaxed);
+                total.rowsMatched += c.rowsMatched.load(std::memory_order_relaxed);
+                total.bytesRead += c.bytesRead.load(std::memory_order_relaxed);
+                total.bytesWritten += c.bytesWritten.load(std::memory_order_relaxed);
+                total.allocations += c.allocations.load(std::memory_order_relaxed);
+                for (std::size_t bucket = 0; bucket < histogramBuckets; ++bucket) {
+                    total.histogram[bucket] += c.histogram[bucket].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        Shard& localShard() {
+            thread_local ShardOwner local;
+            if (local.metrics != this) {
+                auto shard = std::make_unique<Shard>();
+                std::lock_guard<std::mutex> lock(mutex);
+                shard->epoch.store(epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                shards.push_back(shard.get());
+                local.shard = std::move(shard);
+                local.metrics = this;
+            }
+            return *local.shard;
+        }
+
+        void retire(const Shard& shard) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (shard.epoch.load(std::memory_order_relaxed) == epoch.load(std::memory_order_relaxed)) {
+                addShard(retired, shard);
+            }
+            shards.erase(std::find(shards.begin(), shards.end(), &shard));
+        }
+
+        mutable std::mutex mutex;                            // guards `shards` and `retired`
+        std::vector<const Shard*> shards;
+        std::array<OperationStats, metricCount> retired{};   // totals of the threads that ended
+        std::atomic<std::uint64_t> epoch{0};
+        std::atomic<bool> enabled{true};
+    };
+
+    /**
+     * @brief The one `Metrics` instance; shards are tied to it, so no other should be made.
+     */
+    inline Metrics& metrics() {
+        static Metrics instance;
+        return instance;
+    }
+
+    /**
+     * @brief Times the enclosing scope as one call of `metric`; the row and byte counts set
+     * on it are recorded along with the time.
+     */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Metric metric) : metric(metric), active(metrics().isEnabled()) {
+            if (active) {
+                allocationsAtStart = detail::allocationCounter.load(std::memory_order_relaxed);
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ScopedTimer() {
+            if (active) {
+                sample.nanos = static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                sample.allocations = detail::allocationCounter.load(std::memory_order_relaxed) - allocationsAtStart;
+                metrics().record(metric, sample);
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        void rows(std::size_t scanned, std::size_t matched) {
+            sample.rowsScanned += scanned;
+            sample.rowsMatched += matched;
+        }
+
+        /**
+         * @brief Index lookups: every row handed back was both looked at and matched.
+         */
+        template <typename Rows>
+        const Rows& found(const Rows& result) {
+            rows(result.size(), result.size());
+            return result;
+        }
+
+        void bytesRead(std::uint64_t bytes) { sample.bytesRead += bytes; }
+        void bytesWritten(std::uint64_t bytes) { sample.bytesWritten += bytes; }
+
+    private:
+        Metric metric;
+        bool active;
+        std::uint64_t allocationsAtStart = 0;
+        std::chrono::steady_clock::time_point start;
+        Metrics::Sample sample;
+    };
+
+    /**
+     * @brief One line of text describing `op`, for `std::ostream` or the batch `OutputBuffer`.
+     */
+    template <typename Out>
+    void writeOperationLine(Out& out, const OperationStats& op) {
+        out << op.name() << ": " << op.calls << " call(s), total " << op.totalMillis() << " ms, mean "
+            << op.meanMicros() << " us, p50 <= " << op.percentileMicros(0.50) << " us, p99 <= "
+            << op.percentileMicros(0.99) << " us, max " << op.maxMicros() << " us, rows " << op.rowsMatched
+            << " matched of " << op.rowsScanned << " scanned, bytes " << op.bytesRead << " read, "
+            << op.bytesWritten << " written, " << op.allocations << " allocation(s)\n";
+    }
+
+    /**
+     * @brief Writes every recorded operation as one JSON document, histograms included
+     * (only their non-empty buckets, each with its upper bound in microseconds).
+     */
+    inline void writeMetricsJson(std::ostream& out, const std::vector<OperationStats>& operations) {
+        out << "{\n  \"operations\": [";
+        const char* separator = "\n";
+        for (const OperationStats& op : operations) {
+            out << separator << "    {\"name\": \"" << op.name() << "\", \"calls\": " << op.calls
+                << ", \"total_ms\": " << op.totalMillis() << ", \"mean_us\": " << op.meanMicros()
+                << ", \"p50_us\": " << op.percentileMicros(0.50) << ", \"p90_us\": " << op.percentileMicros(0.90)
+                << ", \"p99_us\": " << op.percentileMicros(0.99) << ", \"max_us\": " << op.maxMicros()
+                << ", \"rows_scanned\": " << op.rowsScanned << ", \"rows_matched\": " << op.rowsMatched
+                << ", \"bytes_read\": " << op.bytesRead << ", \"bytes_written\": " << op.bytesWritten
+                << ", \"allocations\": " << op.allocations << ", \"histogram\": [";
+            const char* bucketSeparator = "";
+            for (std::size_t bucket = 0; bucket < histogramBuckets; ++bucket) {
+                if (op.histogram[bucket] != 0) {
+                    out << bucketSeparator << "{\"le_us\": " << OperationStats::bucketLimitMicros(bucket)
+                        << ", \"count\": " << op.histogram[bucket] << "}";
+                    bucketSeparator = ", ";
+                }
+            }
+            out << "]}";
+            separator = ",\n";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+#endif
@@ -0,0 +1,818 @@
+/**
+ * @file paged_store.h
+ * @brief Out-of-core storage for libraries larger than memory: the collections are kept on
+ * disk in fixed-size pages and read through a buffer pool with a fixed memory budget.
+ *
+ * Layout of a page file (native byte order, every page `pageSize` bytes):
+ * - page 0: magic `RCPAGEDB`, version, byte-order marker, page size, then for the songs,
+ *   artists, albums and dictionary sections their first page, page count and record count
+ *   (byte count for the dictionaries)
+ * - data pages: record count and used bytes, then whole records; a record never spans pages.
+ *   Songs are `title length, title, duration, genre, artist`, artists `name, country, genre`,
+ *   albums `name length, name, artist, year, rating, genre`; genre, artist and country are
+ *   IDs into the dictionary section
+ * - dictionary section: the genre, artist and country names, read into memory on open
+ *
+ * The text files are converted by streaming them through the parser straight into pages, so
+ * the conversion does not hold the collections in memory either. A paged library is read-only:
+ * changes go through the text files and the journal, and a new page file is exported from them.
+ */
+#ifndef PAGED_STORE_H
+#define PAGED_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "batch.h"
+#include "database_io.h"
+#include "loader.h"
+#include "mapped_file.h"
+#include "string_dictionary.h"
+#include "text_index.h"
+#include "thread_pool.h"
+
+namespace rc {
+    constexpr char pageFileMagic[8] = {'R', 'C', 'P', 'A', 'G', 'E', 'D', 'B'};
+    constexpr std::uint32_t pageFileVersion = 1;
+    constexpr std::uint32_t pageFileByteOrder = 0x01020304;
+    constexpr std::uint32_t defaultPageSize = 16 * 1024;
+
+    enum class PagedSection : std::uint32_t { Songs = 0, Artists = 1, Albums = 2, Dictionaries = 3 };
+
+    namespace detail {
+        struct PageRange {
+            std::uint64_t firstPage = 0;
+            std::uint64_t pageCount = 0;
+            std::uint64_t count = 0;
+        };
+
+        struct PageFileHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint32_t pageSize;
+            std::uint32_t reserved;
+            PageRange sections[4];
+        };
+
+        struct PageHeader {
+            std::uint32_t records;
+            std::uint32_t bytes;   // including this header
+        };
+
+        template <typename T>
+        void putValue(std::string& out, T value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        /**
+         * @brief Bounds-checked reading of the fields of one page.
+         */
+        class PageReader {
+        public:
+            PageReader(const char* p, const char* end) : p(p), end(end) {}
+
+            template <typename T>
+            bool value(T& out) {
+                if (static_cast<std::size_t>(end - p) < sizeof(T)) {
+                    return false;
+                }
+                std::memcpy(&out, p, sizeof(T));
+                p += sizeof(T);
+                return true;
+            }
+
+            bool text(std::string_view& out) {
+                std::uint16_t length;
+                if (!value(length) || static_cast<std::size_t>(end - p) < length) {
+                    return false;
+                }
+                out = std::string_view(p, length);
+                p += length;
+                return true;
+            }
+
+        private:
+            const char* p;
+            const char* end;
+        };
+    }
+
+    /**
+     * @brief A song decoded from a page. The title points into the page, so a view is only
+     * valid during the visit that produced it.
+     */
+    class SongView {
+    public:
+        SongView(std::string_view title, double duration, StringId genre, StringId artist)
+            : title(title), duration(duration), genre(genre), artist(artist) {}
+
+        std::string_view getTitle() const { return title; }
+        double getDuration() const { return duration; }
+        const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+        const std::string& getArtist() const { return artistDictionary().lookup(artist); }
+        StringId getGenreId() const { return genre; }
+        StringId getArtistId() const { return artist; }
+
+    private:
+        std::string_view title;
+        double duration;
+        StringId genre;
+        StringId artist;
+    };
+
+    class AlbumView {
+    public:
+        AlbumView(std::string_view name, StringId artist, int year, double rating, StringId genre)
+            : name(name), artist(artist), year(year), rating(rating), genre(genre) {}
+
+        std::string_view getName() const { return name; }
+        const std::string& getArtist() const { return artistDictionary().lookup(artist); }
+        int getYear() const { return year; }
+        double getRating() const { return rating; }
+        const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+        StringId getArtistId() const { return artist; }
+        StringId getGenreId() const { return genre; }
+
+    private:
+        std::string_view name;
+        StringId artist;
+        int year;
+        double rating;
+        StringId genre;
+    };
+
+    class ArtistView {
+    public:
+        ArtistView(StringId name, StringId country, StringId genre) : name(name), country(country), genre(genre) {}
+
+        const std::string& getName() const { return artistDictionary().lookup(name); }
+        const std::string& getCountry() const { return countryDictionary().lookup(country); }
+        const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+        StringId getNameId() const { return name; }
+        StringId getCountryId() const { return country; }
+        StringId getGenreId() const { return genre; }
+
+    private:
+        StringId name;
+        StringId country;
+        StringId genre;
+    };
+
+    /**
+     * @brief Writes a page file: first every song, then every artist, then every album.
+     * The file is written under a temporary name and renamed by `finish`.
+     */
+    class PageFileWriter {
+    public:
+        explicit PageFileWriter(std::uint32_t pageSize = defaultPageSize) : pageSize(pageSize) {}
+
+        bool open(const std::string& filename, std::string& error) {
+            target = filename;
+            tempName = filename + ".tmp";
+            file.open(tempName, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                error = "cannot create " + tempName;
+                return false;
+            }
+            // Page 0 is the header, written last
+            file.write(std::string(pageSize, '\0').data(), pageSize);
+            nextPage = 1;
+            return true;
+        }
+
+        bool addSong(std::string_view title, double duration, StringId genre, StringId artist, std::string& error) {
+            std::string& record = startRecord();
+            detail::putValue(record, static_cast<std::uint16_t>(title.size()));
+            record.append(title.data(), title.size());
+            detail::putValue(record, duration);
+            detail::putValue(record, genre);
+            detail::putValue(record, artist);
+            return addRecord(PagedSection::Songs, title.size(), error);
+        }
+
+        bool addArtist(StringId name, StringId country, StringId genre, std::string& error) {
+            std::string& record = startRecord();
+            detail::putValue(record, name);
+            detail::putValue(record, country);
+            detail::putValue(record, genre);
+            return addRecord(PagedSection::Artists, 0, error);
+        }
+
+        bool addAlbum(std::string_view name, StringId artist, int year, double rating, StringId genre, std::string& error) {
+            std::string& record = startRecord();
+            detail::putValue(record, static_cast<std::uint16_t>(name.size()));
+            record.append(name.data(), name.size());
+            detail::putValue(record, artist);
+            detail::putValue(record, static_cast<std::int32_t>(year));
+            detail::putValue(record, rating);
+            detail::putValue(record, genre);
+            return addRecord(PagedSection::Albums, name.size(), error);
+        }
+
+        /**
+         * @brief Writes the dictionaries and the header, then moves the file into place.
+         */
+        bool finish(std::string& error) {
+            flushPage();
+            std::string names;
+            for (StringDictionary* dictionary : {&genreDictionary(), &artistDictionary(), &countryDictionary()}) {
+                const std::size_t count = dictionary->size();
+                detail::putValue(names, static_cast<std::uint32_t>(count));
+                for (StringId id = 0; id < count; ++id) {
+                    const std::string& name = dictionary->lookup(id);
+                    detail::putValue(names, static_cast<std::uint32_t>(name.size()));
+                    names.append(name);
+                }
+            }
+            detail::PageRange& dictionaries = header.sections[static_cast<std::size_t>(PagedSection::Dictionaries)];
+            dictionaries.firstPage = nextPage;
+            dictionaries.pageCount = (names.size() + pageSize - 1) / pageSize;
+            dictionaries.count = names.size();
+            names.resize(dictionaries.pageCount * pageSize, '\0');
+            file.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+            std::memcpy(header.magic, pageFileMagic, sizeof(header.magic));
+            header.version = pageFileVersion;
+            header.byteOrder = pageFileByteOrder;
+            header.pageSize = pageSize;
+            header.reserved = 0;
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.close();
+            if (!file) {
+                error = "cannot write " + tempName;
+                return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tempName, target, ec);
+            if (ec) {
+                error = "cannot replace " + target + ": " + ec.message();
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::string& startRecord() {
+            record.clear();
+            return record;
+        }
+
+        bool addRecord(PagedSection section, std::size_t textSize, std::string& error) {
+            if (textSize > UINT16_MAX || record.size() > pageSize - sizeof(detail::PageHeader)) {
+                error = "record too long for a page of " + std::to_string(pageSize) + " bytes";
+                return false;
+            }
+            const auto index = static_cast<std::size_t>(section);
+            if (!started[index]) {
+                // Sections are contiguous: a new section starts on a fresh page
+                flushPage();
+                started[index] = true;
+                header.sections[index].firstPage = nextPage;
+            }
+            if (page.size() + record.size() > pageSize) {
+                flushPage();
+            }
+            if (page.empty()) {
+                page.resize(sizeof(detail::PageHeader));
+                ++header.sections[index].pageCount;
+            }
+            page.append(record);
+            ++pageRecords;
+            ++header.sections[index].count;
+            return true;
+        }
+
+        void flushPage() {
+            if (page.empty()) {
+                return;
+            }
+            detail::PageHeader pageHeader{pageRecords, static_cast<std::uint32_t>(page.size())};
+            std::memcpy(&page[0], &pageHeader, sizeof(pageHeader));
+            page.resize(pageSize, '\0');
+            file.write(page.data(), pageSize);
+            page.clear();
+            pageRecords = 0;
+            ++nextPage;
+        }
+
+        std::uint32_t pageSize;
+        std::ofstream file;
+        std::string target;
+        std::string tempName;
+        detail::PageFileHeader header{};
+        bool started[3] = {false, false, false};
+        std::string page;
+        std::string record;
+        std::uint32_t pageRecords = 0;
+        std::uint64_t nextPage = 0;
+    };
+
+    namespace detail {
+        /**
+         * @brief Hands the values of every record of a `T` file to `add`, in constructor order,
+         * whether the file is text or compressed. Does nothing once `ok` is false.
+         */
+        template <typename T, typename Add>
+        void convertFile(const std::string& filename, FileLoad& load, ThreadPool& pool, const bool& ok, Add add) {
+            MappedFile file(filename);
+            load.opened = file.isOpen();
+            if (load.opened && ok) {
+                load.report = isCompressedData(file.view()) ? visitCompressed<T>(file.view(), pool, add)
+                                                              : parseRecordValues<T>(file.view(), add);
+            }
+        }
+    }
+
+    /**
+     * @brief Converts the three database files into the page file `pagesFilename`, one line
+     * (or, for compressed files, one block) at a time. Returns false if the page file cannot be written; problems with the text files are
+     * described in `loads` (songs, artists, albums), as when loading them.
+     */
+    inline bool convertToPageFile(const std::string& songsFilename, const std::string& artistsFilename,
+                                  const std::string& albumsFilename, const std::string& pagesFilename,
+                                  FileLoad (&loads)[3], std::string& error) {
+        PageFileWriter writer;
+        if (!writer.open(pagesFilename, error)) {
+            return false;
+        }
+        bool ok = true;
+        ThreadPool pool;
+        detail::convertFile<Song>(songsFilename, loads[0], pool, ok, [&](auto... fields) { ok = ok && writer.addSong(fields..., error); });
+        detail::convertFile<Artist>(artistsFilename, loads[1], pool, ok, [&](auto... fields) { ok = ok && writer.addArtist(fields..., error); });
+        detail::convertFile<Album>(albumsFilename, loads[2], pool, ok, [&](auto... fields) { ok = ok && writer.addAlbum(fields..., error); });
+        return ok && writer.finish(error);
+    }
+
+    /**
+     * @brief Fixed number of page frames over a page file, replaced with the CLOCK algorithm.
+     *
+     * A page enters the pool with its reference bit clear and only gets it on a later hit, so
+     * a scan over more pages than the pool holds cycles through the frames without evicting
+     * the pages that are used repeatedly. Not thread-safe.
+     */
+    class BufferPool {
+    public:
+        struct Stats {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+        };
+
+        /**
+         * @brief Keeps a page in its frame while held; `data()` is null if the page could not be read.
+         */
+        class Pin {
+        public:
+            Pin() = default;
+            Pin(BufferPool* pool, std::size_t frame) : pool(pool), frame(frame) {}
+            ~Pin() { release(); }
+
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+            Pin(Pin&& other) noexcept : pool(std::exchange(other.pool, nullptr)), frame(other.frame) {}
+            Pin& operator=(Pin&& other) noexcept {
+                if (this != &other) {
+                    release();
+                    pool = std::exchange(other.pool, nullptr);
+                    frame = other.frame;
+                }
+                return *this;
+            }
+
+            const char* data() const { return pool != nullptr ? pool->frameData(frame) : nullptr; }
+
+        private:
+            void release() {
+                if (pool != nullptr) {
+                    --pool->frames[frame].pins;
+                    pool = nullptr;
+                }
+            }
+
+            BufferPool* pool = nullptr;
+            std::size_t frame = 0;
+        };
+
+        BufferPool(std::size_t pageSize, std::size_t frameCount)
+            : pageSize(pageSize), memory(pageSize * frameCount), frames(frameCount) {}
+
+        bool open(const std::string& filename) {
+            file.open(filename, std::ios::binary);
+            return file.is_open();
+        }
+
+        Pin fetch(std::uint64_t page) {
+            auto found = table.find(page);
+            if (found != table.end()) {
+                Frame& frame = frames[found->second];
+                frame.referenced = true;
+                ++frame.pins;
+                ++stats.hits;
+                return Pin(this, found->second);
+            }
+            std::size_t victim;
+            if (!findVictim(victim)) {
+                return Pin();
+            }
+            Frame& frame = frames[victim];
+            if (frame.page != noPage) {
+                table.erase(frame.page);
+                frame.page = noPage;
+                ++stats.evictions;
+            }
+            file.seekg(static_cast<std::streamoff>(page * pageSize));
+            if (!file.read(frameData(victim), static_cast<std::streamsize>(pageSize))) {
+                file.clear();
+                return Pin();
+            }
+            frame = {page, 1, false};
+            table.emplace(page, victim);
+            ++stats.misses;
+            return Pin(this, victim);
+        }
+
+        std::size_t frameCount() const { return frames.size(); }
+        const Stats& getStats() const { return stats; }
+
+    private:
+        static constexpr std::uint64_t noPage = static_cast<std::uint64_t>(-1);
+
+        struct Frame {
+            std::uint64_t page = noPage;
+            std::uint32_t pins = 0;
+            bool referenced = false;
+        };
+
+        char* frameData(std::size_t frame) { return memory.data() + frame * pageSize; }
+
+        bool findVictim(std::size_t& victim) {
+            // Two sweeps clear every reference bit, so an unpinned frame is found if there is one
+            for (std::size_t step = 0; step < 2 * frames.size(); ++step) {
+                Frame& frame = frames[hand];
+                std::size_t candidate = hand;
+                hand = (hand + 1) % frames.size();
+                if (frame.pins != 0) {
+                    continue;
+                }
+                if (frame.referenced) {
+                    frame.referenced = false;
+                    continue;
+                }
+                victim = candidate;
+                return true;
+            }
+            return false;
+        }
+
+        std::size_t pageSize;
+        std::vector<char> memory;
+        std::vector<Frame> frames;
+        std::unordered_map<std::uint64_t, std::size_t> table;
+        std::size_t hand = 0;
+        std::ifstream file;
+        Stats stats;
+    };
+
+    /**
+     * @brief Read-only library over a page file. Records are visited section by section,
+     * fetching one page at a time from a buffer pool of at most `memoryBytes`.
+     */
+    class PagedLibrary {
+    public:
+        bool open(const std::string& filename, std::size_t memoryBytes, std::string& error) {
+            std::ifstream file(filename, std::ios::binary);
+            if (!file.is_open()) {
+                error = "cannot open " + filename;
+                return false;
+            }
+            std::error_code ec;
+            const std::uint64_t fileSize = std::filesystem::file_size(filename, ec);
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+                std::memcmp(header.magic, pageFileMagic, sizeof(header.magic)) != 0) {
+                error = filename + " is not a page file";
+                return false;
+            }
+            if (header.version != pageFileVersion || header.byteOrder != pageFileByteOrder) {
+                error = filename + " has an unsupported page file version or byte order";
+                return false;
+            }
+            if (header.pageSize < sizeof(header) || ec) {
+                error = filename + " is damaged";
+                return false;
+            }
+            for (const detail::PageRange& range : header.sections) {
+                if ((range.firstPage + range.pageCount) * header.pageSize > fileSize) {
+                    error = filename + " is truncated";
+                    return false;
+                }
+            }
+            if (!readDictionaries(file, error)) {
+                error = filename + ": " + error;
+                return false;
+            }
+            pool = std::make_unique<BufferPool>(header.pageSize, std::max<std::size_t>(memoryBytes / header.pageSize, 4));
+            if (!pool->open(filename)) {
+                error = "cannot open " + filename;
+                return false;
+            }
+            return true;
+        }
+
+        std::uint64_t songCount() const { return section(PagedSection::Songs).count; }
+        std::uint64_t artistCount() const { return section(PagedSection::Artists).count; }
+        std::uint64_t albumCount() const { return section(PagedSection::Albums).count; }
+
+        /**
+         * @brief Calls `visit(const SongView&)` for every song in file order until it returns false.
+         * Returns false if a page cannot be read or is damaged.
+         */
+        template <typename Visit>
+        bool scanSongs(Visit visit) {
+            return scan(PagedSection::Songs, [&](detail::PageReader& in, bool& stop) {
+                std::string_view title;
+                double duration;
+                StringId genre, artist;
+                if (!in.text(title) || !in.value(duration) || !in.value(genre) || !in.value(artist) ||
+                    !mapId(genres, genre) || !mapId(artists, artist)) {
+                    return false;
+                }
+                stop = !visit(SongView(title, duration, genre, artist));
+                return true;
+            });
+        }
+
+        template <typename Visit>
+        bool scanArtists(Visit visit) {
+            return scan(PagedSection::Artists, [&](detail::PageReader& in, bool& stop) {
+                StringId name, country, genre;
+                if (!in.value(name) || !in.value(country) || !in.value(genre) ||
+                    !mapId(artists, name) || !mapId(countries, country) || !mapId(genres, genre)) {
+                    return false;
+                }
+                stop = !visit(ArtistView(name, country, genre));
+                return true;
+            });
+        }
+
+        template <typename Visit>
+        bool scanAlbums(Visit visit) {
+            return scan(PagedSection::Albums, [&](detail::PageReader& in, bool& stop) {
+                std::string_view name;
+                StringId artist, genre;
+                std::int32_t year;
+                double rating;
+                if (!in.text(name) || !in.value(artist) || !in.value(year) || !in.value(rating) || !in.value(genre) ||
+                    !mapId(artists, artist) || !mapId(genres, genre)) {
+                    return false;
+                }
+                stop = !visit(AlbumView(name, artist, year, rating, genre));
+                return true;
+            });
+        }
+
+        const BufferPool& bufferPool() const { return *pool; }
+
+    private:
+        const detail::PageRange& section(PagedSection which) const { return header.sections[static_cast<std::size_t>(which)]; }
+
+        template <typename Decode>
+        bool scan(PagedSection which, Decode decode) {
+            const detail::PageRange& range = section(which);
+            bool stop = false;
+            for (std::uint64_t page = range.firstPage; page < range.firstPage + range.pageCount && !stop; ++page) {
+                BufferPool::Pin pin = pool->fetch(page);
+                if (pin.data() == nullptr) {
+                    return false;
+                }
+                detail::PageHeader pageHeader;
+                std::memcpy(&pageHeader, pin.data(), sizeof(pageHeader));
+                if (pageHeader.bytes < sizeof(pageHeader) || pageHeader.bytes > header.pageSize) {
+                    return false;
+                }
+                detail::PageReader in(pin.data() + sizeof(pageHeader), pin.data() + pageHeader.bytes);
+                for (std::uint32_t i = 0; i < pageHeader.records && !stop; ++i) {
+                    if (!decode(in, stop)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Interns the stored names and remembers which process ID each stored ID maps to.
+         */
+        bool readDictionaries(std::ifstream& file, std::string& error) {
+            const detail::PageRange& range = section(PagedSection::Dictionaries);
+            std::string bytes(range.count, '\0');
+            file.seekg(static_cast<std::streamoff>(range.firstPage * header.pageSize));
+            if (range.count > range.pageCount * header.pageSize || !file.read(&bytes[0], static_cast<std::streamsize>(bytes.size()))) {
+                error = "cannot read the dictionaries";
+                return false;
+            }
+            detail::PageReader in(bytes.data(), bytes.data() + bytes.size());
+            std::vector<StringId>* maps[] = {&genres, &artists, &countries};
+            StringDictionary* dictionaries[] = {&genreDictionary(), &artistDictionary(), &countryDictionary()};
+            for (int i = 0; i < 3; ++i) {
+                std::uint32_t count;
+                if (!in.value(count)) {
+                    error = "damaged dictionaries";
+                    return false;
+                }
+                maps[i]->reserve(count);
+                for (std::uint32_t id = 0; id < count; ++id) {
+                    std::uint32_t length;
+                    if (!in.value(length) || length > bytes.size()) {
+                        error = "damaged dictionaries";
+                        return false;
+                    }
+                    std::string name(length, '\0');
+                    for (char& c : name) {
+                        if (!in.value(c)) {
+                            error = "damaged dictionaries";
+                            return false;
+                        }
+                    }
+                    maps[i]->push_back(dictionaries[i]->intern(name));
+                }
+            }
+            return true;
+        }
+
+        static bool mapId(const std::vector<StringId>& map, StringId& id) {
+            if (id >= map.size()) {
+                return false;
+            }
+            id = map[id];
+            return true;
+        }
+
+        detail::PageFileHeader header{};
+        std::vector<StringId> genres;
+        std::vector<StringId> artists;
+        std::vector<StringId> countries;
+        std::unique_ptr<BufferPool> pool;
+    };
+
+    /**
+     * @brief Runs batch commands (see `batch.h`) against a paged library. Every query is a scan
+     * of the pages involved; commands that change the library or need an in-memory index
+     * are rejected. `complete` returns prefix matches in file order rather than alphabetically.
+     * Returns the number of lines that could not be executed.
+     */
+    inline std::size_t runPagedBatch(std::istream& in, PagedLibrary& library, OutputBuffer& out, BatchFormat format) {
+        detail::RecordPrinter print(out, format);
+        std::size_t failures = 0;
+        std::size_t lineNumber = 0;
+        std::string line;
+        auto fail = [&](const std::string& message) {
+            out.flush();
+            std::cerr << "Error - line " << lineNumber << ": " << message << std::endl;
+            ++failures;
+        };
+
+        while (std::getline(in, line)) {
+            ++lineNumber;
+            std::string_view command, args;
+            if (!detail::splitCommand(line, command, args)) {
+                continue;
+            }
+            bool read = true;
+            if (command == "songs") {
+                read = library.scanSongs([&](const SongView& song) { print.song(song); return true; });
+            } else if (command == "artists") {
+                read = library.scanArtists([&](const ArtistView& artist) { print.artist(artist); return true; });
+            } else if (command == "albums") {
+                read = library.scanAlbums([&](const AlbumView& album) { print.album(album); return true; });
+            } else if (command == "by-artist" || command == "by-genre") {
+                const bool byArtist = command == "by-artist";
+                const StringId key = (byArtist ? artistDictionary() : genreDictionary()).find(args);
+                if (key == StringDictionary::notFound) {
+                    continue;
+                }
+                read = library.scanSongs([&](const SongView& song) {
+                    if ((byArtist ? song.getArtistId() : song.getGenreId()) == key) {
+                        print.song(song);
+                    }
+                    return true;
+                }) && library.scanAlbums([&](const AlbumView& album) {
+                    if ((byArtist ? album.getArtistId() : album.getGenreId()) == key) {
+                        print.album(album);
+                    }
+                    return true;
+                });
+            } else if (command == "rank") {
+                std::size_t count = 0;
+                if (!detail::parseNumber(args, count) || count == 0) {
+                    fail("rank needs a count in paged mode");
+                    continue;
+                }
+                // Keep the best `count` albums seen so far; only their names are copied.
+                // File order breaks the remaining ties, as the row does in `ranking.h`.
+                struct Ranked {
+                    std::string name;
+                    std::size_t row;
+                    StringId artist;
+                    int year;
+                    double rating;
+                    StringId genre;
+                };
+                auto better = [](const Ranked& a, const Ranked& b) {
+                    if (a.rating != b.rating) {
+                        return a.rating > b.rating;
+                    }
+                    if (a.year != b.year) {
+                        return a.year > b.year;
+                    }
+                    if (a.name != b.name) {
+                        return a.name < b.name;
+                    }
+                    return a.row < b.row;
+                };
+                std::vector<Ranked> best;
+                std::size_t row = 0;
+                read = library.scanAlbums([&](const AlbumView& album) {
+                    ++row;
+                    if (best.size() == count) {
+                        // A later album never beats an equal one, so ties with the worst are skipped
+                        const Ranked& worst = best.front();
+                        if (album.getRating() < worst.rating ||
+                            (album.getRating() == worst.rating && (album.getYear() < worst.year ||
+                             (album.getYear() == worst.year && album.getName() >= worst.name)))) {
+                            return true;
+                        }
+                        std::pop_heap(best.begin(), best.end(), better);
+                        best.pop_back();
+                    }
+                    best.push_back({std::string(album.getName()), row, album.getArtistId(), album.getYear(), album.getRating(), album.getGenreId()});
+                    std::push_heap(best.begin(), best.end(), better);
+                    return true;
+                });
+                std::sort_heap(best.begin(), best.end(), better);
+                for (const Ranked& album : best) {
+                    print.album(AlbumView(album.name, album.artist, album.year, album.rating, album.genre));
+                }
+            } else if (command == "search" || command == "complete") {
+                const bool prefix = command == "complete";
+                const std::string folded = detail::foldText(args);
+                const std::size_t limit = 10;
+                auto found = [&](std::string_view text) {
+                    return prefix ? detail::startsWithFolded(text, folded) : detail::findFolded(text, folded) != std::string_view::npos;
+                };
+                std::size_t shown = 0;
+                read = library.scanSongs([&](const SongView& song) {
+                    if (found(song.getTitle())) {
+                        print.song(song);
+                        ++shown;
+                    }
+                    return shown < limit;
+                });
+                shown = 0;
+                read = read && library.scanAlbums([&](const AlbumView& album) {
+                    if (found(album.getName())) {
+                        print.album(album);
+                        ++shown;
+                    }
+                    return shown < limit;
+                });
+                shown = 0;
+                read = read && library.scanArtists([&](const ArtistView& artist) {
+                    if (found(artist.getName())) {
+                        print.artist(artist);
+                        ++shown;
+                    }
+                    return shown < limit;
+                });
+            } else if (detail::isChangeCommand(command)) {
+                fail("a page file is read-only; change the text files instead");
+                continue;
+            } else {
+                fail("'" + std::string(command) + "' is not available in paged mode");
+                continue;
+            }
+            if (!read) {
+                fail("cannot read a page of the page file");
+            }
+        }
+        if (!out.flush()) {
+            std::cerr << "Error - cannot write the output!" << std::endl;
+            ++failures;
+        }
+        return failures;
+    }
+}
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * @file primary_key.h
+ * @brief Hash index from the primary key of a record to its rows: songs by (title, artist),
+ * albums by (name, artist), artists by name, as `RecordSchema<T>::Key` says.
+ *
+ * Open addressing with linear probing over 32-bit row numbers. The keys are read from the
+ * collection itself, so a slot costs 4 bytes. A removed record leaves a tombstone in its
+ * slot, so the probe sequences of the other keys stay intact; once live rows and tombstones
+ * fill three quarters of the slots (or tombstones alone a quarter), the table is rebuilt
+ * from its live slots.
+ *
+ * Lookups cost a probe sequence. The removed records stay in the collection until it is
+ * compacted, which renumbers every row after the first one erased: `eraseRows` looks up the
+ * slots of those rows by their keys, or sweeps the table when there are so many of them
+ * that the sweep is cheaper.
+ */
+#ifndef PRIMARY_KEY_H
+#define PRIMARY_KEY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "record_schema.h"
+
+namespace rc {
+    /**
+     * @brief Row number returned by key lookups that found nothing.
+     */
+    inline constexpr std::size_t noRow = static_cast<std::size_t>(-1);
+
+    template <typename Record>
+    class PrimaryKeyIndex {
+    public:
+        using Key = RecordKey<Record>;
+
+        /**
+         * @brief Indexes every row of `records`, which must not hold removed records.
+         */
+        void build(const std::vector<Record>& records) {
+            built = true;
+            slots.assign(capacityFor(records.size()), emptySlot);
+            live = records.size();
+            tombstones = 0;
+            for (std::size_t row = 0; row < records.size(); ++row) {
+                place(records[row], row);
+            }
+        }
+
+        bool isBuilt() const { return built; }
+
+        /**
+         * @brief Adds a row that was just appended to `records`.
+         */
+        void insert(const std::vector<Record>& records, std::size_t row) {
+            if (!built) {
+                return;
+            }
+            if ((live + tombstones + 1) * 4 > slots.size() * 3) {
+                rehash(records, live + 1);
+            }
+            place(records[row], row);
+            ++live;
+        }
+
+        /**
+         * @brief Nothing to do: a record is only replaced in place by one with the same key.
+         */
+        void replace(const std::vector<Record>&, std::size_t, const Record&) {}
+
+        /**
+         * @brief The first row holding `key`, or `noRow`. Scans `records` while the index is
+         * not built.
+         */
+        std::size_t find(const std::vector<Record>& records, const Key& key) const {
+            std::size_t found = noRow;
+            forEachRow(records, key, [&found](std::size_t row) { found = std::min(found, row); });
+            return found;
+        }
+
+        /**
+         * @brief Every row holding `key`, in ascending order.
+         */
+        std::vector<std::size_t> findAll(const std::vector<Record>& records, const Key& key) const {
+            std::vector<std::size_t> rows;
+            forEachRow(records, key, [&rows](std::size_t row) { rows.push_back(row); });
+            std::sort(rows.begin(), rows.end());
+            return rows;
+        }
+
+        /**
+         * @brief Turns the slot of a row whose record was removed into a tombstone. The row
+         * number stays taken until the rows are erased.
+         */
+        void remove(const std::vector<Record>& records, std::size_t row) {
+            if (!built) {
+                return;
+            }
+            slotOf(records[row], row) = tombstoneSlot;
+            --live;
+            if (++tombstones > slots.size() / 4) {
+                rehash(records, live);
+            }
+        }
+
+        /**
+         * @brief Renumbers the rows after the removed ones (sorted), whose slots are tombstones
+         * already. Must be called before the same stable erase is applied to `records`, whose
+         * rows give the keys to look the slots up by.
+         */
+        void eraseRows(const std::vector<Record>& records, const std::vector<std::size_t>& removedRows) {
+            if (!built || removedRows.empty()) {
+                return;
+            }
+            const std::size_t firstRemoved = removedRows.front();
+            // A lookup hashes a key and lands anywhere in the table, a sweep reads the slots in order
+            constexpr std::size_t lookupCost = 16;
+            if ((records.size() - firstRemoved) * lookupCost < slots.size()) {
+                std::size_t before = 0;   // removed rows before `row`
+                for (std::size_t row = firstRemoved; row < records.size(); ++row) {
+                    if (before < removedRows.size() && removedRows[before] == row) {
+                        ++before;
+                    } else {
+                        slotOf(records[row], row) = static_cast<std::uint32_t>(row - before + firstRow);
+                    }
+                }
+            } else {
+                // New slot value of every old row from the first removed one on, so each slot is one lookup
+                std::vector<std::uint32_t> renumbered(records.size() - firstRemoved);
+                std::size_t before = 0;
+                for (std::size_t row = firstRemoved; row < records.size(); ++row) {
+                    if (before < removedRows.size() && removedRows[before] == row) {
+                        renumbered[row - firstRemoved] = tombstoneSlot;
+                        ++before;
+                    } else {
+                        renumbered[row - firstRemoved] = static_cast<std::uint32_t>(row - before + firstRow);
+                    }
+                }
+                for (std::uint32_t& slot : slots) {
+                    if (slot != emptySlot && slot != tombstoneSlot && slot - firstRow >= firstRemoved) {
+                        slot = renumbered[slot - firstRow - firstRemoved];
+                    }
+                }
+            }
+        }
+
+        void clear() {
+            slots.clear();
+            live = 0;
+            tombstones = 0;
+            built = false;
+        }
+
+    private:
+        static constexpr std::uint32_t emptySlot = 0;
+        static constexpr std::uint32_t tombstoneSlot = 1;
+        static constexpr std::uint32_t firstRow = 2;   // a slot holds its row + 2
+
+        static std::size_t hashKey(const Key& key) { return RecordKeyHash<Record>()(key); }
+
+        /**
+         * @brief Calls `visit(row)` for every row holding `key`; scans `records` while the
+         * index is not built.
+         */
+        template <typename Visit>
+        void forEachRow(const std::vector<Record>& records, const Key& key, Visit visit) const {
+            if (!built) {
+                for (std::size_t row = 0; row < records.size(); ++row) {
+                    if (recordKey<Record>(records[row]) == key) {
+                        visit(row);
+                    }
+                }
+                return;
+            }
+            const std::size_t mask = slots.size() - 1;
+            for (std::size_t i = hashKey(key) & mask;; i = (i + 1) & mask) {
+                const std::uint32_t slot = slots[i];
+                if (slot == emptySlot) {
+                    return;
+                }
+                if (slot == tombstoneSlot) {
+                    continue;
+                }
+                const std::size_t row = slot - firstRow;
+                if (recordKey<Record>(records[row]) == key) {
+                    visit(row);
+                }
+            }
+        }
+
+        /**
+         * @brief The slot holding `row`, which holds `record`.
+         */
+        std::uint32_t& slotOf(const Record& record, std::size_t row) {
+            const std::size_t mask = slots.size() - 1;
+            std::size_t i = hashKey(recordKey<Record>(record)) & mask;
+            while (slots[i] != row + firstRow) {
+                i = (i + 1) & mask;
+            }
+            return slots[i];
+        }
+
+        void place(const Record& record, std::size_t row) {
+            const std::size_t mask = slots.size() - 1;
+            std::size_t i = hashKey(recordKey<Record>(record)) & mask;
+            while (slots[i] != emptySlot && slots[i] != tombstoneSlot) {
+                i = (i + 1) & mask;
+            }
+            if (slots[i] == tombstoneSlot) {
+                --tombstones;
+            }
+            slots[i] = static_cast<std::uint32_t>(row + firstRow);
+        }
+
+        static std::size_t capacityFor(std::size_t rows) {
+            std::size_t capacity = 16;
+            while (capacity < rows * 2) {
+                capacity *= 2;
+            }
+            return capacity;
+        }
+
+        /**
+         * @brief Rebuilds the table from its live slots, without tombstones, at a load factor
+         * of at most one half for `rows` rows.
+         */
+        void rehash(const std::vector<Record>& records, std::size_t rows) {
+            std::vector<std::uint32_t> old(capacityFor(rows), emptySlot);
+            old.swap(slots);
+            tombstones = 0;
+            for (std::uint32_t slot : old) {
+                if (slot != emptySlot && slot != tombstoneSlot) {
+                    place(records[slot - firstRow], slot - firstRow);
+                }
+            }
+        }
+
+        std::vector<std::uint32_t> slots;
+        std::size_t live = 0;
+        std::size_t tombstones = 0;
+        bool built = false;
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file query_cache.h
+ * @brief Bounded cache of query results (rows) keyed by the query, for filters, text searches
+ * and rankings that a front end repeats between rare edits.
+ *
+ * Every entry remembers the generation of the collection it was computed from. The library
+ * bumps a collection's generation on each add, upsert and remove, so invalidating is one
+ * increment: an entry whose generation no longer matches is dropped the next time it is
+ * looked up, or evicted with the least recently used ones once the cache is over its limit.
+ * Rows are stored as 32-bit numbers, like the posting lists of the indexes.
+ */
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "filter.h"
+
+namespace rc {
+    /**
+     * @brief Builds a cache key from the kind of a query and its parameters, as bytes.
+     */
+    class QueryKey {
+    public:
+        explicit QueryKey(char kind) : key(1, kind) {}
+
+        QueryKey& add(std::uint64_t value) {
+            key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            return *this;
+        }
+
+        QueryKey& add(double value) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return add(bits);
+        }
+
+        QueryKey& add(std::string_view text) {
+            add(static_cast<std::uint64_t>(text.size()));
+            key.append(text.data(), text.size());
+            return *this;
+        }
+
+        template <typename Field>
+        QueryKey& add(const std::vector<Condition<Field>>& filter) {
+            for (const auto& condition : filter) {
+                add(static_cast<std::uint64_t>(condition.field) << 32 | static_cast<std::uint64_t>(condition.op));
+                add(condition.number);
+                add(static_cast<std::uint64_t>(condition.id));
+            }
+            return *this;
+        }
+
+        const std::string& str() const { return key; }
+
+    private:
+        std::string key;
+    };
+
+    /**
+     * @brief Least recently used cache of row lists holding at most `limit` bytes (keys, rows
+     * and a fixed cost per entry). A limit of 0 turns it off. Lookups take a lock, so server
+     * threads querying the same library can share it.
+     *
+     * A copy starts empty with the same limit: generations only mean something for the
+     * library that counted them, and a copied library changes independently.
+     */
+    class QueryCache {
+    public:
+        QueryCache() = default;
+        QueryCache(const QueryCache& other) : limit(other.limitBytes()) {}
+
+        QueryCache& operator=(const QueryCache& other) {
+            if (this != &other) {
+                setLimit(other.limitBytes());
+                clear();
+            }
+            return *this;
+        }
+
+        void setLimit(std::size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            limit.store(bytes, std::memory_order_relaxed);
+            evict();
+        }
+
+        std::size_t limitBytes() const { return limit.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Copies the cached rows of `key` into `rows` if they were computed at `generation`.
+         */
+        bool find(const std::string& key, std::uint64_t generation, std::vector<std::size_t>& rows) {
+            if (limitBytes() == 0) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it == entries.end()) {
+                return false;
+            }
+            if (it->second->generation != generation) {
+                erase(it);
+                return false;
+            }
+            order.splice(order.begin(), order, it->second);
+            const std::vector<std::uint32_t>& cached = it->second->rows;
+            rows.assign(cached.begin(), cached.end());
+            return true;
+        }
+
+        /**
+         * @brief Caches `rows` as the result of `key` at `generation`, unless they alone exceed the limit.
+         */
+        void store(const std::string& key, std::uint64_t generation, const std::vector<std::size_t>& rows) {
+            if (limitBytes() == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                erase(it);
+            }
+            const std::size_t bytes = entryBytes(key.size(), rows.size());
+            if (bytes > limitBytes()) {
+                return;
+            }
+            order.push_front(Entry{key, generation, std::vector<std::uint32_t>(rows.begin(), rows.end()), bytes});
+            entries.emplace(order.front().key, order.begin());
+            used += bytes;
+            evict();
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+            order.clear();
+            used = 0;
+        }
+
+    private:
+        struct Entry {
+            std::string key;
+            std::uint64_t generation;
+            std::vector<std::uint32_t> rows;
+            std::size_t bytes;
+        };
+
+        using Entries = std::unordered_map<std::string_view, std::list<Entry>::iterator>;
+
+        static std::size_t entryBytes(std::size_t keySize, std::size_t rowCount) {
+            constexpr std::size_t perEntry = 128;   // list node, map node, vector and string headers
+            return perEntry + keySize + rowCount * sizeof(std::uint32_t);
+        }
+
+        void erase(Entries::iterator it) {
+            const std::list<Entry>::iterator entry = it->second;
+            used -= entry->bytes;
+            entries.erase(it);   // the map key views the entry's string, so the entry goes last
+            order.erase(entry);
+        }
+
+        void evict() {
+            while (used > limitBytes() && !order.empty()) {
+                erase(entries.find(order.back().key));
+            }
+        }
+
+        mutable std::mutex mutex;
+        std::list<Entry> order;   // most recently used first
+        Entries entries;
+        std::size_t used = 0;
+        std::atomic<std::size_t> limit{0};   // read without the lock to skip a disabled cache
+    };
+}
+
+#endif
@@ -0,0 +1,420 @@
+/**
+ * @file range_index.h
+ * @brief Sorted indexes over one numeric field (song duration, album year and rating) for
+ * range conditions such as `year >= 1995 and year <= 2005` or `duration < 3`.
+ *
+ * The values are kept sorted in one array with their rows in a parallel array, plus a fence
+ * array holding every 64th value. A lookup binary searches the fences, which are small
+ * enough to stay in cache, then one 64-value block at each end of the range, and the
+ * matching rows are one contiguous stretch of the row array.
+ *
+ * Changes do not shift the large arrays one entry at a time. New entries go to a small sorted
+ * delta, which a lookup searches as well, and an entry whose record changed value is marked
+ * dead in place and added again to the delta; the entry of a removed record is only marked
+ * dead. The delta is merged into the main arrays, and the dead entries dropped, in one linear
+ * pass once it holds more than max(256, sqrt(n)) entries, so an add, an upsert or a removal
+ * costs O(sqrt(n)) amortized instead of O(n). Erasing the removed rows renumbers the rows,
+ * which touches every entry anyway, and merges the delta in the same pass.
+ */
+#ifndef RANGE_INDEX_H
+#define RANGE_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "filter.h"
+
+namespace rc {
+    /**
+     * @brief Interval of values allowed by the conditions of a filter on one field.
+     */
+    struct ValueRange {
+        double low = -std::numeric_limits<double>::infinity();
+        double high = std::numeric_limits<double>::infinity();
+        bool lowInclusive = true;
+        bool highInclusive = true;
+
+        /**
+         * @brief Intersects the range with `value op number`.
+         */
+        void narrow(Compare op, double number) {
+            if (std::isnan(number)) {
+                // Nothing compares true with NaN
+                low = std::numeric_limits<double>::infinity();
+                high = -low;
+                return;
+            }
+            switch (op) {
+                case Compare::Less: narrowHigh(number, false); break;
+                case Compare::LessEqual: narrowHigh(number, true); break;
+                case Compare::Greater: narrowLow(number, false); break;
+                case Compare::GreaterEqual: narrowLow(number, true); break;
+                case Compare::Equal: narrowLow(number, true); narrowHigh(number, true); break;
+            }
+        }
+
+    private:
+        void narrowLow(double number, bool inclusive) {
+            if (number > low || (number == low && !inclusive)) {
+                low = number;
+                lowInclusive = inclusive;
+            }
+        }
+
+        void narrowHigh(double number, bool inclusive) {
+            if (number < high || (number == high && !inclusive)) {
+                high = number;
+                highInclusive = inclusive;
+            }
+        }
+    };
+
+    /**
+     * @brief The range allowed for `field` by every condition of `filter` on it.
+     */
+    template <typename Field>
+    ValueRange filterRange(const std::vector<Condition<Field>>& filter, Field field) {
+        ValueRange range;
+        for (const auto& condition : filter) {
+            if (condition.field == field) {
+                range.narrow(condition.op, condition.number);
+            }
+        }
+        return range;
+    }
+
+    /**
+     * @brief Rows whose value lies in a range: a stretch of the main arrays and one of the delta
+     * of a range index, each in value order. Rows of the main stretch marked with `deadRow`
+     * belong to entries whose record has since changed value, and match nothing.
+     */
+    struct RangeRows {
+        static constexpr std::uint32_t deadRow = std::uint32_t(1) << 31;
+
+        const std::uint32_t* first = nullptr;
+        const std::uint32_t* last = nullptr;
+        const std::uint32_t* deltaFirst = nullptr;
+        const std::uint32_t* deltaLast = nullptr;
+
+        std::size_t size() const { return static_cast<std::size_t>((last - first) + (deltaLast - deltaFirst)); }
+    };
+
+    /**
+     * @brief Sorted index over the `Value` that `Getter` returns for each record of a vector.
+     *
+     * Entries are ordered by value, then by row, in the main arrays and in the delta (see the
+     * file comment). Rows are kept in step with the vector through `insert` (after an append),
+     * `replace` (after a record was replaced in place), `remove` (after a record was removed)
+     * and `eraseRows` (before the removed rows are erased), like the other indexes of the
+     * library. Until `build` is called they do nothing.
+     */
+    template <typename Record, typename Value>
+    class RangeIndex {
+    public:
+        using Getter = Value (*)(const Record&);
+
+        explicit RangeIndex(Getter getter) : getter(getter) {}
+
+        void build(const std::vector<Record>& records) {
+            built = true;
+            std::vector<std::pair<Value, std::uint32_t>> entries(records.size());
+            for (std::size_t row = 0; row < records.size(); ++row) {
+                entries[row] = {getter(records[row]), static_cast<std::uint32_t>(row)};
+            }
+            std::sort(entries.begin(), entries.end());
+            values.resize(entries.size());
+            rows.resize(entries.size());
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                values[i] = entries[i].first;
+                rows[i] = entries[i].second;
+            }
+            deltaValues.clear();
+            deltaRows.clear();
+            dead = 0;
+            rebuildFences(0);
+        }
+
+        bool isBuilt() const { return built; }
+
+        /**
+         * @brief Adds a row that was just appended to `records`; it sorts last among its equals.
+         */
+        void insert(const std::vector<Record>& records, std::size_t row) {
+            if (!built) {
+                return;
+            }
+            addToDelta(getter(records[row]), row);
+        }
+
+        /**
+         * @brief Moves `row` after `old` was replaced in place by `records[row]`.
+         */
+        void replace(const std::vector<Record>& records, std::size_t row, const Record& old) {
+            if (!built) {
+                return;
+            }
+            const Value oldValue = getter(old);
+            const Value value = getter(records[row]);
+            if (value == oldValue) {
+                return;
+            }
+            drop(oldValue, row);
+            addToDelta(value, row);
+        }
+
+        /**
+         * @brief Drops the entry of a row whose record was removed; the row number stays
+         * taken until the rows are erased.
+         */
+        void remove(const std::vector<Record>& records, std::size_t row) {
+            if (!built) {
+                return;
+            }
+            drop(getter(records[row]), row);
+            if (deltaRows.size() + dead > deltaLimit()) {
+                merge({});
+            }
+        }
+
+        /**
+         * @brief Renumbers the rows after the removed ones (sorted), whose entries are dead
+         * already, and merges the delta, in one pass over the entries. Only the fences from the
+         * first entry that moved are refreshed.
+         */
+        void eraseRows(const std::vector<Record>&, const std::vector<std::size_t>& removedRows) {
+            if (!built || removedRows.empty()) {
+                return;
+            }
+            merge(removedRows);
+        }
+
+        void clear() {
+            built = false;
+            values.clear();
+            rows.clear();
+            fences.clear();
+            deltaValues.clear();
+            deltaRows.clear();
+            dead = 0;
+        }
+
+        /**
+         * @brief The rows whose value lies in `range`.
+         */
+        RangeRows find(const ValueRange& range) const {
+            auto belowLow = [&](Value v) {
+                const double value = static_cast<double>(v);
+                return range.lowInclusive ? value < range.low : value <= range.low;
+            };
+            auto notAboveHigh = [&](Value v) {
+                const double value = static_cast<double>(v);
+                return range.highInclusive ? value <= range.high : value < range.high;
+            };
+            RangeRows found;
+            const std::size_t first = partitionPoint(belowLow);
+            const std::size_t last = partitionPoint(notAboveHigh);
+            if (first < last) {
+                found.first = rows.data() + first;
+                found.last = rows.data() + last;
+            }
+            auto deltaFirst = std::partition_point(deltaValues.begin(), deltaValues.end(), belowLow);
+            auto deltaLast = std::partition_point(deltaValues.begin(), deltaValues.end(), notAboveHigh);
+            if (deltaFirst < deltaLast) {
+                found.deltaFirst = deltaRows.data() + (deltaFirst - deltaValues.begin());
+                found.deltaLast = deltaRows.data() + (deltaLast - deltaValues.begin());
+            }
+            return found;
+        }
+
+    private:
+        static constexpr std::size_t fenceStride = 64;
+
+        /**
+         * @brief First position whose value fails `before`, which must hold for a prefix of the values.
+         */
+        template <typename Before>
+        std::size_t partitionPoint(Before before) const {
+            const std::size_t block = static_cast<std::size_t>(std::partition_point(fences.begin(), fences.end(), before) - fences.begin());
+            // Fence `block` (if any) fails, fence `block - 1` holds: the answer is between them
+            const std::size_t from = block == 0 ? 0 : (block - 1) * fenceStride;
+            const std::size_t to = std::min(values.size(), block * fenceStride);
+            return static_cast<std::size_t>(std::partition_point(values.begin() + static_cast<std::ptrdiff_t>(from),
+                                                                 values.begin() + static_cast<std::ptrdiff_t>(to), before) - values.begin());
+        }
+
+        /**
+         * @brief Position of (`value`, `row`) in the (value, row) order of `inValues` and
+         * `inRows`, which are the main arrays or the delta. Dead marks are ignored.
+         */
+        static std::size_t position(const std::vector<Value>& inValues, const std::vector<std::uint32_t>& inRows, Value value,
+                                    std::size_t row) {
+            auto equal = std::equal_range(inValues.begin(), inValues.end(), value);
+            auto from = inRows.begin() + (equal.first - inValues.begin());
+            auto to = inRows.begin() + (equal.second - inValues.begin());
+            auto before = [](std::uint32_t entry, std::size_t target) { return (entry & ~RangeRows::deadRow) < target; };
+            return static_cast<std::size_t>(std::lower_bound(from, to, row, before) - inRows.begin());
+        }
+
+        /**
+         * @brief Entries the delta and the dead marks may reach before a merge.
+         */
+        std::size_t deltaLimit() const {
+            return std::max<std::size_t>(256, static_cast<std::size_t>(std::sqrt(static_cast<double>(values.size()))));
+        }
+
+        /**
+         * @brief Takes the entry (`value`, `row`) out of the delta, or marks it dead in the main arrays.
+         */
+        void drop(Value value, std::size_t row) {
+            const std::size_t inDelta = position(deltaValues, deltaRows, value, row);
+            if (inDelta < deltaRows.size() && deltaRows[inDelta] == row && deltaValues[inDelta] == value) {
+                deltaValues.erase(deltaValues.begin() + static_cast<std::ptrdiff_t>(inDelta));
+                deltaRows.erase(deltaRows.begin() + static_cast<std::ptrdiff_t>(inDelta));
+            } else {
+                rows[position(values, rows, value, row)] |= RangeRows::deadRow;
+                ++dead;
+            }
+        }
+
+        void addToDelta(Value value, std::size_t row) {
+            const std::size_t at = position(deltaValues, deltaRows, value, row);
+            deltaValues.insert(deltaValues.begin() + static_cast<std::ptrdiff_t>(at), value);
+            deltaRows.insert(deltaRows.begin() + static_cast<std::ptrdiff_t>(at), static_cast<std::uint32_t>(row));
+            if (deltaRows.size() + dead > deltaLimit()) {
+                merge({});
+            }
+        }
+
+        /**
+         * @brief Merges the delta into the main arrays, dropping the dead entries and the
+         * `removedRows` (sorted) and renumbering the rows after those.
+         */
+        void merge(const std::vector<std::size_t>& removedRows) {
+            // New row of an entry, or `gone` if it goes away
+            constexpr std::uint32_t gone = std::numeric_limits<std::uint32_t>::max();
+            auto renumber = [&](std::uint32_t row) {
+                if ((row & RangeRows::deadRow) != 0) {
+                    return gone;
+                }
+                if (removedRows.empty() || row < removedRows.front()) {
+                    return row;
+                }
+                auto below = std::lower_bound(removedRows.begin(), removedRows.end(), static_cast<std::size_t>(row));
+                if (below != removedRows.end() && *below == row) {
+                    return gone;
+                }
+                return static_cast<std::uint32_t>(row - static_cast<std::size_t>(below - removedRows.begin()));
+            };
+            // Without a delta the entries only move down, and are compacted in place
+            const bool inPlace = deltaValues.empty();
+            std::vector<Value> mergedValues;
+            std::vector<std::uint32_t> mergedRows;
+            if (!inPlace) {
+                mergedValues.resize(values.size() + deltaValues.size());
+                mergedRows.resize(rows.size() + deltaRows.size());
+            }
+            std::vector<Value>& outValues = inPlace ? values : mergedValues;
+            std::vector<std::uint32_t>& outRows = inPlace ? rows : mergedRows;
+            std::size_t firstMoved = values.size();   // the first position whose value may differ from before
+            std::size_t out = 0;
+            std::size_t i = 0;
+            std::size_t j = 0;
+            while (i < values.size() || j < deltaValues.size()) {
+                // Entries of equal value and row cannot be in both: a row lives in one place at a time
+                const bool fromDelta = i == values.size() ||
+                    (j < deltaValues.size() && (deltaValues[j] < values[i] ||
+                                                (deltaValues[j] == values[i] && deltaRows[j] < (rows[i] & ~RangeRows::deadRow))));
+                const Value value = fromDelta ? deltaValues[j] : values[i];
+                const std::uint32_t row = renumber(fromDelta ? deltaRows[j++] : rows[i++]);
+                if (row == gone || fromDelta) {
+                    firstMoved = std::min(firstMoved, out);
+                }
+                if (row != gone) {
+                    outValues[out] = value;
+                    outRows[out++] = row;
+                }
+            }
+            if (!inPlace) {
+                values.swap(mergedValues);
+                rows.swap(mergedRows);
+            }
+            values.resize(out);
+            rows.resize(out);
+            deltaValues.clear();
+            deltaRows.clear();
+            dead = 0;
+            rebuildFences(firstMoved / fenceStride);
+        }
+
+        /**
+         * @brief Refreshes the fences from block `from` on, after the entries there moved.
+         */
+        void rebuildFences(std::size_t from) {
+            fences.resize((values.size() + fenceStride - 1) / fenceStride);
+            for (std::size_t block = from; block < fences.size(); ++block) {
+                fences[block] = values[block * fenceStride];
+            }
+        }
+
+        Getter getter;
+        std::vector<Value> values;
+        std::vector<std::uint32_t> rows;
+        std::vector<Value> fences;   // values[0], values[64], values[128], ...
+        std::vector<Value> deltaValues;
+        std::vector<std::uint32_t> deltaRows;
+        std::size_t dead = 0;        // entries of the main arrays marked with `RangeRows::deadRow`
+        bool built = false;
+    };
+
+    namespace detail {
+        /**
+         * @brief A range index is only read when its range holds less than one record in this
+         * many; for wider ranges the random accesses cost more than a sequential scan.
+         */
+        inline constexpr std::size_t rangeSelectivity = 16;
+
+        /**
+         * @brief Fills `rows` with the records matching `filter`, in collection order, taking
+         * the candidates from the narrowest of `ranges` and checking the whole filter on each.
+         * Returns false, leaving `rows` alone, when that range is too wide to beat a scan.
+         */
+        template <typename Record, typename Filter>
+        bool selectFromRange(const std::vector<Record>& records, const Filter& filter,
+                             std::initializer_list<RangeRows> ranges, std::vector<std::size_t>& rows) {
+            RangeRows narrowest{nullptr, nullptr};
+            bool found = false;
+            for (const RangeRows& range : ranges) {
+                if (!found || range.size() < narrowest.size()) {
+                    narrowest = range;
+                    found = true;
+                }
+            }
+            if (!found || narrowest.size() * rangeSelectivity >= records.size()) {
+                return false;
+            }
+            std::vector<std::uint32_t> candidates;
+            candidates.reserve(narrowest.size());
+            for (const std::uint32_t* row = narrowest.first; row != narrowest.last; ++row) {
+                if ((*row & RangeRows::deadRow) == 0) {
+                    candidates.push_back(*row);
+                }
+            }
+            candidates.insert(candidates.end(), narrowest.deltaFirst, narrowest.deltaLast);
+            std::sort(candidates.begin(), candidates.end());
+            rows.clear();
+            for (std::uint32_t row : candidates) {
+                if (matches(records[row], filter)) {
+                    rows.push_back(row);
+                }
+            }
+            return true;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file ranking.h
+ * @brief Album ranking: best rating first, then the newer album, then by name.
+ * Provides a one-off top-K selection and a live ordered index kept up to date on add and remove.
+ */
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "album.h"
+#include "row_remap.h"
+
+namespace rc {
+    /**
+     * @brief Ranking order over album rows. Ties on every key fall back to the row number,
+     * so the ranking is deterministic.
+     */
+    class AlbumRankOrder {
+    public:
+        explicit AlbumRankOrder(const std::vector<Album>& albums) : albums(&albums) {}
+
+        bool operator()(std::size_t left, std::size_t right) const {
+            return before((*albums)[left], left, (*albums)[right], right);
+        }
+
+        /**
+         * @brief Whether album `a` at row `left` ranks before album `b` at row `right`.
+         */
+        static bool before(const Album& a, std::size_t left, const Album& b, std::size_t right) {
+            if (a.getRating() != b.getRating()) {
+                return a.getRating() > b.getRating();
+            }
+            if (a.getYear() != b.getYear()) {
+                return a.getYear() > b.getYear();
+            }
+            int byName = a.getName().compare(b.getName());
+            if (byName != 0) {
+                return byName < 0;
+            }
+            return left < right;
+        }
+
+    private:
+        const std::vector<Album>* albums;
+    };
+
+    /**
+     * @brief Returns the rows of the `k` best albums in ranking order (all albums if `k` is 0).
+     *
+     * Only row numbers are moved around, and just the first `k` of them are fully sorted,
+     * so the cost is O(n + k log k) instead of copying and sorting the whole collection.
+     */
+    inline std::vector<std::size_t> topAlbums(const std::vector<Album>& albums, std::size_t k) {
+        std::vector<std::size_t> rows(albums.size());
+        for (std::size_t row = 0; row < rows.size(); ++row) {
+            rows[row] = row;
+        }
+        AlbumRankOrder order(albums);
+        if (k == 0 || k >= rows.size()) {
+            std::sort(rows.begin(), rows.end(), order);
+            return rows;
+        }
+        std::nth_element(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(k), rows.end(), order);
+        rows.resize(k);
+        std::sort(rows.begin(), rows.end(), order);
+        return rows;
+    }
+
+    /**
+     * @brief Album rows kept permanently in ranking order.
+     *
+     * An add or a remove is a binary search plus one insertion into or erase from a vector of
+     * row numbers, erasing removed rows is a single renumbering pass, and reading the top `k`
+     * costs O(k).
+     */
+    class AlbumRanking {
+    public:
+        void build(const std::vector<Album>& albums) {
+            ranked = topAlbums(albums, 0);
+        }
+
+        /**
+         * @brief Inserts a row that is not ranked yet, such as one just appended to `albums`.
+         */
+        void insert(const std::vector<Album>& albums, std::size_t row) {
+            auto at = std::upper_bound(ranked.begin(), ranked.end(), row, AlbumRankOrder(albums));
+            ranked.insert(at, row);
+        }
+
+        /**
+         * @brief Moves `row` after `old`, the album it was ranked as, was replaced in place by `albums[row]`.
+         */
+        void replace(const std::vector<Album>& albums, std::size_t row, const Album& old) {
+            const Album& album = albums[row];
+            if (album.getRating() == old.getRating() && album.getYear() == old.getYear() && album.getName() == old.getName()) {
+                return;
+            }
+            auto at = std::lower_bound(ranked.begin(), ranked.end(), row, [&](std::size_t other, std::size_t) {
+                return AlbumRankOrder::before(other == row ? old : albums[other], other, old, row);
+            });
+            ranked.erase(at);
+            insert(albums, row);
+        }
+
+        /**
+         * @brief Takes out a row whose album was removed; the row number stays taken until the
+         * rows are erased.
+         */
+        void remove(const std::vector<Album>& albums, std::size_t row) {
+            ranked.erase(std::lower_bound(ranked.begin(), ranked.end(), row, AlbumRankOrder(albums)));
+        }
+
+        void eraseRows(const std::vector<Album>&, const std::vector<std::size_t>& removedRows) {
+            detail::remapRows(ranked, removedRows);
+        }
+
+        void clear() { ranked.clear(); }
+
+        /**
+         * @brief Returns the first `k` rows of the ranking (all of them if `k` is 0).
+         */
+        std::vector<std::size_t> top(std::size_t k) const {
+            std::size_t count = k == 0 ? ranked.size() : std::min(k, ranked.size());
+            return std::vector<std::size_t>(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(count));
+        }
+
+        std::size_t size() const { return ranked.size(); }
+
+    private:
+        std::vector<std::size_t> ranked;
+    };
+}
+
+#endif
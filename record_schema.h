@@ -0,0 +1,276 @@
+/**
+ * @file record_schema.h
+ * @brief Compile-time description of the fields of songs, artists and albums, in the order of
+ * the database files and of the record constructors.
+ *
+ * `RecordSchema<T>::fields()` is a tuple of field descriptors. Code that handles every field
+ * the same way (the text parsers and writers, the journal, the JSON output) walks the tuple
+ * with the helpers below instead of spelling out each record type: the walk is unrolled at
+ * compile time and the kind of each field is a template parameter, so the generated code is
+ * the same as the hand-written copies it replaces, without any dispatch at run time.
+ *
+ * `RecordSchema<T>::Key` lists the positions of the fields forming the primary key of `T`.
+ * The primary key index, the keyed removals and the upserts take their keys from it (see
+ * `recordKey`), so they are written once for every record type.
+ */
+#ifndef RECORD_SCHEMA_H
+#define RECORD_SCHEMA_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    enum class FieldKind {
+        Text,      // free text kept in the text arena (song titles, album names)
+        Number,    // `double` or `int`, written as text by the stream operators
+        Name       // interned in a dictionary and stored as its ID
+    };
+
+    /**
+     * @brief One field of a record. `get` reads it from a record or from a paged view of one.
+     */
+    template <FieldKind Kind, typename ValueType, typename Get>
+    struct FieldSchema {
+        using Value = ValueType;
+        static constexpr FieldKind kind = Kind;
+
+        std::string_view name;
+        Get get;
+        const char* invalid = nullptr;                   // numbers: error for a text that does not parse
+        StringDictionary& (*dictionary)() = nullptr;     // names
+        bool repeats = true;                             // names: the same name appears on many records
+    };
+
+    template <typename Get>
+    constexpr FieldSchema<FieldKind::Text, std::string_view, Get> textField(std::string_view name, Get get) {
+        return {name, get};
+    }
+
+    template <typename T, typename Get>
+    constexpr FieldSchema<FieldKind::Number, T, Get> numberField(std::string_view name, const char* invalid, Get get) {
+        return {name, get, invalid};
+    }
+
+    template <typename Get>
+    constexpr FieldSchema<FieldKind::Name, StringId, Get> nameField(std::string_view name, StringDictionary& (*dictionary)(),
+                                                                    Get get, bool repeats = true) {
+        return {name, get, nullptr, dictionary, repeats};
+    }
+
+    template <typename T>
+    struct RecordSchema;
+
+    template <>
+    struct RecordSchema<Song> {
+        static constexpr std::string_view name = "song";
+        using Key = std::index_sequence<0, 3>;   // title, artist
+
+        static constexpr auto fields() {
+            return std::make_tuple(
+                textField("title", [](const auto& song) { return song.getTitle(); }),
+                numberField<double>("duration", "invalid duration", [](const auto& song) { return song.getDuration(); }),
+                nameField("genre", genreDictionary, [](const auto& song) { return song.getGenreId(); }),
+                nameField("artist", artistDictionary, [](const auto& song) { return song.getArtistId(); }));
+        }
+    };
+
+    template <>
+    struct RecordSchema<Artist> {
+        static constexpr std::string_view name = "artist";
+        using Key = std::index_sequence<0>;      // name
+
+        static constexpr auto fields() {
+            return std::make_tuple(
+                // Artist names are unique in their file, so parsers do not remember them
+                nameField("name", artistDictionary, [](const auto& artist) { return artist.getNameId(); }, false),
+                nameField("country", countryDictionary, [](const auto& artist) { return artist.getCountryId(); }),
+                nameField("genre", genreDictionary, [](const auto& artist) { return artist.getGenreId(); }));
+        }
+    };
+
+    template <>
+    struct RecordSchema<Album> {
+        static constexpr std::string_view name = "album";
+        using Key = std::index_sequence<0, 1>;   // name, artist
+
+        static constexpr auto fields() {
+            return std::make_tuple(
+                textField("name", [](const auto& album) { return album.getName(); }),
+                nameField("artist", artistDictionary, [](const auto& album) { return album.getArtistId(); }),
+                numberField<int>("year", "invalid year", [](const auto& album) { return album.getYear(); }),
+                numberField<double>("rating", "invalid rating", [](const auto& album) { return album.getRating(); }),
+                nameField("genre", genreDictionary, [](const auto& album) { return album.getGenreId(); }));
+        }
+    };
+
+    /**
+     * @brief The kind of a field, from the type of its descriptor (e.g. `decltype(field)`).
+     */
+    template <typename Field>
+    inline constexpr FieldKind kindOf = std::decay_t<Field>::kind;
+
+    template <typename T>
+    using RecordFields = decltype(RecordSchema<T>::fields());
+
+    template <typename T>
+    inline constexpr std::size_t fieldCount = std::tuple_size_v<RecordFields<T>>;
+
+    template <typename T, std::size_t I>
+    using FieldAt = std::tuple_element_t<I, RecordFields<T>>;
+
+    /**
+     * @brief The values of a record, in schema order: what its constructor takes.
+     */
+    template <typename T, typename Indexes = std::make_index_sequence<fieldCount<T>>>
+    struct RecordValuesOf;
+
+    template <typename T, std::size_t... I>
+    struct RecordValuesOf<T, std::index_sequence<I...>> {
+        using type = std::tuple<typename FieldAt<T, I>::Value...>;
+    };
+
+    template <typename T>
+    using RecordValues = typename RecordValuesOf<T>::type;
+
+    /**
+     * @brief Position of the field called `name`, or `fieldCount<T>` if there is none.
+     */
+    template <typename T>
+    constexpr std::size_t fieldIndex(std::string_view name) {
+        const auto names = std::apply([](const auto&... field) { return std::array<std::string_view, fieldCount<T>>{field.name...}; },
+                                      RecordSchema<T>::fields());
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) {
+                return i;
+            }
+        }
+        return fieldCount<T>;
+    }
+
+    /**
+     * @brief Calls `visit(field)` for every field of `T`, in order.
+     */
+    template <typename T, typename Visit>
+    void forEachField(Visit&& visit) {
+        std::apply([&](const auto&... field) { (visit(field), ...); }, RecordSchema<T>::fields());
+    }
+
+    /**
+     * @brief Calls `visit(field, value)` for every field of `record` (a `T` or a view of one), in order.
+     */
+    template <typename T, typename Record, typename Visit>
+    void forEachValue(const Record& record, Visit&& visit) {
+        forEachField<T>([&](const auto& field) { visit(field, field.get(record)); });
+    }
+
+    /**
+     * @brief Field by field equality; names compare by ID.
+     */
+    template <typename T>
+    bool sameRecord(const T& a, const T& b) {
+        return std::apply([&](const auto&... field) { return ((field.get(a) == field.get(b)) && ...); }, RecordSchema<T>::fields());
+    }
+
+    namespace detail {
+        template <std::size_t... I>
+        constexpr std::array<std::size_t, sizeof...(I)> positionsOf(std::index_sequence<I...>) {
+            return {I...};
+        }
+    }
+
+    /**
+     * @brief Positions of the primary key fields of `T`, and their number.
+     */
+    template <typename T>
+    inline constexpr auto keyFields = detail::positionsOf(typename RecordSchema<T>::Key());
+
+    template <typename T>
+    inline constexpr std::size_t keySize = keyFields<T>.size();
+
+    /**
+     * @brief A primary key as the user gives it: the text of each key field, names spelled out.
+     */
+    template <typename T>
+    using KeyText = std::array<std::string, keySize<T>>;
+
+    namespace detail {
+        /**
+         * @brief The value of a key field given as text; a name that was never interned becomes
+         * `StringDictionary::notFound`, which no record holds.
+         */
+        template <typename Field>
+        auto keyValue(const Field& field, std::string_view text) {
+            static_assert(kindOf<Field> != FieldKind::Number, "key fields are text or names");
+            if constexpr (kindOf<Field> == FieldKind::Name) {
+                return field.dictionary().find(text);
+            } else {
+                return text;
+            }
+        }
+
+        inline std::size_t hashKeyValue(std::string_view text) { return std::hash<std::string_view>()(text); }
+        inline std::size_t hashKeyValue(StringId id) { return (static_cast<std::size_t>(id) + 1) * 0x9e3779b97f4a7c15ull; }
+
+        template <typename T, typename Positions = std::make_index_sequence<keySize<T>>>
+        struct RecordKeyOf;
+
+        template <typename T, std::size_t... J>
+        struct RecordKeyOf<T, std::index_sequence<J...>> {
+            using Type = std::tuple<typename FieldAt<T, keyFields<T>[J]>::Value...>;
+
+            template <typename Record>
+            static Type of(const Record& record) {
+                const auto fields = RecordSchema<T>::fields();
+                return Type(std::get<keyFields<T>[J]>(fields).get(record)...);
+            }
+
+            template <typename Text>
+            static Type ofText(const std::array<Text, keySize<T>>& text) {
+                const auto fields = RecordSchema<T>::fields();
+                return Type(keyValue(std::get<keyFields<T>[J]>(fields), text[J])...);
+            }
+        };
+    }
+
+    /**
+     * @brief The values of the primary key fields of a record, e.g. (title, artist ID) for a song.
+     */
+    template <typename T>
+    using RecordKey = typename detail::RecordKeyOf<T>::Type;
+
+    template <typename T, typename Record>
+    RecordKey<T> recordKey(const Record& record) {
+        return detail::RecordKeyOf<T>::of(record);
+    }
+
+    /**
+     * @brief The key of the records whose key fields read `text` (strings or string views).
+     */
+    template <typename T, typename Text>
+    RecordKey<T> recordKeyOfText(const std::array<Text, keySize<T>>& text) {
+        return detail::RecordKeyOf<T>::ofText(text);
+    }
+
+    /**
+     * @brief Hash of a primary key. Every field is hashed: titles repeat a lot across artists,
+     * and hashing the title alone would give all of them the same hash.
+     */
+    template <typename T>
+    struct RecordKeyHash {
+        std::size_t operator()(const RecordKey<T>& key) const {
+            return std::apply([](const auto&... value) { return (detail::hashKeyValue(value) ^ ...); }, key);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file row_remap.h
+ * @brief Renumbering of stored row numbers after rows were erased from a collection, the
+ * same erase applied to per-row data, and the set of rows removed but not erased yet.
+ * Shared by every index that refers to records by their position in a vector.
+ */
+#ifndef ROW_REMAP_H
+#define ROW_REMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rc {
+    namespace detail {
+        /**
+         * @brief Applies a stable erase of `removedRows` (sorted) to a list of row numbers.
+         *
+         * Removed rows are dropped and every other row moves down by the number of removed
+         * rows before it. The order of the entries in `rows` is preserved. `Row` may be a
+         * narrower unsigned type for indexes that store many row numbers.
+         */
+        template <typename Row>
+        void remapRows(std::vector<Row>& rows, const std::vector<std::size_t>& removedRows) {
+            if (removedRows.empty()) {
+                return;
+            }
+            std::size_t kept = 0;
+            for (Row row : rows) {
+                auto below = std::lower_bound(removedRows.begin(), removedRows.end(), static_cast<std::size_t>(row));
+                if (below != removedRows.end() && *below == row) {
+                    continue;
+                }
+                rows[kept++] = static_cast<Row>(row - static_cast<std::size_t>(below - removedRows.begin()));
+            }
+            rows.resize(kept);
+        }
+
+        /**
+         * @brief Stable erase of `removedRows` (sorted) from one column.
+         */
+        template <typename T>
+        void eraseColumnRows(std::vector<T>& column, const std::vector<std::size_t>& removedRows) {
+            if (removedRows.empty()) {
+                return;
+            }
+            std::size_t kept = removedRows.front();
+            std::size_t next = 0;
+            for (std::size_t row = removedRows.front(); row < column.size(); ++row) {
+                if (next < removedRows.size() && removedRows[next] == row) {
+                    ++next;
+                    continue;
+                }
+                column[kept++] = column[row];
+            }
+            column.resize(kept);
+        }
+    }
+
+    /**
+     * @brief Rows of a collection whose records were removed but are still in the vector, one
+     * bit per row, until a compaction erases them all at once (see `Library::compact`).
+     */
+    class RemovedRows {
+    public:
+        bool contains(std::size_t row) const {
+            return row / 64 < words.size() && ((words[row / 64] >> (row % 64)) & 1u) != 0;
+        }
+
+        /**
+         * @brief Marks `row` as removed; it must not be marked already.
+         */
+        void add(std::size_t row) {
+            if (row / 64 >= words.size()) {
+                words.resize(row / 64 + 1, 0);
+            }
+            words[row / 64] |= std::uint64_t(1) << (row % 64);
+            ++total;
+        }
+
+        std::size_t count() const { return total; }
+        bool empty() const { return total == 0; }
+
+        /**
+         * @brief The removed rows in ascending order.
+         */
+        std::vector<std::size_t> rows() const {
+            std::vector<std::size_t> result;
+            result.reserve(total);
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                std::size_t row = i * 64;
+                for (std::uint64_t word = words[i]; word != 0; word >>= 1, ++row) {
+                    if ((word & 1u) != 0) {
+                        result.push_back(row);
+                    }
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief Drops the removed rows from a list of rows, keeping the order of the others.
+         */
+        void dropFrom(std::vector<std::size_t>& list) const {
+            if (total != 0) {
+                list.erase(std::remove_if(list.begin(), list.end(), [this](std::size_t row) { return contains(row); }), list.end());
+            }
+        }
+
+        /**
+         * @brief Applies a stable erase of `removedRows` (sorted) to the set, like `remapRows`.
+         */
+        void eraseRows(const std::vector<std::size_t>& removedRows) {
+            std::vector<std::size_t> remaining = rows();
+            detail::remapRows(remaining, removedRows);
+            clear();
+            for (std::size_t row : remaining) {
+                add(row);
+            }
+        }
+
+        void clear() {
+            words.clear();
+            total = 0;
+        }
+
+    private:
+        std::vector<std::uint64_t> words;
+        std::size_t total = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file secondary_index.h
+ * @brief Index from an interned key (artist, genre, ...) to the rows of a collection holding it.
+ * Keys are dictionary IDs, so the index is a dense table addressed directly by ID.
+ * Posting lists are kept in ascending row order, so results come out in collection order.
+ * `FieldIndex` keeps one over a name field of a record type in step with its collection.
+ */
+#ifndef SECONDARY_INDEX_H
+#define SECONDARY_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "record_schema.h"
+#include "row_remap.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    class SecondaryIndex {
+    public:
+        /**
+         * @brief Records that `row` holds `key`. Rows must be added in increasing order.
+         */
+        void add(StringId key, std::size_t row) {
+            if (key >= postings.size()) {
+                postings.resize(static_cast<std::size_t>(key) + 1);
+            }
+            if (postings[key].empty()) {
+                ++keys;
+            }
+            postings[key].push_back(row);
+        }
+
+        /**
+         * @brief Returns the rows holding `key`, or an empty list (also for `StringDictionary::notFound`).
+         */
+        const std::vector<std::size_t>& find(StringId key) const {
+            static const std::vector<std::size_t> none;
+            return key < postings.size() ? postings[key] : none;
+        }
+
+        /**
+         * @brief Moves `row` from the rows holding `from` to those holding `to`, keeping both
+         * lists in ascending order. Used when a record is replaced in place.
+         */
+        void move(StringId from, StringId to, std::size_t row) {
+            if (from == to) {
+                return;
+            }
+            remove(from, row);
+            if (to >= postings.size()) {
+                postings.resize(static_cast<std::size_t>(to) + 1);
+            }
+            std::vector<std::size_t>& rows = postings[to];
+            if (rows.empty()) {
+                ++keys;
+            }
+            rows.insert(std::lower_bound(rows.begin(), rows.end(), row), row);
+        }
+
+        /**
+         * @brief Takes `row` out of the rows holding `key`, without renumbering any other row.
+         */
+        void remove(StringId key, std::size_t row) {
+            std::vector<std::size_t>& rows = postings[key];
+            rows.erase(std::lower_bound(rows.begin(), rows.end(), row));
+            if (rows.empty()) {
+                rows.shrink_to_fit();
+                --keys;
+            }
+        }
+
+        /**
+         * @brief Drops the removed rows and renumbers the remaining ones (see `row_remap.h`).
+         */
+        void eraseRows(const std::vector<std::size_t>& removedRows) {
+            if (removedRows.empty()) {
+                return;
+            }
+            for (std::vector<std::size_t>& rows : postings) {
+                if (rows.empty()) {
+                    continue;
+                }
+                detail::remapRows(rows, removedRows);
+                if (rows.empty()) {
+                    rows.shrink_to_fit();
+                    --keys;
+                }
+            }
+        }
+
+        void clear() {
+            postings.clear();
+            keys = 0;
+        }
+
+        std::size_t keyCount() const { return keys; }
+
+    private:
+        std::vector<std::vector<std::size_t>> postings;
+        std::size_t keys = 0;
+    };
+
+    /**
+     * @brief The rows of a collection of `Record` by the name field at `Field` of its schema,
+     * such as the songs by artist.
+     */
+    template <typename Record, std::size_t Field>
+    class FieldIndex : public SecondaryIndex {
+    public:
+        static_assert(kindOf<FieldAt<Record, Field>> == FieldKind::Name, "a field index is keyed by a name field");
+
+        void build(const std::vector<Record>& records) {
+            clear();
+            for (std::size_t row = 0; row < records.size(); ++row) {
+                insert(records, row);
+            }
+        }
+
+        /**
+         * @brief Adds a row that was just appended to `records`.
+         */
+        void insert(const std::vector<Record>& records, std::size_t row) { add(keyOf(records[row]), row); }
+
+        /**
+         * @brief Moves `row` after `old` was replaced in place by `records[row]`.
+         */
+        void replace(const std::vector<Record>& records, std::size_t row, const Record& old) {
+            move(keyOf(old), keyOf(records[row]), row);
+        }
+
+        /**
+         * @brief Takes out a row whose record was removed; its row number stays taken until
+         * the rows are erased.
+         */
+        void remove(const std::vector<Record>& records, std::size_t row) { SecondaryIndex::remove(keyOf(records[row]), row); }
+
+        void eraseRows(const std::vector<Record>&, const std::vector<std::size_t>& removedRows) {
+            SecondaryIndex::eraseRows(removedRows);
+        }
+
+    private:
+        static StringId keyOf(const Record& record) { return std::get<Field>(RecordSchema<Record>::fields()).get(record); }
+    };
+}
+
+#endif
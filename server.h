@@ -0,0 +1,505 @@
+/**
+ * @file server.h
+ * @brief Server mode: one process owns the library and answers many clients over a Unix
+ * domain socket.
+ *
+ * Clients send the batch commands of `batch.h`, one per line. Each response is the command's
+ * output lines (errors and warnings as `Error - ...` / `Warning - ...` lines) followed by one
+ * empty line.
+ *
+ * Concurrency: `VersionedLibrary` keeps two copies of the library. Queries take a reference
+ * to the published copy and run on it without any lock; a copy is never modified while a
+ * reader holds it. Changes are serialized: the writer applies them to the other copy,
+ * publishes it, and replays them on the old copy once its last reader is gone, sleeping
+ * until then. A writer therefore never blocks readers, and readers never block each other,
+ * at the price of keeping the library twice in memory. A reply is built in memory and only
+ * sent once its query has let go of the library, so a client that stops reading cannot
+ * keep a version pinned.
+ *
+ * A client that pipelines removals gets them coalesced: the consecutive removals of the same
+ * kind that have already arrived on its connection are made with one `changeAll`, so a run
+ * of them waits for the readers and publishes a version once instead of once per removal.
+ * Each still gets its own reply.
+ *
+ * A removal only marks its records as removed (see `Library::removeSong`). Erasing them,
+ * which renumbers the rows, is left to a maintenance thread: after each change it compacts
+ * the copy no reader holds once that copy needs it, so no request waits for a compaction.
+ * The same thread folds the journal into the database files from that copy once the journal
+ * has grown enough (see `VersionedLibrary::setJournalCompaction`), so it does not grow until
+ * the server stops; only the changes arriving meanwhile wait for it.
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "batch.h"
+#include "journal.h"
+#include "library.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace rc {
+    /**
+     * @brief Two copies of a library: lock-free snapshots for readers, serialized changes
+     * for writers (see the file comment).
+     */
+    class VersionedLibrary {
+    public:
+        /**
+         * @brief Takes over `library`. Changes are logged to `journal` (if not null) once,
+         * however many copies they are applied to.
+         */
+        VersionedLibrary(Library library, Journal* journal) : journal(journal) {
+            library.attachJournal(nullptr);
+            library.setAutoCompact(false);
+            standby = std::make_shared<Library>(library);
+            published = std::make_shared<Library>(std::move(library));
+            maintainer = std::thread([this] { maintain(); });
+        }
+
+        ~VersionedLibrary() {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+                stopping = true;
+            }
+            maintenanceDue.notify_all();
+            maintainer.join();
+        }
+
+        VersionedLibrary(const VersionedLibrary&) = delete;
+        VersionedLibrary& operator=(const VersionedLibrary&) = delete;
+
+        /**
+         * @brief The current version. It stays valid and unchanged for as long as it is held.
+         */
+        std::shared_ptr<const Library> snapshot() const {
+            auto lease = std::make_shared<Lease>(*this);
+            lease->library = std::atomic_load(&published);
+            return std::shared_ptr<const Library>(lease, lease->library.get());
+        }
+
+        /**
+         * @brief Applies one change and publishes it. Returns false for an add whose key exists
+         * already and a removal that matched nothing.
+         */
+        bool change(const JournalEntry& entry) {
+            return changeAll({entry}).front();
+        }
+
+        /**
+         * @brief Applies the changes with `Library::changeAll` and publishes them as one version.
+         * Returns, per entry, whether it changed anything.
+         */
+        std::vector<bool> changeAll(const std::vector<JournalEntry>& entries) {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            catchUp();
+            std::vector<bool> changed = standby->applyAll(entries);
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                if (changed[i] && journal != nullptr) {
+                    journal->append(entries[i]);
+                }
+            }
+            standby = std::atomic_exchange(&published, std::move(standby));
+            for (const JournalEntry& entry : entries) {
+                behind.push_back(entry);
+                behind.back().storeTextIn(behindText);
+            }
+            ++changes;
+            maintenanceDue.notify_one();
+            return changed;
+        }
+
+        /**
+         * @brief Has the maintenance thread call `fold(library)` with the latest version, under
+         * the write lock and on the copy no reader holds, whenever `due()` is true after a
+         * change. `fold` writes the library to the database files and restarts the journal;
+         * it may compact the library but must not change its records.
+         */
+        void setJournalCompaction(std::function<bool()> due, std::function<void(Library&)> fold) {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            journalDue = std::move(due);
+            foldJournal = std::move(fold);
+        }
+
+        /**
+         * @brief Calls `visit(library)` with the latest version, under the write lock and on the
+         * copy no reader holds, e.g. to save it. `visit` may compact the library but must not
+         * change its records.
+         */
+        template <typename Visit>
+        void withLatest(Visit visit) {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            catchUp();
+            visit(*standby);
+        }
+
+    private:
+        /**
+         * @brief A reader's hold on a version. Readers only reach a version through a lease,
+         * so dropping the last one can wake the writer waiting for that version.
+         */
+        struct Lease {
+            explicit Lease(const VersionedLibrary& owner) : owner(owner) {}
+
+            ~Lease() {
+                std::lock_guard<std::mutex> lock(owner.releaseMutex);
+                library.reset();
+                if (owner.writerWaiting) {
+                    owner.released.notify_all();
+                }
+            }
+
+            const VersionedLibrary& owner;
+            std::shared_ptr<Library> library;
+        };
+
+        /**
+         * @brief Brings `standby` up to date with the published copy once no reader holds it.
+         * Must be called under `writeMutex`.
+         */
+        void catchUp() {
+            waitForReaders();
+            standby->applyAll(behind);
+            behind.clear();
+            behindText.clear();
+        }
+
+        /**
+         * @brief The maintenance thread: after each change, folds the journal if it is due and
+         * compacts `standby` if either copy needs it. A copy that is published when it needs
+         * compaction is compacted the next time it is the standby one.
+         */
+        void maintain() {
+            std::unique_lock<std::mutex> lock(writeMutex);
+            for (std::size_t seen = 0;;) {
+                maintenanceDue.wait(lock, [&] { return stopping || changes != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = changes;
+                const bool fold = journalDue && journalDue();
+                if (fold || standby->needsCompaction() || std::atomic_load(&published)->needsCompaction()) {
+                    catchUp();
+                    if (fold) {
+                        foldJournal(*standby);
+                    }
+                    if (standby->needsCompaction()) {
+                        standby->compact();
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Sleeps until no reader holds `standby`, the copy published before the previous change.
+         */
+        void waitForReaders() {
+            std::unique_lock<std::mutex> lock(releaseMutex);
+            writerWaiting = true;
+            released.wait(lock, [this] { return standby.use_count() == 1; });
+            writerWaiting = false;
+        }
+
+        std::shared_ptr<Library> published;
+        std::shared_ptr<Library> standby;        // only touched under `writeMutex`
+        std::vector<JournalEntry> behind;        // changes `standby` has not seen yet
+        TextArena behindText;                    // the text of the records in `behind`
+        std::mutex writeMutex;
+        std::condition_variable maintenanceDue;   // signaled under `writeMutex` after each change
+        std::size_t changes = 0;                  // calls of `changeAll`, only touched under `writeMutex`
+        bool stopping = false;                    // likewise
+        std::function<bool()> journalDue;         // likewise, see `setJournalCompaction`
+        std::function<void(Library&)> foldJournal;
+        std::thread maintainer;
+        mutable std::mutex releaseMutex;
+        mutable std::condition_variable released;
+        mutable bool writerWaiting = false;      // only touched under `releaseMutex`
+        Journal* journal;
+    };
+
+    namespace detail {
+        inline volatile std::sig_atomic_t serverStopRequested = 0;
+
+        inline void requestServerStop(int) { serverStopRequested = 1; }
+
+#ifndef _WIN32
+        /**
+         * @brief Splits what a client sends into lines, reading the socket in large blocks.
+         */
+        class SocketLineReader {
+        public:
+            explicit SocketLineReader(int fd) : fd(fd) {}
+
+            bool readLine(std::string& line) {
+                for (;;) {
+                    std::size_t end = buffer.find('\n', start);
+                    if (end != std::string::npos) {
+                        line.assign(buffer, start, end - start);
+                        start = end + 1;
+                        return true;
+                    }
+                    buffer.erase(0, start);
+                    start = 0;
+                    char block[1 << 16];
+                    ssize_t got = ::recv(fd, block, sizeof(block), 0);
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (got <= 0) {
+                        return false;   // a last line without '\n' is an incomplete request
+                    }
+                    buffer.append(block, static_cast<std::size_t>(got));
+                }
+            }
+
+            /**
+             * @brief The next line if it has already been received, without taking it. Never
+             * waits for the client; the view is valid until the next `readLine`.
+             */
+            bool peekLine(std::string_view& line) const {
+                std::size_t end = buffer.find('\n', start);
+                if (end == std::string::npos) {
+                    return false;
+                }
+                line = std::string_view(buffer).substr(start, end - start);
+                return true;
+            }
+
+        private:
+            int fd;
+            std::string buffer;
+            std::size_t start = 0;
+        };
+
+        inline bool sendAll(int fd, const char* data, std::size_t size) {
+            while (size > 0) {
+                ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent <= 0) {
+                    return false;
+                }
+                data += sent;
+                size -= static_cast<std::size_t>(sent);
+            }
+            return true;
+        }
+#endif
+    }
+
+    /**
+     * @brief Accepts clients on a Unix domain socket and serves each one on its own thread.
+     */
+    class LibraryServer {
+    public:
+        LibraryServer(VersionedLibrary& library, BatchFormat format) : library(library), format(format) {}
+
+        /**
+         * @brief Listens on `socketPath` until SIGINT or SIGTERM, then closes every connection.
+         * Returns false if the socket cannot be set up.
+         */
+        bool run(const std::string& socketPath, std::string& error) {
+#ifdef _WIN32
+            (void)socketPath;
+            error = "server mode needs Unix domain sockets";
+            return false;
+#else
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (socketPath.size() >= sizeof(address.sun_path)) {
+                error = "socket path too long: " + socketPath;
+                return false;
+            }
+            std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+            // A socket file left behind by a previous server that was killed
+            struct stat info;
+            if (::stat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+                ::unlink(socketPath.c_str());
+            }
+            int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                ::listen(listener, SOMAXCONN) != 0) {
+                error = "cannot listen on " + socketPath + ": " + std::strerror(errno);
+                if (listener >= 0) {
+                    ::close(listener);
+                }
+                return false;
+            }
+
+            detail::serverStopRequested = 0;
+            auto previousInt = std::signal(SIGINT, detail::requestServerStop);
+            auto previousTerm = std::signal(SIGTERM, detail::requestServerStop);
+            std::cerr << "Serving on " << socketPath << " (Ctrl+C stops the server)" << std::endl;
+
+            while (!detail::serverStopRequested) {
+                pollfd waiting{listener, POLLIN, 0};
+                // Wake up regularly to notice the stop request and to reap finished connections
+                if (::poll(&waiting, 1, 200) > 0) {
+                    int client = ::accept(listener, nullptr, nullptr);
+                    if (client >= 0) {
+                        std::lock_guard<std::mutex> lock(connectionsMutex);
+                        connections.emplace_back();
+                        Connection& connection = connections.back();
+                        connection.fd = client;
+                        connection.thread = std::thread([this, &connection] { serve(connection); });
+                    }
+                }
+                reapConnections(false);
+            }
+
+            ::close(listener);
+            ::unlink(socketPath.c_str());
+            {
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                for (Connection& connection : connections) {
+                    ::shutdown(connection.fd, SHUT_RDWR);
+                }
+            }
+            reapConnections(true);
+            std::signal(SIGINT, previousInt);
+            std::signal(SIGTERM, previousTerm);
+            std::cerr << "Served " << requests.load() << " request(s) from " << clients << " client(s)." << std::endl;
+            return true;
+#endif
+        }
+
+    private:
+        struct Connection {
+            int fd = -1;
+            std::thread thread;
+            std::atomic<bool> done{false};
+        };
+
+#ifndef _WIN32
+        void serve(Connection& connection) {
+            const int fd = connection.fd;
+            // The reply is collected here and sent after the query, which must not wait on the client
+            std::string reply;
+            OutputBuffer out([&reply](const char* data, std::size_t size) {
+                reply.append(data, size);
+                return true;
+            }, 1 << 16);
+            detail::RecordPrinter print(out, format);
+            detail::SocketLineReader reader(fd);
+            // The records of changes are parsed here and copied by the library
+            TextArena scratch;
+            TextArena::Scope parsing(scratch);
+            auto warn = [&out](const std::string& message) { out << "Warning - " << message << '\n'; };
+            std::string line;
+            bool connected = true;
+            while (connected && reader.readLine(line)) {
+                std::string_view command, args;
+                if (detail::splitCommand(line, command, args)) {
+                    std::string error;
+                    if (detail::isChangeCommand(command)) {
+                        JournalEntry entry;
+                        if (!detail::parseChange(command, args, entry, error)) {
+                            out << "Error - " << error << '\n';
+                        } else if (isRemoval(entry.op)) {
+                            std::vector<JournalEntry> removals = pendingRemovals(reader, std::move(entry));
+                            std::vector<bool> changed = library.changeAll(removals);
+                            for (std::size_t i = 0; i < removals.size(); ++i) {
+                                if (!changed[i]) {
+                                    warn(detail::missedRemoval(removals[i]));
+                                }
+                                if (i + 1 < removals.size()) {
+                                    out << '\n';   // the reply of every removal but the last, which ends below
+                                    ++requests;
+                                }
+                            }
+                        } else if (!library.change(entry)) {
+                            out << "Error - " << detail::existingKey(entry) << '\n';
+                        }
+                        scratch.clear();
+                    } else {
+                        std::shared_ptr<const Library> snapshot = library.snapshot();
+                        if (!runQuery(*snapshot, command, args, print, error, warn)) {
+                            out << "Error - " << error << '\n';
+                        }
+                    }
+                }
+                out << '\n';
+                out.flush();
+                connected = detail::sendAll(fd, reply.data(), reply.size());
+                reply.clear();
+                if (reply.capacity() > (std::size_t(1) << 24)) {
+                    std::string().swap(reply);   // do not keep the memory of one huge reply
+                }
+                ++requests;
+            }
+            ::close(fd);
+            connection.done = true;
+        }
+
+        /**
+         * @brief `first`, followed by the removals of the same kind that the client has already
+         * sent after it, taken from `reader`. Stops at anything else, which is read as usual.
+         */
+        static std::vector<JournalEntry> pendingRemovals(detail::SocketLineReader& reader, JournalEntry first) {
+            std::vector<JournalEntry> removals;
+            removals.push_back(std::move(first));
+            std::string_view next, command, args;
+            std::string line, error;
+            while (removals.size() < maxCoalescedRemovals && reader.peekLine(next)) {
+                JournalEntry entry;
+                if (!detail::splitCommand(next, command, args) || !detail::isChangeCommand(command) ||
+                    !detail::parseChange(command, args, entry, error) || entry.op != removals.front().op) {
+                    break;
+                }
+                removals.push_back(std::move(entry));
+                reader.readLine(line);
+            }
+            return removals;
+        }
+
+        /**
+         * @brief Joins the threads of closed connections (of all connections with `all`).
+         */
+        void reapConnections(bool all) {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            for (auto it = connections.begin(); it != connections.end();) {
+                if (all || it->done) {
+                    it->thread.join();
+                    it = connections.erase(it);
+                    ++clients;
+                } else {
+                    ++it;
+                }
+            }
+        }
+#endif
+
+        VersionedLibrary& library;
+        BatchFormat format;
+        std::list<Connection> connections;   // a list, so connection threads can keep references
+        std::mutex connectionsMutex;
+        std::atomic<std::size_t> requests{0};
+        std::size_t clients = 0;
+
+        static constexpr std::size_t maxCoalescedRemovals = 1024;   // bounds the wait for the first reply
+    };
+}
+
+#endif
@@ -0,0 +1,512 @@
+/**
+ * @file snapshot.h
+ * @brief Versioned binary snapshot of the songs, artists and albums collections.
+ *
+ * A snapshot is meant to be memory-mapped and turned back into records without parsing.
+ * It mirrors the records in memory: genres, artist names and countries are stored once per
+ * snapshot in a name section each, and the records refer to them by 32-bit positions, like
+ * the dictionary IDs of `string_dictionary.h`. Numeric fields are fixed-width columns and
+ * the free text (titles, album names) is an offset column into a per-section string pool.
+ *
+ * Layout (native byte order, every block aligned to 8 bytes):
+ * - header: magic `RCSNAPSH`, format version, byte-order marker, section count
+ * - section table: kind, offset and size of each section
+ * - genre, artist name and country sections: rows, pool size, offsets[rows + 1], pool
+ * - song, artist and album sections: rows, pool size, then one column per field in the order
+ *   of `record_schema.h` (`double` or `int32` for numbers, `uint32` name positions, and
+ *   offsets[rows + 1] for text), then the pool of the text fields
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "song.h"
+#include "artist.h"
+#include "album.h"
+#include "mapped_file.h"
+#include "record_schema.h"
+#include "string_dictionary.h"
+
+namespace rc {
+    constexpr char snapshotMagic[8] = {'R', 'C', 'S', 'N', 'A', 'P', 'S', 'H'};
+    constexpr std::uint32_t snapshotVersion = 2;
+    constexpr std::uint32_t snapshotByteOrder = 0x01020304;
+
+    enum class SnapshotSection : std::uint32_t {
+        Songs = 1,
+        Artists = 2,
+        Albums = 3,
+        Genres = 4,
+        ArtistNames = 5,
+        Countries = 6
+    };
+
+    namespace detail {
+        struct SnapshotHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint64_t sectionCount;
+        };
+
+        struct SnapshotSectionEntry {
+            std::uint32_t kind;
+            std::uint32_t reserved;
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        inline std::size_t alignTo8(std::size_t value) {
+            return (value + 7) & ~static_cast<std::size_t>(7);
+        }
+
+        /**
+         * @brief Builds one section in memory: header words, columns, then the string pool.
+         */
+        class SectionBuilder {
+        public:
+            explicit SectionBuilder(std::size_t rows) : rows(rows) {}
+
+            template <typename T>
+            void addColumn(const std::vector<T>& values) {
+                std::size_t bytes = values.size() * sizeof(T);
+                std::size_t at = columns.size();
+                columns.resize(alignTo8(at + bytes));
+                if (bytes != 0) {
+                    std::memcpy(columns.data() + at, values.data(), bytes);
+                }
+            }
+
+            /**
+             * @brief Appends a text column: `rows + 1` offsets into the pool.
+             */
+            template <typename Getter>
+            void addStringColumn(Getter getter) {
+                std::vector<std::uint64_t> offsets;
+                offsets.reserve(rows + 1);
+                for (std::size_t i = 0; i < rows; ++i) {
+                    offsets.push_back(pool.size());
+                    std::string_view text = getter(i);
+                    pool.append(text.data(), text.size());
+                }
+                offsets.push_back(pool.size());
+                addColumn(offsets);
+            }
+
+            void writeTo(std::vector<char>& out) const {
+                std::uint64_t header[2] = {rows, pool.size()};
+                std::size_t at = out.size();
+                out.resize(at + sizeof(header) + columns.size() + alignTo8(pool.size()));
+                std::memcpy(out.data() + at, header, sizeof(header));
+                at += sizeof(header);
+                if (!columns.empty()) {
+                    std::memcpy(out.data() + at, columns.data(), columns.size());
+                }
+                at += columns.size();
+                if (!pool.empty()) {
+                    std::memcpy(out.data() + at, pool.data(), pool.size());
+                }
+            }
+
+        private:
+            std::uint64_t rows;
+            std::vector<char> columns;
+            std::string pool;
+        };
+
+        /**
+         * @brief Bounds-checked view over one section of a mapped snapshot.
+         */
+        class SectionReader {
+        public:
+            SectionReader(const char* data, std::size_t size) : data(data), size(size) {
+                if (size >= 2 * sizeof(std::uint64_t)) {
+                    std::memcpy(&rowCount, data, sizeof(rowCount));
+                    std::memcpy(&poolSize, data + sizeof(std::uint64_t), sizeof(poolSize));
+                    at = 2 * sizeof(std::uint64_t);
+                    valid = rowCount < size;
+                } else {
+                    valid = false;
+                }
+            }
+
+            bool ok() const { return valid; }
+            std::size_t rows() const { return static_cast<std::size_t>(rowCount); }
+
+            template <typename T>
+            const T* column(std::size_t count) {
+                std::size_t bytes = count * sizeof(T);
+                if (!valid || bytes > size - at) {
+                    valid = false;
+                    return nullptr;
+                }
+                const T* values = reinterpret_cast<const T*>(data + at);
+                at = alignTo8(at + bytes);
+                if (at > size) {
+                    at = size;
+                }
+                return values;
+            }
+
+            /**
+             * @brief Locates the string pool; must be called after every column has been read.
+             */
+            const char* stringPool() {
+                if (!valid || poolSize > size - at) {
+                    valid = false;
+                    return nullptr;
+                }
+                return data + at;
+            }
+
+            /**
+             * @brief Checks that an offset column is non-decreasing and stays inside the pool.
+             */
+            bool checkOffsets(const std::uint64_t* offsets) {
+                if (!valid) {
+                    return false;
+                }
+                for (std::size_t i = 0; i < rows(); ++i) {
+                    if (offsets[i + 1] < offsets[i]) {
+                        return valid = false;
+                    }
+                }
+                return valid = offsets[rows()] <= poolSize;
+            }
+
+        private:
+            const char* data;
+            std::size_t size;
+            std::size_t at = 0;
+            std::uint64_t rowCount = 0;
+            std::uint64_t poolSize = 0;
+            bool valid = true;
+        };
+
+        inline std::string_view poolString(const char* pool, const std::uint64_t* offsets, std::size_t row) {
+            return std::string_view(pool + offsets[row], static_cast<std::size_t>(offsets[row + 1] - offsets[row]));
+        }
+
+        constexpr std::size_t snapshotNameKinds = 3;
+
+        /**
+         * @brief Position of a dictionary among the name sections: genres, artist names, countries.
+         */
+        inline std::size_t nameKind(StringDictionary& (*dictionary)()) {
+            return dictionary == &genreDictionary ? 0 : dictionary == &artistDictionary ? 1 : 2;
+        }
+
+        inline StringDictionary& nameDictionary(std::size_t kind) {
+            return kind == 0 ? genreDictionary() : kind == 1 ? artistDictionary() : countryDictionary();
+        }
+
+        /**
+         * @brief The names used by the records being written, numbered in order of first use.
+         */
+        class SnapshotNames {
+        public:
+            std::uint32_t position(std::size_t kind, StringId id) {
+                std::vector<std::uint32_t>& positions = positionOf[kind];
+                if (id >= positions.size()) {
+                    positions.resize(static_cast<std::size_t>(id) + 1, unused);
+                }
+                if (positions[id] == unused) {
+                    positions[id] = static_cast<std::uint32_t>(ids[kind].size());
+                    ids[kind].push_back(id);
+                }
+                return positions[id];
+            }
+
+            void writeSection(std::size_t kind, std::vector<char>& out) const {
+                const std::vector<StringId>& used = ids[kind];
+                SectionBuilder builder(used.size());
+                StringDictionary& dictionary = nameDictionary(kind);
+                builder.addStringColumn([&](std::size_t i) -> decltype(auto) { return dictionary.lookup(used[i]); });
+                builder.writeTo(out);
+            }
+
+        private:
+            static constexpr std::uint32_t unused = 0xFFFFFFFFu;
+
+            std::vector<std::uint32_t> positionOf[snapshotNameKinds];
+            std::vector<StringId> ids[snapshotNameKinds];
+        };
+
+        /**
+         * @brief Column type of a field in a record section.
+         */
+        template <typename Field>
+        using SnapshotColumn = std::conditional_t<kindOf<Field> == FieldKind::Text, std::uint64_t,
+                               std::conditional_t<kindOf<Field> == FieldKind::Name, std::uint32_t,
+                               std::conditional_t<std::is_integral_v<typename Field::Value>, std::int32_t, typename Field::Value>>>;
+
+        template <typename T>
+        void writeRecordSection(const std::vector<T>& records, SnapshotNames& names, std::vector<char>& out) {
+            SectionBuilder builder(records.size());
+            forEachField<T>([&](const auto& field) {
+                using Field = std::decay_t<decltype(field)>;
+                if constexpr (kindOf<Field> == FieldKind::Text) {
+                    builder.addStringColumn([&](std::size_t i) { return field.get(records[i]); });
+                } else {
+                    std::vector<SnapshotColumn<Field>> column;
+                    column.reserve(records.size());
+                    for (const T& record : records) {
+                        if constexpr (kindOf<Field> == FieldKind::Name) {
+                            column.push_back(names.position(nameKind(field.dictionary), field.get(record)));
+                        } else {
+                            column.push_back(static_cast<SnapshotColumn<Field>>(field.get(record)));
+                        }
+                    }
+                    builder.addColumn(column);
+                }
+            });
+            builder.writeTo(out);
+        }
+
+        /**
+         * @brief Reads a name section and interns every name once; `ids[i]` is the ID of name `i`.
+         */
+        inline bool readNameSection(SectionReader section, std::size_t kind, std::vector<StringId>& ids) {
+            const std::uint64_t* offsets = section.column<std::uint64_t>(section.rows() + 1);
+            const char* pool = section.stringPool();
+            if (!section.checkOffsets(offsets)) {
+                return false;
+            }
+            StringDictionary& dictionary = nameDictionary(kind);
+            ids.resize(section.rows());
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                ids[i] = dictionary.intern(poolString(pool, offsets, i));
+            }
+            return true;
+        }
+
+        /**
+         * @brief Locates and checks the columns of a record section, then turns its rows into records.
+         */
+        template <typename T, typename Indexes = std::make_index_sequence<fieldCount<T>>>
+        class RecordSectionReader;
+
+        template <typename T, std::size_t... I>
+        class RecordSectionReader<T, std::index_sequence<I...>> {
+        public:
+            RecordSectionReader(SectionReader section, const std::vector<StringId> (&names)[snapshotNameKinds])
+                : section(section), names(names), rows(this->section.rows()),
+                  // Braced initialization runs in order, so the columns are located one after the other
+                  columns{this->section.template column<SnapshotColumn<FieldAt<T, I>>>(kindOf<FieldAt<T, I>> == FieldKind::Text ? rows + 1 : rows)...},
+                  pool(this->section.stringPool()) {}
+
+            /**
+             * @brief True if every column is inside the section, every offset inside the pool
+             * and every name position inside its name section.
+             */
+            bool ok() {
+                constexpr auto schema = RecordSchema<T>::fields();
+                return section.ok() && (check(std::get<I>(schema), std::get<I>(columns)) && ...);
+            }
+
+            void appendTo(std::vector<T>& records) const {
+                constexpr auto schema = RecordSchema<T>::fields();
+                records.reserve(records.size() + rows);
+                for (std::size_t row = 0; row < rows; ++row) {
+                    records.emplace_back(value(std::get<I>(schema), std::get<I>(columns), row)...);
+                }
+            }
+
+        private:
+            template <typename Field, typename Column>
+            bool check(const Field& field, const Column* column) {
+                if constexpr (kindOf<Field> == FieldKind::Text) {
+                    return section.checkOffsets(column);
+                } else if constexpr (kindOf<Field> == FieldKind::Name) {
+                    const std::size_t count = names[nameKind(field.dictionary)].size();
+                    for (std::size_t row = 0; row < rows; ++row) {
+                        if (column[row] >= count) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }
+
+            template <typename Field, typename Column>
+            typename Field::Value value(const Field& field, const Column* column, std::size_t row) const {
+                if constexpr (kindOf<Field> == FieldKind::Text) {
+                    return poolString(pool, column, row);
+                } else if constexpr (kindOf<Field> == FieldKind::Name) {
+                    return names[nameKind(field.dictionary)][column[row]];
+                } else {
+                    return static_cast<typename Field::Value>(column[row]);
+                }
+            }
+
+            SectionReader section;
+            const std::vector<StringId> (&names)[snapshotNameKinds];
+            std::size_t rows;
+            std::tuple<const SnapshotColumn<FieldAt<T, I>>*...> columns;
+            const char* pool;
+        };
+    }
+
+    /**
+     * @brief Writes all three collections to a snapshot file.
+     *
+     * The snapshot is written to `<filename>.tmp` first and then renamed over `filename`,
+     * so a crash never leaves a half-written snapshot behind.
+     */
+    inline bool saveSnapshot(const std::string& filename, const std::vector<Song>& songs,
+                             const std::vector<Artist>& artists, const std::vector<Album>& albums,
+                             std::string& error) {
+        // The name sections come first but are only known once the records are written
+        constexpr std::size_t sectionCount = 3 + detail::snapshotNameKinds;
+        std::vector<char> sections[sectionCount];
+        detail::SnapshotNames names;
+        detail::writeRecordSection(songs, names, sections[3]);
+        detail::writeRecordSection(artists, names, sections[4]);
+        detail::writeRecordSection(albums, names, sections[5]);
+        for (std::size_t kind = 0; kind < detail::snapshotNameKinds; ++kind) {
+            names.writeSection(kind, sections[kind]);
+        }
+
+        detail::SnapshotHeader header;
+        std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+        header.version = snapshotVersion;
+        header.byteOrder = snapshotByteOrder;
+        header.sectionCount = sectionCount;
+
+        const SnapshotSection kinds[sectionCount] = {SnapshotSection::Genres, SnapshotSection::ArtistNames, SnapshotSection::Countries,
+                                                     SnapshotSection::Songs, SnapshotSection::Artists, SnapshotSection::Albums};
+        detail::SnapshotSectionEntry table[sectionCount];
+        std::uint64_t offset = sizeof(header) + sizeof(table);
+        for (std::size_t i = 0; i < sectionCount; ++i) {
+            table[i].kind = static_cast<std::uint32_t>(kinds[i]);
+            table[i].reserved = 0;
+            table[i].offset = offset;
+            table[i].size = sections[i].size();
+            offset += sections[i].size();
+        }
+
+        const std::string tempName = filename + ".tmp";
+        {
+            std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                error = "cannot open " + tempName + " for writing";
+                return false;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(table), sizeof(table));
+            for (const auto& section : sections) {
+                file.write(section.data(), static_cast<std::streamsize>(section.size()));
+            }
+            if (!file.flush()) {
+                error = "failed to write " + tempName;
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempName, filename, ec);
+        if (ec) {
+            error = "cannot replace " + filename + ": " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Maps a snapshot file and appends its records to the three collections.
+     *
+     * The file is validated (magic, version, byte order and every offset and name position)
+     * before any record is created, so a damaged snapshot leaves the collections untouched.
+     * Each distinct name is interned once, not once per record.
+     */
+    inline bool loadSnapshot(const std::string& filename, std::vector<Song>& songs,
+                             std::vector<Artist>& artists, std::vector<Album>& albums,
+                             std::string& error) {
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            error = "cannot open " + filename;
+            return false;
+        }
+        detail::SnapshotHeader header;
+        if (file.size() < sizeof(header)) {
+            error = filename + " is not a snapshot";
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0) {
+            error = filename + " is not a snapshot";
+            return false;
+        }
+        if (header.byteOrder != snapshotByteOrder) {
+            error = filename + " was written on a machine with a different byte order";
+            return false;
+        }
+        if (header.version != snapshotVersion) {
+            error = filename + " has unsupported snapshot version " + std::to_string(header.version);
+            return false;
+        }
+        if (header.sectionCount > (file.size() - sizeof(header)) / sizeof(detail::SnapshotSectionEntry)) {
+            error = filename + " is truncated";
+            return false;
+        }
+
+        constexpr std::uint32_t lastKind = static_cast<std::uint32_t>(SnapshotSection::Countries);
+        const char* sectionData[lastKind + 1] = {};
+        std::size_t sectionSize[lastKind + 1] = {};
+        for (std::uint64_t i = 0; i < header.sectionCount; ++i) {
+            detail::SnapshotSectionEntry entry;
+            std::memcpy(&entry, file.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+            if (entry.offset > file.size() || entry.size > file.size() - entry.offset || entry.offset % 8 != 0) {
+                error = filename + " is truncated";
+                return false;
+            }
+            if (entry.kind >= 1 && entry.kind <= lastKind) {
+                sectionData[entry.kind] = file.data() + entry.offset;
+                sectionSize[entry.kind] = static_cast<std::size_t>(entry.size);
+            }
+        }
+        for (std::uint32_t kind = 1; kind <= lastKind; ++kind) {
+            if (sectionData[kind] == nullptr) {
+                error = filename + " is missing a section";
+                return false;
+            }
+        }
+        auto section = [&](SnapshotSection kind) {
+            const auto at = static_cast<std::size_t>(kind);
+            return detail::SectionReader(sectionData[at], sectionSize[at]);
+        };
+
+        std::vector<StringId> names[detail::snapshotNameKinds];
+        const SnapshotSection nameSections[detail::snapshotNameKinds] = {SnapshotSection::Genres, SnapshotSection::ArtistNames,
+                                                                         SnapshotSection::Countries};
+        for (std::size_t kind = 0; kind < detail::snapshotNameKinds; ++kind) {
+            if (!detail::readNameSection(section(nameSections[kind]), kind, names[kind])) {
+                error = filename + " is corrupted";
+                return false;
+            }
+        }
+        detail::RecordSectionReader<Song> songSection(section(SnapshotSection::Songs), names);
+        detail::RecordSectionReader<Artist> artistSection(section(SnapshotSection::Artists), names);
+        detail::RecordSectionReader<Album> albumSection(section(SnapshotSection::Albums), names);
+        if (!songSection.ok() || !artistSection.ok() || !albumSection.ok()) {
+            error = filename + " is corrupted";
+            return false;
+        }
+        songSection.appendTo(songs);
+        artistSection.appendTo(artists);
+        albumSection.appendTo(albums);
+        return true;
+    }
+}
+
+#endif
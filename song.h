@@ -1,34 +1,48 @@
-/**
- * @file Song.h
- * @brief Class representing a music song with attributes like title, duration, genre, and artist.
- * Provides methods to retrieve these attributes.
- */
-#ifndef SONG_H
-#define SONG_H
-
-#include <string>
-
-namespace rc {
-
-class Song {
-public:
-    Song() : title("Unknown"), duration(0.0), genre("Unknown"), artist("Unknown") {}
-
-    Song(const std::string& title, double duration, const std::string& genre, const std::string& artist)
-        : title(title), duration(duration), genre(genre), artist(artist) {}
-
-    std::string getTitle() const { return title; }
-    double getDuration() const { return duration; }
-    std::string getGenre() const { return genre; }
-    std::string getArtist() const { return artist; }
-
-private:
-    std::string title;   
-    double duration;     
-    std::string genre;   
-    std::string artist;  
-};
-
-} 
-
-#endif
+/**
+ * @file Song.h
+ * @brief Class representing a music song with attributes like title, duration, genre, and artist.
+ * Provides methods to retrieve these attributes.
+ * Genre and artist are interned (see `string_dictionary.h`) and stored as integer IDs; the title
+ * is kept in a text arena (see `text_arena.h`), so a song owns no heap memory.
+ */
+#ifndef SONG_H
+#define SONG_H
+
+#include <string>
+#include <string_view>
+#include "string_dictionary.h"
+#include "text_arena.h"
+
+namespace rc {
+
+class Song {
+public:
+    Song() : title(), duration(0.0), genre(StringDictionary::empty), artist(StringDictionary::empty) {}
+
+    Song(std::string_view title, double duration, std::string_view genre, std::string_view artist)
+        : title(TextArena::current().store(title)), duration(duration), genre(genreDictionary().intern(genre)), artist(artistDictionary().intern(artist)) {}
+
+    // For callers that already hold the dictionary IDs
+    Song(std::string_view title, double duration, StringId genre, StringId artist)
+        : title(TextArena::current().store(title)), duration(duration), genre(genre), artist(artist) {}
+
+    std::string_view getTitle() const { return title; }
+    double getDuration() const { return duration; }
+    const std::string& getGenre() const { return genreDictionary().lookup(genre); }
+    const std::string& getArtist() const { return artistDictionary().lookup(artist); }
+    StringId getGenreId() const { return genre; }
+    StringId getArtistId() const { return artist; }
+
+    // Copies the title to `arena`, e.g. the arena of the library the song is added to
+    void storeTextIn(TextArena& arena) { title = arena.store(title); }
+
+private:
+    std::string_view title;   
+    double duration;     
+    StringId genre;   
+    StringId artist;  
+};
+
+} 
+
+#endif
@@ -0,0 +1,287 @@
+/**
+ * @file stream_scan.h
+ * @brief One-off queries straight over the database files, without loading them.
+ *
+ * The file is read in windows of a few megabytes; each window is cut at line boundaries
+ * and its pieces are scanned on the thread pool while the next window is being read. The
+ * filter is tested on the raw fields of each line (text fields by comparing bytes, numbers
+ * parsed only when a condition needs them), and only matching lines become records. Memory
+ * use therefore depends on the window size and the number of matches, not on the file size.
+ * Compressed files (see `compressed_format.h`) are scanned block by block the same way.
+ */
+#ifndef STREAM_SCAN_H
+#define STREAM_SCAN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <future>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "database_io.h"
+#include "filter.h"
+#include "loader.h"
+#include "mapped_file.h"
+#include "record_schema.h"
+#include "text_arena.h"
+#include "thread_pool.h"
+
+namespace rc {
+    namespace detail {
+        /**
+         * @brief A filter condition addressed by field position, tested on an unparsed line.
+         */
+        struct RawCondition {
+            std::size_t field;
+            Compare op;
+            double number;
+            std::string_view text;     // dictionary name for text fields, empty for numbers
+            bool isText;
+            bool isInteger;
+            const char* invalid;       // error for a number that does not parse
+        };
+
+        /**
+         * @brief Text comparisons first: they are a length check and a memcmp.
+         */
+        inline void orderRawConditions(std::vector<RawCondition>& conditions) {
+            std::stable_partition(conditions.begin(), conditions.end(), [](const RawCondition& c) { return c.isText; });
+        }
+
+        /**
+         * @brief Condition on the number field `name` of `T`, at its position in the file.
+         */
+        template <typename T>
+        RawCondition rawNumber(std::string_view name, Compare op, double number) {
+            RawCondition condition{fieldIndex<T>(name), op, number, {}, false, false, nullptr};
+            forEachField<T>([&](const auto& field) {
+                if (field.name == name) {
+                    condition.isInteger = std::is_integral_v<typename std::decay_t<decltype(field)>::Value>;
+                    condition.invalid = field.invalid;
+                }
+            });
+            return condition;
+        }
+
+        /**
+         * @brief Condition on the name field `name` of `T`, compared with the text of `id` in `dictionary`.
+         */
+        template <typename T>
+        RawCondition rawName(std::string_view name, Compare op, const StringDictionary& dictionary, StringId id) {
+            return {fieldIndex<T>(name), op, 0.0, dictionary.lookup(id), true, false, nullptr};
+        }
+
+        inline std::vector<RawCondition> rawConditions(const SongFilter& filter) {
+            std::vector<RawCondition> conditions;
+            for (const auto& c : filter) {
+                switch (c.field) {
+                    case SongField::Duration: conditions.push_back(rawNumber<Song>("duration", c.op, c.number)); break;
+                    case SongField::Genre: conditions.push_back(rawName<Song>("genre", c.op, genreDictionary(), c.id)); break;
+                    case SongField::Artist: conditions.push_back(rawName<Song>("artist", c.op, artistDictionary(), c.id)); break;
+                }
+            }
+            orderRawConditions(conditions);
+            return conditions;
+        }
+
+        inline std::vector<RawCondition> rawConditions(const AlbumFilter& filter) {
+            std::vector<RawCondition> conditions;
+            for (const auto& c : filter) {
+                switch (c.field) {
+                    case AlbumField::Artist: conditions.push_back(rawName<Album>("artist", c.op, artistDictionary(), c.id)); break;
+                    case AlbumField::Year: conditions.push_back(rawNumber<Album>("year", c.op, c.number)); break;
+                    case AlbumField::Rating: conditions.push_back(rawNumber<Album>("rating", c.op, c.number)); break;
+                    case AlbumField::Genre: conditions.push_back(rawName<Album>("genre", c.op, genreDictionary(), c.id)); break;
+                }
+            }
+            orderRawConditions(conditions);
+            return conditions;
+        }
+
+        /**
+         * @brief Tests the raw fields of one line. Returns an error for a number that does not
+         * parse, otherwise nullptr with the outcome in `matched`.
+         */
+        template <std::size_t N>
+        const char* testRawLine(const std::vector<RawCondition>& conditions, const std::string_view (&fields)[N], bool& matched) {
+            matched = false;
+            for (const RawCondition& condition : conditions) {
+                std::string_view field = fields[condition.field];
+                if (condition.isText) {
+                    // Unknown names were interned by the filter, so equality of the bytes is equality of the IDs
+                    if (field != condition.text) {
+                        return nullptr;
+                    }
+                    continue;
+                }
+                double value;
+                if (condition.isInteger) {
+                    int integer;
+                    if (!parseNumber(field, integer)) {
+                        return condition.invalid;
+                    }
+                    value = static_cast<double>(integer);
+                } else if (!parseNumber(field, value)) {
+                    return condition.invalid;
+                }
+                if (!compareValues(value, condition.op, condition.number)) {
+                    return nullptr;
+                }
+            }
+            matched = true;
+            return nullptr;
+        }
+
+        /**
+         * @brief Fills `buffer` with `carry` and the next bytes of `in`, then moves the bytes
+         * after the last complete line back into `carry`. A line longer than a window makes
+         * the window grow until the line fits. Returns false at the end of the file.
+         */
+        inline bool readScanWindow(std::istream& in, std::string& buffer, std::string& carry, std::size_t windowBytes) {
+            // The carried bytes hold no newline, so the last one found is in the bytes just read
+            buffer.swap(carry);
+            carry.clear();
+            std::size_t newline = std::string::npos;
+            while (in && newline == std::string::npos) {
+                const std::size_t used = buffer.size();
+                buffer.resize(used + windowBytes);
+                in.read(&buffer[used], static_cast<std::streamsize>(windowBytes));
+                buffer.resize(used + static_cast<std::size_t>(in.gcount()));
+                newline = buffer.rfind('\n');
+            }
+            if (in && newline != std::string::npos) {
+                carry.assign(buffer, newline + 1, std::string::npos);
+                buffer.resize(newline + 1);
+            }
+            return !buffer.empty();
+        }
+
+        /**
+         * @brief Scans the lines of a `T` file window by window; only matching lines are parsed
+         * into records, which `emit` receives in file order. `report.loaded` counts the matching lines.
+         * The text of the records lives until the scan returns.
+         */
+        template <typename T, typename Emit>
+        FileLoad scanFile(const std::string& filename, const std::vector<RawCondition>& conditions, ThreadPool& pool, Emit emit) {
+            FileLoad load;
+            std::ifstream file(filename, std::ios::binary);
+            if (!file.is_open()) {
+                return load;
+            }
+            load.opened = true;
+            TextArena matchedText;
+            TextArena::Scope scope(matchedText);
+            constexpr std::size_t bytesPerThread = 4 << 20;
+            const std::size_t threads = std::max<std::size_t>(pool.size(), 1);
+            const std::size_t windowBytes = threads * bytesPerThread;
+
+            constexpr std::size_t N = fieldCount<T>;
+            auto scanPiece = [&](std::string_view piece, std::vector<T>& matches) {
+                RecordParser<T> parser;
+                return parseLines<N>(piece, [&](const std::string_view (&fields)[N]) -> const char* {
+                    bool matched;
+                    if (const char* error = testRawLine(conditions, fields, matched)) {
+                        return error;
+                    }
+                    return matched ? parser.parse(fields, [&](const auto&... values) { matches.emplace_back(values...); }) : nullptr;
+                });
+            };
+
+            std::string current, next, carry;
+            bool more = readScanWindow(file, current, carry, windowBytes);
+            while (more) {
+                // Read the next window while this one is scanned; the scan does not touch `next` or `carry`
+                auto reading = std::async(std::launch::async, [&] { return readScanWindow(file, next, carry, windowBytes); });
+                std::vector<std::string_view> pieces = splitChunks(current, threads, 1 << 20);
+                std::vector<std::vector<T>> parts(pieces.size());
+                std::vector<LoadReport> reports(pieces.size());
+                if (pieces.size() <= 1 || threads <= 1) {
+                    for (std::size_t i = 0; i < pieces.size(); ++i) {
+                        reports[i] = scanPiece(pieces[i], parts[i]);
+                    }
+                } else {
+                    std::vector<std::future<LoadReport>> pending;
+                    for (std::size_t i = 0; i < pieces.size(); ++i) {
+                        pending.push_back(pool.submit([&, i] { return scanPiece(pieces[i], parts[i]); }));
+                    }
+                    for (auto& future : pending) {
+                        future.wait();
+                    }
+                    for (std::size_t i = 0; i < pieces.size(); ++i) {
+                        reports[i] = pending[i].get();
+                    }
+                }
+                for (std::size_t i = 0; i < pieces.size(); ++i) {
+                    for (auto& error : reports[i].errors) {
+                        error.line += load.report.lines;
+                        load.report.errors.push_back(std::move(error));
+                    }
+                    load.report.loaded += parts[i].size();
+                    load.report.lines += reports[i].lines;
+                    for (const T& record : parts[i]) {
+                        emit(record);
+                    }
+                }
+                more = reading.get();
+                current.swap(next);
+            }
+            return load;
+        }
+
+        /**
+         * @brief `scanFile` over a compressed file. The filter is tested on a record built
+         * without its title, which no condition looks at, so only matches copy their text.
+         * As with `scanFile`, that text lives until the scan returns.
+         */
+        template <typename T, typename Filter, typename Emit>
+        FileLoad scanCompressedFile(const std::string& filename, const Filter& filter, ThreadPool& pool, Emit emit) {
+            FileLoad load;
+            MappedFile file(filename);
+            if (!file.isOpen()) {
+                return load;
+            }
+            load.opened = true;
+            TextArena matchedText;
+            TextArena::Scope scope(matchedText);
+            std::size_t matched = 0;
+            load.report = visitCompressed<T>(file.view(), pool, [&](std::string_view text, auto... fields) {
+                if (matches(T(std::string_view(), fields...), filter)) {
+                    ++matched;
+                    emit(T(text, fields...));
+                }
+            });
+            load.report.loaded = matched;
+            return load;
+        }
+    }
+
+    /**
+     * @brief Calls `emit(const Song&)` for every song in `filename` matching `filter`, in file
+     * order. Build the filter with `FilterNames::Intern` when the songs are not loaded, so
+     * its genre and artist names resolve. `report.loaded` is the number of matches.
+     */
+    template <typename Emit>
+    FileLoad scanSongsFile(const std::string& filename, const SongFilter& filter, ThreadPool& pool, Emit emit) {
+        if (fileStorageFormat(filename) == StorageFormat::Compressed) {
+            return detail::scanCompressedFile<Song>(filename, filter, pool, emit);
+        }
+        return detail::scanFile<Song>(filename, detail::rawConditions(filter), pool, emit);
+    }
+
+    /**
+     * @brief Calls `emit(const Album&)` for every album in `filename` matching `filter`, like `scanSongsFile`.
+     */
+    template <typename Emit>
+    FileLoad scanAlbumsFile(const std::string& filename, const AlbumFilter& filter, ThreadPool& pool, Emit emit) {
+        if (fileStorageFormat(filename) == StorageFormat::Compressed) {
+            return detail::scanCompressedFile<Album>(filename, filter, pool, emit);
+        }
+        return detail::scanFile<Album>(filename, detail::rawConditions(filter), pool, emit);
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file string_dictionary.h
+ * @brief Interning of repeated text values (genres, artist names, countries).
+ * Each distinct value is stored once and records keep a compact integer ID instead of a string.
+ */
+#ifndef STRING_DICTIONARY_H
+#define STRING_DICTIONARY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace rc {
+    using StringId = std::uint32_t;
+
+    /**
+     * @brief Thread-safe, append-only mapping between strings and dense IDs.
+     *
+     * Values live in fixed-size chunks that never move, so `lookup` is lock-free and the
+     * references it returns stay valid for the lifetime of the dictionary.
+     * ID `empty` is the empty string, reserved when the dictionary is created, so default
+     * records need no lookup.
+     */
+    class StringDictionary {
+    public:
+        static constexpr StringId notFound = 0xFFFFFFFFu;
+        static constexpr StringId empty = 0;
+
+        StringDictionary() : chunks(new std::atomic<std::string*>[maxChunks]) {
+            for (std::size_t i = 0; i < maxChunks; ++i) {
+                chunks[i].store(nullptr, std::memory_order_relaxed);
+            }
+            intern(std::string_view());
+        }
+
+        ~StringDictionary() {
+            for (std::size_t i = 0; i < maxChunks; ++i) {
+                delete[] chunks[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        StringDictionary(const StringDictionary&) = delete;
+        StringDictionary& operator=(const StringDictionary&) = delete;
+
+        /**
+         * @brief Returns the ID of `text`, adding it to the dictionary if it is new.
+         */
+        StringId intern(std::string_view text) {
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                auto it = ids.find(text);
+                if (it != ids.end()) {
+                    return it->second;
+                }
+            }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            auto it = ids.find(text);
+            if (it != ids.end()) {
+                return it->second;
+            }
+            std::size_t id = count.load(std::memory_order_relaxed);
+            std::size_t chunk = id >> chunkBits;
+            if (chunk >= maxChunks) {
+                throw std::length_error("StringDictionary is full");
+            }
+            std::string* values = chunks[chunk].load(std::memory_order_relaxed);
+            if (values == nullptr) {
+                values = new std::string[chunkSize];
+                chunks[chunk].store(values, std::memory_order_release);
+            }
+            std::string& stored = values[id & (chunkSize - 1)];
+            stored.assign(text.data(), text.size());
+            ids.emplace(std::string_view(stored), static_cast<StringId>(id));
+            count.store(id + 1, std::memory_order_release);
+            return static_cast<StringId>(id);
+        }
+
+        /**
+         * @brief Returns the ID of `text`, or `notFound` if it was never interned.
+         */
+        StringId find(std::string_view text) const {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = ids.find(text);
+            return it != ids.end() ? it->second : notFound;
+        }
+
+        const std::string& lookup(StringId id) const {
+            return chunks[id >> chunkBits].load(std::memory_order_acquire)[id & (chunkSize - 1)];
+        }
+
+        std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+    private:
+        static constexpr std::size_t chunkBits = 12;
+        static constexpr std::size_t chunkSize = std::size_t(1) << chunkBits;
+        static constexpr std::size_t maxChunks = std::size_t(1) << 14;
+
+        std::unique_ptr<std::atomic<std::string*>[]> chunks;
+        std::atomic<std::size_t> count{0};
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string_view, StringId> ids;
+    };
+
+    /**
+     * @brief Process-wide dictionaries shared by every `Song`, `Album` and `Artist`.
+     * Artist names use one dictionary for all three record types, so an album's artist ID
+     * can be compared directly with an artist record's name ID.
+     */
+    inline StringDictionary& genreDictionary() {
+        static StringDictionary dictionary;
+        return dictionary;
+    }
+
+    inline StringDictionary& artistDictionary() {
+        static StringDictionary dictionary;
+        return dictionary;
+    }
+
+    inline StringDictionary& countryDictionary() {
+        static StringDictionary dictionary;
+        return dictionary;
+    }
+}
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file text_arena.h
+ * @brief Append-only storage for the free text of records (song titles, album names).
+ *
+ * Records hold a `std::string_view` into an arena instead of owning a `std::string`. Loading
+ * a library then allocates a few large blocks instead of one heap string per record, the
+ * records become trivially copyable and about a third smaller, so a collection is one packed
+ * array, and destroying a collection frees no strings at all.
+ *
+ * Each library keeps its text in an arena of its own (see `Library`), which it replaces with
+ * a compact copy once removed and replaced records have left too much of it unused. Records
+ * are built in the current arena of the thread: the one of the innermost `TextArena::Scope`,
+ * or the process-wide `textArena()` outside any scope. Parsers of transient records (commands,
+ * journal entries) use a scratch arena they clear when the change has been made.
+ *
+ * Each thread fills its own current block of an arena, so the parallel parsers do not contend;
+ * the lock is only taken to hand out a new block. A thread's blocks start small and double up
+ * to `blockSize`, so a thread that stores a few titles does not hold a whole block.
+ */
+#ifndef TEXT_ARENA_H
+#define TEXT_ARENA_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace rc {
+    class TextArena {
+    public:
+        static constexpr std::size_t blockSize = std::size_t(1) << 20;
+        static constexpr std::size_t firstBlockSize = std::size_t(1) << 12;
+
+        TextArena() = default;
+        TextArena(const TextArena&) = delete;
+        TextArena& operator=(const TextArena&) = delete;
+
+        /**
+         * @brief Copies `text` into the arena and returns the copy, valid until the arena is
+         * cleared or destroyed.
+         */
+        std::string_view store(std::string_view text) {
+            if (text.empty()) {
+                return {};
+            }
+            Cursor& cursor = cursorFor(id.load(std::memory_order_relaxed));
+            if (cursor.left < text.size()) {
+                // Long texts get a block of their own so the current block is not wasted
+                if (text.size() > blockSize / 4) {
+                    return copy(allocate(text.size()), text);
+                }
+                const std::size_t size = std::max(cursor.nextBlock, text.size());
+                cursor.next = allocate(size);
+                cursor.left = size;
+                cursor.nextBlock = std::min(size * 2, blockSize);
+            }
+            std::string_view stored = copy(cursor.next, text);
+            cursor.next += text.size();
+            cursor.left -= text.size();
+            return stored;
+        }
+
+        /**
+         * @brief Frees all the text. Must not run while another thread stores into the arena.
+         */
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocks.clear();
+            reserved = 0;
+            id = nextId();   // the threads' cursors into the old blocks no longer match
+        }
+
+        /**
+         * @brief Bytes reserved from the system so far.
+         */
+        std::size_t reservedBytes() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return reserved;
+        }
+
+        std::size_t blockCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return blocks.size();
+        }
+
+        /**
+         * @brief The arena records built on this thread store their text in.
+         */
+        static TextArena& current();
+
+        /**
+         * @brief Makes `arena` the current arena of the thread until the scope ends.
+         */
+        class Scope {
+        public:
+            explicit Scope(TextArena& arena) : previous(scoped()) { scoped() = &arena; }
+            ~Scope() { scoped() = previous; }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            TextArena* previous;
+        };
+
+    private:
+        // A thread's position in one arena, found by the arena's ID: IDs are never reused, so
+        // the cursor of a destroyed or cleared arena is never picked again
+        struct Cursor {
+            std::uint64_t owner = 0;
+            char* next = nullptr;
+            std::size_t left = 0;
+            std::size_t nextBlock = firstBlockSize;
+        };
+
+        static std::uint64_t nextId() {
+            static std::atomic<std::uint64_t> last{0};
+            return ++last;
+        }
+
+        static TextArena*& scoped() {
+            thread_local TextArena* arena = nullptr;
+            return arena;
+        }
+
+        /**
+         * @brief The thread's cursor into the arena `owner`. A thread usually stores into one or
+         * two arenas at a time (a library and a scratch arena), so a few cursors are kept and
+         * switching between arenas does not give up a partly filled block.
+         */
+        static Cursor& cursorFor(std::uint64_t owner) {
+            thread_local std::array<Cursor, 4> cursors;
+            thread_local std::size_t replace = 0;
+            for (Cursor& cursor : cursors) {
+                if (cursor.owner == owner) {
+                    return cursor;
+                }
+            }
+            Cursor& cursor = cursors[replace];
+            replace = (replace + 1) % cursors.size();
+            cursor = Cursor();
+            cursor.owner = owner;
+            return cursor;
+        }
+
+        char* allocate(std::size_t size) {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocks.emplace_back(new char[size]);
+            reserved += size;
+            return blocks.back().get();
+        }
+
+        static std::string_view copy(char* target, std::string_view text) {
+            std::memcpy(target, text.data(), text.size());
+            return std::string_view(target, text.size());
+        }
+
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::size_t reserved = 0;
+        std::atomic<std::uint64_t> id{nextId()};
+    };
+
+    /**
+     * @brief The arena of records built outside any `TextArena::Scope`. It is never cleared.
+     */
+    inline TextArena& textArena() {
+        static TextArena arena;
+        return arena;
+    }
+
+    inline TextArena& TextArena::current() {
+        TextArena* arena = scoped();
+        return arena != nullptr ? *arena : textArena();
+    }
+}
+
+#endif
@@ -0,0 +1,641 @@
+/**
+ * @file text_index.h
+ * @brief Case-insensitive prefix and substring search over one text field of a collection
+ * (song titles, album names, artist names).
+ *
+ * Prefix queries use the rows kept sorted by their folded text, so a query is a binary
+ * search followed by reading the matches in order. Substring queries use a trigram index:
+ * every three-character window of a text points to the rows containing it (with separate
+ * lists for windows at the start of a word), so a query only checks rows that contain its
+ * trigrams and stops as soon as it has enough matches.
+ *
+ * Fuzzy queries tolerate typos: texts and query are normalized (case folded, punctuation
+ * dropped, spaces collapsed) and compared by edit distance with Myers' bit-parallel algorithm,
+ * which handles a query of up to 64 bytes in a few word operations per text byte. Every row
+ * keeps a 64-bit key with the normalized length and the set of characters it uses; a text
+ * whose length or characters differ from the query's by more edits than allowed is skipped
+ * on the key alone, so only a few candidates are normalized and compared.
+ */
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "row_remap.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rc {
+    enum class TextMatch { Prefix, Substring, Fuzzy };
+
+    namespace detail {
+        inline char foldCase(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        inline std::string foldText(std::string_view text) {
+            std::string folded(text);
+            for (auto& c : folded) {
+                c = foldCase(c);
+            }
+            return folded;
+        }
+
+        /**
+         * @brief Three-way comparison of two texts with both sides case folded.
+         */
+        inline int compareFolded(std::string_view left, std::string_view right) {
+            std::size_t common = std::min(left.size(), right.size());
+            for (std::size_t i = 0; i < common; ++i) {
+                unsigned char a = static_cast<unsigned char>(foldCase(left[i]));
+                unsigned char b = static_cast<unsigned char>(foldCase(right[i]));
+                if (a != b) {
+                    return a < b ? -1 : 1;
+                }
+            }
+            return left.size() < right.size() ? -1 : left.size() > right.size() ? 1 : 0;
+        }
+
+        inline bool startsWithFolded(std::string_view text, std::string_view folded) {
+            return text.size() >= folded.size() && compareFolded(text.substr(0, folded.size()), folded) == 0;
+        }
+
+        inline std::size_t findFolded(std::string_view text, std::string_view folded) {
+            if (folded.empty()) {
+                return 0;
+            }
+            for (std::size_t at = 0; at + folded.size() <= text.size(); ++at) {
+                if (foldCase(text[at]) == folded[0] && compareFolded(text.substr(at, folded.size()), folded) == 0) {
+                    return at;
+                }
+            }
+            return std::string_view::npos;
+        }
+
+        inline std::uint32_t trigramAt(std::string_view folded, std::size_t at) {
+            return static_cast<std::uint32_t>(static_cast<unsigned char>(folded[at])) << 16
+                 | static_cast<std::uint32_t>(static_cast<unsigned char>(folded[at + 1])) << 8
+                 | static_cast<std::uint32_t>(static_cast<unsigned char>(folded[at + 2]));
+        }
+
+        /**
+         * @brief Replaces `result` with the distinct trigrams of an already folded text, sorted.
+         */
+        inline void trigrams(std::string_view folded, std::vector<std::uint32_t>& result) {
+            result.clear();
+            for (std::size_t at = 0; at + 3 <= folded.size(); ++at) {
+                result.push_back(trigramAt(folded, at));
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+        }
+
+        /**
+         * @brief Case-folded bytes [from, from + 8) packed big-endian and zero padded, so comparing
+         * packed words orders texts like `compareFolded` over those bytes.
+         */
+        inline std::uint64_t foldedWord(std::string_view text, std::size_t from) {
+            std::uint64_t word = 0;
+            for (std::size_t i = from; i < from + 8; ++i) {
+                unsigned char c = i < text.size() ? static_cast<unsigned char>(foldCase(text[i])) : 0;
+                word = word << 8 | c;
+            }
+            return word;
+        }
+
+        /**
+         * @brief Position of `folded` in `text`, preferring an occurrence at the start of a word.
+         */
+        inline std::size_t findWordFolded(std::string_view text, std::string_view folded) {
+            std::size_t first = findFolded(text, folded);
+            for (std::size_t at = first; at != std::string_view::npos && at > 0 && text[at - 1] != ' ';) {
+                std::size_t next = findFolded(text.substr(at + 1), folded);
+                if (next == std::string_view::npos) {
+                    break;
+                }
+                at += 1 + next;
+                if (text[at - 1] == ' ') {
+                    return at;
+                }
+            }
+            return first;
+        }
+    }
+
+    namespace detail {
+        /**
+         * @brief Key compared by fuzzy searches: case folded, without punctuation, with every run of
+         * spaces turned into one space and none at the ends ("Tyler, the  Creator" becomes
+         * "tyler the creator"). Bytes outside ASCII are kept as they are. Returns `result`.
+         */
+        inline std::string& normalizeName(std::string_view text, std::string& result) {
+            result.clear();
+            bool space = false;
+            for (char c : text) {
+                const unsigned char byte = static_cast<unsigned char>(c);
+                if (c == ' ' || c == '\t') {
+                    space = !result.empty();
+                } else if (byte >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                    if (space) {
+                        result.push_back(' ');
+                        space = false;
+                    }
+                    result.push_back(foldCase(c));
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief Bits 0-55: the characters of a normalized text (one bit per letter, digit and
+         * space, the other bytes hashed onto the remaining bits); bits 56-63: its length,
+         * saturated at 255.
+         */
+        inline std::uint64_t fuzzyKey(std::string_view normalized) {
+            std::uint64_t characters = 0;
+            for (char c : normalized) {
+                const unsigned char byte = static_cast<unsigned char>(c);
+                const unsigned bit = c >= 'a' && c <= 'z' ? byte - 'a'
+                                   : c >= '0' && c <= '9' ? 26 + (byte - '0')
+                                   : c == ' ' ? 36 : 37 + byte % 19;
+                characters |= std::uint64_t(1) << bit;
+            }
+            return characters | static_cast<std::uint64_t>(std::min<std::size_t>(normalized.size(), 255)) << 56;
+        }
+
+        inline std::size_t countBits(std::uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            return static_cast<std::size_t>(__popcnt64(word));
+#elif defined(_MSC_VER)
+            std::size_t total = 0;
+            for (; word != 0; word &= word - 1) {
+                ++total;
+            }
+            return total;
+#else
+            return static_cast<std::size_t>(__builtin_popcountll(word));
+#endif
+        }
+
+        /**
+         * @brief False when two texts with these keys are certainly more than `maxDistance`
+         * edits apart: one edit changes the length by at most one, and adds at most one
+         * character the other text lacks.
+         */
+        inline bool mayBeWithin(std::uint64_t a, std::uint64_t b, std::size_t maxDistance) {
+            constexpr std::uint64_t characterBits = (std::uint64_t(1) << 56) - 1;
+            const std::size_t lengthA = static_cast<std::size_t>(a >> 56);
+            const std::size_t lengthB = static_cast<std::size_t>(b >> 56);
+            if (lengthA < 255 && lengthB < 255 && (lengthA > lengthB ? lengthA - lengthB : lengthB - lengthA) > maxDistance) {
+                return false;
+            }
+            return countBits(a & ~b & characterBits) <= maxDistance && countBits(b & ~a & characterBits) <= maxDistance;
+        }
+
+        /**
+         * @brief Edits allowed by a fuzzy search for a normalized query of `size` bytes: none
+         * below 3 bytes, then one more per 4 bytes, at most 3.
+         */
+        inline std::size_t fuzzyDistanceLimit(std::size_t size) {
+            return std::min<std::size_t>((size + 1) / 4, 3);
+        }
+
+        /**
+         * @brief Levenshtein distance from one pattern to many texts.
+         *
+         * Patterns of up to 64 bytes use Myers' bit-parallel algorithm (in Hyyrö's form): a
+         * column of the dynamic programming matrix is held as bit vectors of its vertical
+         * differences, and each text byte updates it with a handful of word operations. Longer
+         * patterns fall back to the row-by-row matrix.
+         */
+        class EditDistance {
+        public:
+            explicit EditDistance(std::string_view pattern) : pattern(pattern) {
+                if (pattern.size() <= 64) {
+                    for (std::size_t i = 0; i < pattern.size(); ++i) {
+                        peq[static_cast<unsigned char>(pattern[i])] |= std::uint64_t(1) << i;
+                    }
+                }
+            }
+
+            /**
+             * @brief The distance to `text`, or some value above `limit` once it is sure to exceed it.
+             */
+            std::size_t operator()(std::string_view text, std::size_t limit) const {
+                const std::size_t m = pattern.size();
+                if (m == 0) {
+                    return text.size();
+                }
+                if (m > 64) {
+                    return matrixDistance(text);
+                }
+                const std::uint64_t last = std::uint64_t(1) << (m - 1);
+                std::uint64_t pv = ~std::uint64_t(0);
+                std::uint64_t mv = 0;
+                std::size_t score = m;
+                for (std::size_t j = 0; j < text.size(); ++j) {
+                    const std::uint64_t eq = peq[static_cast<unsigned char>(text[j])];
+                    const std::uint64_t xv = eq | mv;
+                    const std::uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                    std::uint64_t ph = mv | ~(xh | pv);
+                    std::uint64_t mh = pv & xh;
+                    if (ph & last) {
+                        ++score;
+                    } else if (mh & last) {
+                        --score;
+                    }
+                    // The first row of the matrix grows by one per text byte
+                    ph = ph << 1 | 1;
+                    mh <<= 1;
+                    pv = mh | ~(xv | ph);
+                    mv = ph & xv;
+                    // Each remaining byte lowers the score by at most one
+                    const std::size_t remaining = text.size() - j - 1;
+                    if (score > limit + remaining) {
+                        return limit + 1;
+                    }
+                }
+                return score;
+            }
+
+        private:
+            std::size_t matrixDistance(std::string_view text) const {
+                std::vector<std::size_t> row(text.size() + 1);
+                for (std::size_t j = 0; j <= text.size(); ++j) {
+                    row[j] = j;
+                }
+                for (std::size_t i = 1; i <= pattern.size(); ++i) {
+                    std::size_t diagonal = row[0];
+                    row[0] = i;
+                    for (std::size_t j = 1; j <= text.size(); ++j) {
+                        const std::size_t above = row[j];
+                        row[j] = std::min({above + 1, row[j - 1] + 1, diagonal + (pattern[i - 1] == text[j - 1] ? 0 : 1)});
+                        diagonal = above;
+                    }
+                }
+                return row[text.size()];
+            }
+
+            std::string_view pattern;
+            std::uint64_t peq[256] = {};   // bit i of peq[c]: pattern[i] == c
+        };
+    }
+
+    /**
+     * @brief Search index over the text `Getter` returns for each record of a vector.
+     *
+     * Rows are kept in step with the vector through `insert` (after an append), `remove`
+     * (after a record was removed) and `eraseRows` (before the removed rows are erased), like
+     * the other indexes of the library. Removed rows stay in the sorted rows and the posting
+     * lists until they are erased, and queries skip them.
+     * Posting lists store 32-bit row numbers to keep the trigram index compact.
+     * Until `build` is called, queries scan the records instead and only `remove` does anything.
+     */
+    template <typename Record>
+    class TextIndex {
+    public:
+        using Getter = std::string_view (*)(const Record&);
+
+        explicit TextIndex(Getter getter) : getter(getter) {}
+
+        void build(const std::vector<Record>& records) {
+            clear();
+            built = true;
+            // Sort on the first 16 folded bytes packed into two words, and only read the texts
+            // again when both are longer and tie; comparing the texts themselves would chase a
+            // pointer per comparison
+            struct Key {
+                std::uint64_t head;
+                std::uint64_t tail;
+                std::size_t row;
+                bool longer;
+            };
+            std::vector<Key> keys(records.size());
+            fuzzyKeys.resize(records.size());
+            for (std::size_t row = 0; row < records.size(); ++row) {
+                std::string_view value = text(records, row);
+                keys[row] = {detail::foldedWord(value, 0), detail::foldedWord(value, 8), row, value.size() > 16};
+                addTrigrams(records, row);
+                fuzzyKeys[row] = detail::fuzzyKey(detail::normalizeName(value, scratchText));
+            }
+            std::sort(keys.begin(), keys.end(), [&](const Key& a, const Key& b) {
+                if (a.head != b.head) {
+                    return a.head < b.head;
+                }
+                if (a.tail != b.tail) {
+                    return a.tail < b.tail;
+                }
+                if (a.longer && b.longer) {
+                    return lessRows(records, a.row, b.row);
+                }
+                return a.longer != b.longer ? b.longer : a.row < b.row;
+            });
+            sorted.resize(keys.size());
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                sorted[i] = keys[i].row;
+            }
+        }
+
+        bool isBuilt() const { return built; }
+
+        /**
+         * @brief Adds a row that was just appended to `records`.
+         */
+        void insert(const std::vector<Record>& records, std::size_t row) {
+            if (!built) {
+                return;
+            }
+            auto at = std::upper_bound(sorted.begin(), sorted.end(), row,
+                                       [&](std::size_t a, std::size_t b) { return lessRows(records, a, b); });
+            sorted.insert(at, row);
+            addTrigrams(records, row);
+            fuzzyKeys.push_back(detail::fuzzyKey(detail::normalizeName(text(records, row), scratchText)));
+        }
+
+        /**
+         * @brief Nothing to do: a record is only replaced in place by one with the same primary
+         * key, which includes its title or name.
+         */
+        void replace(const std::vector<Record>&, std::size_t, const Record&) {}
+
+        /**
+         * @brief Marks a row whose record was removed, so that queries skip it from now on.
+         */
+        void remove(const std::vector<Record>&, std::size_t row) { removed.add(row); }
+
+        void eraseRows(const std::vector<Record>&, const std::vector<std::size_t>& removedRows) {
+            removed.eraseRows(removedRows);
+            if (!built) {
+                return;
+            }
+            detail::remapRows(sorted, removedRows);
+            for (auto& entry : postings) {
+                detail::remapRows(entry.second, removedRows);
+            }
+            detail::eraseColumnRows(fuzzyKeys, removedRows);
+        }
+
+        void clear() {
+            built = false;
+            sorted.clear();
+            postings.clear();
+            fuzzyKeys.clear();
+            removed.clear();
+        }
+
+        /**
+         * @brief Up to `limit` rows matching `query` the way `match` says (see `prefix`,
+         * `substring` and `fuzzy`), best first.
+         */
+        std::vector<std::size_t> search(const std::vector<Record>& records, std::string_view query, TextMatch match,
+                                        std::size_t limit) const {
+            switch (match) {
+                case TextMatch::Prefix: return prefix(records, query, limit);
+                case TextMatch::Substring: return substring(records, query, limit);
+                case TextMatch::Fuzzy: return fuzzy(records, query, limit);
+            }
+            return {};
+        }
+
+        /**
+         * @brief Up to `limit` rows whose text starts with `query` (ignoring case), in
+         * alphabetical order, so an exact match comes first.
+         */
+        std::vector<std::size_t> prefix(const std::vector<Record>& records, std::string_view query, std::size_t limit) const {
+            const std::string folded = detail::foldText(query);
+            std::vector<std::size_t> result;
+            if (!built) {
+                for (std::size_t row = 0; row < records.size(); ++row) {
+                    if (!removed.contains(row) && detail::startsWithFolded(text(records, row), folded)) {
+                        result.push_back(row);
+                    }
+                }
+                std::size_t count = std::min(limit, result.size());
+                std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(count), result.end(),
+                                  [&](std::size_t a, std::size_t b) { return lessRows(records, a, b); });
+                result.resize(count);
+                return result;
+            }
+            auto first = std::lower_bound(sorted.begin(), sorted.end(), folded, [&](std::size_t row, const std::string& key) {
+                return detail::compareFolded(text(records, row), key) < 0;
+            });
+            for (auto it = first; it != sorted.end() && result.size() < limit; ++it) {
+                if (!detail::startsWithFolded(text(records, *it), folded)) {
+                    break;
+                }
+                if (!removed.contains(*it)) {
+                    result.push_back(*it);
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief Every row whose text is exactly `query` (case included), in ascending order.
+         */
+        std::vector<std::size_t> exact(const std::vector<Record>& records, std::string_view query) const {
+            std::vector<std::size_t> result;
+            if (!built) {
+                for (std::size_t row = 0; row < records.size(); ++row) {
+                    if (!removed.contains(row) && text(records, row) == query) {
+                        result.push_back(row);
+                    }
+                }
+                return result;
+            }
+            const std::string folded = detail::foldText(query);
+            auto first = std::lower_bound(sorted.begin(), sorted.end(), folded, [&](std::size_t row, const std::string& key) {
+                return detail::compareFolded(text(records, row), key) < 0;
+            });
+            for (auto it = first; it != sorted.end() && detail::compareFolded(text(records, *it), folded) == 0; ++it) {
+                if (!removed.contains(*it) && text(records, *it) == query) {
+                    result.push_back(*it);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+        /**
+         * @brief Up to `limit` rows whose text contains `query` (ignoring case), best first:
+         * the `prefix` matches (alphabetical, an exact match leading), then texts where a later
+         * word starts with `query`, then texts containing it inside a word, in collection order.
+         *
+         * Each group is read only while results are still missing, so common fragments stop
+         * after `limit` hits instead of ranking every match.
+         */
+        std::vector<std::size_t> substring(const std::vector<Record>& records, std::string_view query, std::size_t limit) const {
+            std::vector<std::size_t> result = prefix(records, query, limit);
+            const std::string folded = detail::foldText(query);
+            // 1 = a later word starts with the query, 2 = only inside words, 0 = no match, a prefix
+            // match or a removed row
+            auto group = [&](std::size_t row) {
+                if (removed.contains(row)) {
+                    return 0;
+                }
+                std::string_view value = text(records, row);
+                std::size_t at = detail::findWordFolded(value, folded);
+                return at == std::string_view::npos || at == 0 ? 0 : value[at - 1] == ' ' ? 1 : 2;
+            };
+            if (!built || folded.size() < 3) {
+                // Without trigrams: one pass, keeping inner matches aside until the word matches are known
+                std::vector<std::size_t> inner;
+                std::size_t wanted = limit - std::min(limit, result.size());
+                std::size_t words = 0;
+                for (std::size_t row = 0; row < records.size() && words < wanted; ++row) {
+                    int kind = group(row);
+                    if (kind == 1) {
+                        result.push_back(row);
+                        ++words;
+                    } else if (kind == 2 && inner.size() < wanted) {
+                        inner.push_back(row);
+                    }
+                }
+                for (std::size_t i = 0; i < inner.size() && result.size() < limit; ++i) {
+                    result.push_back(inner[i]);
+                }
+                return result;
+            }
+            for (int kind = 1; kind <= 2 && result.size() < limit; ++kind) {
+                const std::vector<std::uint32_t>* rows = kind == 1 ? find(detail::trigramAt(folded, 0) | wordStartFlag)
+                                                                   : rarestList(folded);
+                for (std::size_t i = 0; rows != nullptr && i < rows->size() && result.size() < limit; ++i) {
+                    if (group((*rows)[i]) == kind) {
+                        result.push_back((*rows)[i]);
+                    }
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief Up to `limit` rows whose normalized text (see `detail::normalizeName`) is within
+         * `detail::fuzzyDistanceLimit` edits of the normalized query, closest first, then in
+         * alphabetical order. "Tyler the Creator", "tyler, the creator" and "Tyler the Creater"
+         * all find "Tyler, the Creator".
+         */
+        std::vector<std::size_t> fuzzy(const std::vector<Record>& records, std::string_view query, std::size_t limit) const {
+            std::string key;
+            detail::normalizeName(query, key);
+            if (key.empty() || limit == 0) {
+                return {};
+            }
+            std::size_t maxDistance = detail::fuzzyDistanceLimit(key.size());
+            const std::uint64_t queryKey = detail::fuzzyKey(key);
+            const detail::EditDistance distance(key);
+            std::vector<std::pair<std::size_t, std::size_t>> matches;   // (distance, row)
+            std::vector<std::size_t> atDistance(maxDistance + 1, 0);
+            std::string normalized;
+            for (std::size_t row = 0; row < records.size(); ++row) {
+                if ((built && !detail::mayBeWithin(queryKey, fuzzyKeys[row], maxDistance)) || removed.contains(row)) {
+                    continue;
+                }
+                detail::normalizeName(text(records, row), normalized);
+                if (!built && !detail::mayBeWithin(queryKey, detail::fuzzyKey(normalized), maxDistance)) {
+                    continue;
+                }
+                const std::size_t d = distance(normalized, maxDistance);
+                if (d > maxDistance) {
+                    continue;
+                }
+                matches.emplace_back(d, row);
+                // Once `limit` rows are within some distance, farther ones can no longer make the cut
+                ++atDistance[d];
+                for (std::size_t within = 0, e = 0; e < maxDistance; ++e) {
+                    within += atDistance[e];
+                    if (within >= limit) {
+                        maxDistance = e;
+                        break;
+                    }
+                }
+            }
+            const std::size_t count = std::min(limit, matches.size());
+            std::partial_sort(matches.begin(), matches.begin() + static_cast<std::ptrdiff_t>(count), matches.end(),
+                              [&](const std::pair<std::size_t, std::size_t>& a, const std::pair<std::size_t, std::size_t>& b) {
+                                  return a.first != b.first ? a.first < b.first : lessRows(records, a.second, b.second);
+                              });
+            std::vector<std::size_t> result(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                result[i] = matches[i].second;
+            }
+            return result;
+        }
+
+    private:
+        std::string_view text(const std::vector<Record>& records, std::size_t row) const {
+            return getter(records[row]);
+        }
+
+        bool lessRows(const std::vector<Record>& records, std::size_t a, std::size_t b) const {
+            int order = detail::compareFolded(text(records, a), text(records, b));
+            return order != 0 ? order < 0 : a < b;
+        }
+
+        /**
+         * @brief Posts `row` under each distinct trigram of its text, and additionally under
+         * `trigram | wordStartFlag` for trigrams starting a word.
+         */
+        void addTrigrams(const std::vector<Record>& records, std::size_t row) {
+            scratchText.assign(text(records, row));
+            for (auto& c : scratchText) {
+                c = detail::foldCase(c);
+            }
+            detail::trigrams(scratchText, scratchTrigrams);
+            for (std::size_t at = 0; at + 3 <= scratchText.size(); ++at) {
+                if (at == 0 || scratchText[at - 1] == ' ') {
+                    scratchTrigrams.push_back(detail::trigramAt(scratchText, at) | wordStartFlag);
+                }
+            }
+            std::sort(scratchTrigrams.begin(), scratchTrigrams.end());
+            scratchTrigrams.erase(std::unique(scratchTrigrams.begin(), scratchTrigrams.end()), scratchTrigrams.end());
+            for (std::uint32_t trigram : scratchTrigrams) {
+                postings[trigram].push_back(static_cast<std::uint32_t>(row));
+            }
+        }
+
+        const std::vector<std::uint32_t>* find(std::uint32_t trigram) const {
+            auto it = postings.find(trigram);
+            return it != postings.end() ? &it->second : nullptr;
+        }
+
+        /**
+         * @brief Shortest posting list among the trigrams of `folded`; every match is in it.
+         */
+        const std::vector<std::uint32_t>* rarestList(const std::string& folded) const {
+            std::vector<std::uint32_t> queryTrigrams;
+            detail::trigrams(folded, queryTrigrams);
+            const std::vector<std::uint32_t>* rarest = nullptr;
+            for (std::uint32_t trigram : queryTrigrams) {
+                const std::vector<std::uint32_t>* rows = find(trigram);
+                if (rows == nullptr) {
+                    return nullptr;
+                }
+                if (rarest == nullptr || rows->size() < rarest->size()) {
+                    rarest = rows;
+                }
+            }
+            return rarest;
+        }
+
+        static constexpr std::uint32_t wordStartFlag = 1u << 24;
+
+        Getter getter;
+        bool built = false;
+        std::vector<std::size_t> sorted;
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings;
+        std::vector<std::uint64_t> fuzzyKeys;   // `detail::fuzzyKey` of every row
+        RemovedRows removed;
+        std::string scratchText;
+        std::vector<std::uint32_t> scratchTrigrams;
+    };
+}
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file thread_pool.h
+ * @brief Fixed-size pool of worker threads running queued tasks.
+ * Used to spread work that splits into independent pieces (such as parsing chunks of a
+ * database file) over all cores.
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "text_arena.h"
+
+namespace rc {
+    /**
+     * @brief Number of workers used when none is given: one per hardware thread.
+     */
+    inline std::size_t defaultThreadCount() {
+        unsigned count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    /**
+     * @brief Runs submitted tasks on a fixed set of threads, in submission order.
+     *
+     * Tasks must not wait on other tasks of the same pool, since every worker
+     * could end up blocked. The destructor finishes the queued tasks and joins the workers.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(std::size_t threads = defaultThreadCount()) {
+            if (threads == 0) {
+                threads = 1;
+            }
+            workers.reserve(threads);
+            for (std::size_t i = 0; i < threads; ++i) {
+                workers.emplace_back([this] { run(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * @brief Queues `task` and returns a future for its result (or exception). The task
+         * builds records in the current text arena of the submitting thread (see `text_arena.h`),
+         * which must outlive it.
+         */
+        template <typename Task>
+        std::future<std::invoke_result_t<Task>> submit(Task task) {
+            using Result = std::invoke_result_t<Task>;
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+            std::future<Result> result = packaged->get_future();
+            TextArena* text = &TextArena::current();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.emplace_back([packaged, text] {
+                    TextArena::Scope scope(*text);
+                    (*packaged)();
+                });
+            }
+            wake.notify_one();
+            return result;
+        }
+
+        std::size_t size() const { return workers.size(); }
+
+    private:
+        void run() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                    if (queue.empty()) {
+                        return;
+                    }
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> queue;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+    };
+}
+
+#endif